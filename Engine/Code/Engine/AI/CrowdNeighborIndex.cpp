@@ -0,0 +1,197 @@
+#include "Engine/AI/CrowdNeighborIndex.hpp"
+#include "Engine/AI/ObstacleAvoidance.hpp"
+#include "Engine/Core/EngineCommon.hpp"
+#include "Engine/Core/ErrorWarningAssert.hpp"
+#include "Engine/Core/JobSystem.hpp"
+#include "Engine/Math/MathUtils.hpp"
+#include <algorithm>
+#include <cmath>
+
+void CrowdNeighborIndex::Rebuild(std::vector<AIAgent*> const& agents, float cellSize)
+{
+	int numAgents = static_cast<int>(agents.size());
+	ResizeForAgents(numAgents, cellSize);
+	m_agents = agents;
+	m_isBuiltFromAgents = true;
+
+	// Reading the agents is the scattered part, so that's what goes wide
+	int grainSize = (numAgents < CROWD_NEIGHBOR_INDEX_PARALLEL_MIN_AGENTS) ? numAgents : CROWD_NEIGHBOR_INDEX_PARALLEL_MIN_AGENTS / 4;
+	ParallelForIfAvailable(g_theJobSystem, 0, numAgents, grainSize, [&](int agentID)
+	{
+		AIAgent const* agent = m_agents[agentID];
+		if (!agent)
+		{
+			m_agentBuckets[agentID] = -1;
+			return;
+		}
+		SetAgentPosition(agentID, agent->m_position);
+	}, JobType::AI);
+
+	SortIntoBuckets();
+}
+
+void CrowdNeighborIndex::Rebuild(float const* positionsX, float const* positionsY, float const* positionsZ, int numAgents, float cellSize)
+{
+	ResizeForAgents(numAgents, cellSize);
+	m_agents.clear();
+	m_isBuiltFromAgents = false;
+
+	int grainSize = (numAgents < CROWD_NEIGHBOR_INDEX_PARALLEL_MIN_AGENTS) ? numAgents : CROWD_NEIGHBOR_INDEX_PARALLEL_MIN_AGENTS / 4;
+	ParallelForIfAvailable(g_theJobSystem, 0, numAgents, grainSize, [&](int agentID)
+	{
+		SetAgentPosition(agentID, Vec3(positionsX[agentID], positionsY[agentID], positionsZ[agentID]));
+	}, JobType::AI);
+
+	SortIntoBuckets();
+}
+
+void CrowdNeighborIndex::ResizeForAgents(int numAgents, float cellSize)
+{
+	ASSERT_OR_DIE(cellSize > 0.f, "CrowdNeighborIndex cell size must be positive");
+	m_cellSize = cellSize;
+	m_inverseCellSize = 1.f / cellSize;
+
+	int numBuckets = CROWD_NEIGHBOR_INDEX_MIN_BUCKETS;
+	while (numBuckets < numAgents * 2)
+	{
+		numBuckets *= 2;
+	}
+	m_bucketMask = numBuckets - 1;
+
+	m_positions.resize(numAgents);
+	m_agentCellCoords.resize(numAgents);
+	m_agentBuckets.resize(numAgents);
+}
+
+void CrowdNeighborIndex::SetAgentPosition(int agentID, Vec3 const& position)
+{
+	IntVec2 cellCoords = GetCellCoords(position.x, position.y);
+	m_positions[agentID] = position;
+	m_agentCellCoords[agentID] = cellCoords;
+	m_agentBuckets[agentID] = GetBucketIndex(cellCoords.x, cellCoords.y);
+}
+
+void CrowdNeighborIndex::SortIntoBuckets()
+{
+	// Counting sort by bucket. Serial, but it only walks int arrays
+	int numAgents = GetNumAgents();
+	int numBuckets = m_bucketMask + 1;
+	m_bucketStarts.assign(numBuckets + 1, 0);
+	for (int agentID = 0; agentID < numAgents; agentID++)
+	{
+		if (m_agentBuckets[agentID] >= 0)
+		{
+			m_bucketStarts[m_agentBuckets[agentID] + 1]++;
+		}
+	}
+	for (int bucket = 0; bucket < numBuckets; bucket++)
+	{
+		m_bucketStarts[bucket + 1] += m_bucketStarts[bucket];
+	}
+
+	m_entries.resize(m_bucketStarts[numBuckets]);
+	m_bucketCursors.assign(m_bucketStarts.begin(), m_bucketStarts.end() - 1);
+	for (int agentID = 0; agentID < numAgents; agentID++)
+	{
+		int bucket = m_agentBuckets[agentID];
+		if (bucket < 0) continue;
+
+		Entry& entry = m_entries[m_bucketCursors[bucket]++];
+		entry.m_position = m_positions[agentID];
+		entry.m_cellCoords = m_agentCellCoords[agentID];
+		entry.m_agentID = agentID;
+	}
+}
+
+void CrowdNeighborIndex::Clear()
+{
+	m_isBuiltFromAgents = false;
+	m_agents.clear();
+	m_positions.clear();
+	m_agentCellCoords.clear();
+	m_agentBuckets.clear();
+	m_bucketStarts.clear();
+	m_entries.clear();
+}
+
+int CrowdNeighborIndex::QueryRadius(Vec3 const& point, float radius, std::vector<int>& outAgentIDs, int excludedAgentID /*= -1*/) const
+{
+	if (m_entries.empty() || radius < 0.f) return 0;
+
+	size_t numBefore = outAgentIDs.size();
+	float radiusSq = radius * radius;
+	IntVec2 minCell = GetCellCoords(point.x - radius, point.y - radius);
+	IntVec2 maxCell = GetCellCoords(point.x + radius, point.y + radius);
+
+	// A radius far past the cell size would visit more cells than there are entries, reading them all is cheaper
+	long long numCells = static_cast<long long>(maxCell.x - minCell.x + 1) * static_cast<long long>(maxCell.y - minCell.y + 1);
+	if (numCells > static_cast<long long>(m_entries.size()))
+	{
+		for (Entry const& entry : m_entries)
+		{
+			if (entry.m_agentID == excludedAgentID) continue;
+			if (GetDistanceSquared3D(entry.m_position, point) > radiusSq) continue;
+			outAgentIDs.emplace_back(entry.m_agentID);
+		}
+		return static_cast<int>(outAgentIDs.size() - numBefore);
+	}
+
+	for (int cellY = minCell.y; cellY <= maxCell.y; cellY++)
+	{
+		for (int cellX = minCell.x; cellX <= maxCell.x; cellX++)
+		{
+			int bucket = GetBucketIndex(cellX, cellY);
+			int entryEnd = m_bucketStarts[bucket + 1];
+			for (int entryIndex = m_bucketStarts[bucket]; entryIndex < entryEnd; entryIndex++)
+			{
+				Entry const& entry = m_entries[entryIndex];
+				if (entry.m_cellCoords.x != cellX || entry.m_cellCoords.y != cellY) continue;
+				if (entry.m_agentID == excludedAgentID) continue;
+				if (GetDistanceSquared3D(entry.m_position, point) > radiusSq) continue;
+				outAgentIDs.emplace_back(entry.m_agentID);
+			}
+		}
+	}
+	return static_cast<int>(outAgentIDs.size() - numBefore);
+}
+
+int CrowdNeighborIndex::QueryRadius(int agentID, float radius, std::vector<int>& outAgentIDs) const
+{
+	if (agentID < 0 || agentID >= GetNumAgents() || m_agentBuckets[agentID] < 0) return 0;
+	return QueryRadius(m_positions[agentID], radius, outAgentIDs, agentID);
+}
+
+int CrowdNeighborIndex::QueryKNearest(Vec3 const& point, int k, float maxRadius, std::vector<int>& outAgentIDs, int excludedAgentID /*= -1*/) const
+{
+	if (k <= 0) return 0;
+
+	size_t numBefore = outAgentIDs.size();
+	int numFound = QueryRadius(point, maxRadius, outAgentIDs, excludedAgentID);
+	int numKept = std::min(numFound, k);
+
+	auto isCloser = [this, &point](int agentA, int agentB)
+	{
+		return GetDistanceSquared3D(m_positions[agentA], point) < GetDistanceSquared3D(m_positions[agentB], point);
+	};
+	std::partial_sort(outAgentIDs.begin() + numBefore, outAgentIDs.begin() + numBefore + numKept, outAgentIDs.end(), isCloser);
+	outAgentIDs.resize(numBefore + numKept);
+	return numKept;
+}
+
+int CrowdNeighborIndex::QueryKNearest(int agentID, int k, float maxRadius, std::vector<int>& outAgentIDs) const
+{
+	if (agentID < 0 || agentID >= GetNumAgents() || m_agentBuckets[agentID] < 0) return 0;
+	return QueryKNearest(m_positions[agentID], k, maxRadius, outAgentIDs, agentID);
+}
+
+IntVec2 CrowdNeighborIndex::GetCellCoords(float x, float y) const
+{
+	return IntVec2(static_cast<int>(floorf(x * m_inverseCellSize)), static_cast<int>(floorf(y * m_inverseCellSize)));
+}
+
+int CrowdNeighborIndex::GetBucketIndex(int cellX, int cellY) const
+{
+	// Large primes spread neighboring cells over the table
+	unsigned int hash = (static_cast<unsigned int>(cellX) * 73856093u) ^ (static_cast<unsigned int>(cellY) * 19349663u);
+	return static_cast<int>(hash & static_cast<unsigned int>(m_bucketMask));
+}
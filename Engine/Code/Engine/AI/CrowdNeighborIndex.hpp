@@ -0,0 +1,68 @@
+#pragma once
+#include "Engine/Math/Vec3.hpp"
+#include "Engine/Math/IntVec2.hpp"
+#include <vector>
+
+struct AIAgent;
+
+constexpr int CROWD_NEIGHBOR_INDEX_MIN_BUCKETS = 16;
+constexpr int CROWD_NEIGHBOR_INDEX_PARALLEL_MIN_AGENTS = 1024; // Smaller crowds rebuild on the calling thread
+
+// Uniform spatial hash over XY for crowd neighbor queries, rebuilt once a frame from the agents' positions. An agent ID is the agent's
+// index in the list handed to Rebuild. Cells hash into a table sized by the crowd rather than by the world, so agents can spread over any size map
+class CrowdNeighborIndex
+{
+public:
+	CrowdNeighborIndex() = default;
+	~CrowdNeighborIndex() = default;
+
+	// Null agents are skipped. A cellSize around the largest query radius keeps a radius query to 3x3 cells
+	void Rebuild(std::vector<AIAgent*> const& agents, float cellSize);
+	void Rebuild(float const* positionsX, float const* positionsY, float const* positionsZ, int numAgents, float cellSize); // No AIAgents, GetAgent returns null
+	bool IsBuiltFromAgents() const { return m_isBuiltFromAgents; } // Only then can the index feed the ObstacleAvoidnace overloads
+	void Clear();
+
+	// Appends every agent within radius and returns how many were added. An agent is never its own neighbor
+	int QueryRadius(Vec3 const& point, float radius, std::vector<int>& outAgentIDs, int excludedAgentID = -1) const;
+	int QueryRadius(int agentID, float radius, std::vector<int>& outAgentIDs) const;
+
+	// Appends up to k agents nearest first, looking no further than maxRadius
+	int QueryKNearest(Vec3 const& point, int k, float maxRadius, std::vector<int>& outAgentIDs, int excludedAgentID = -1) const;
+	int QueryKNearest(int agentID, int k, float maxRadius, std::vector<int>& outAgentIDs) const;
+
+	int GetNumAgents() const { return static_cast<int>(m_positions.size()); }
+	AIAgent* GetAgent(int agentID) const { return m_agents.empty() ? nullptr : m_agents[agentID]; }
+	Vec3 const& GetAgentPosition(int agentID) const { return m_positions[agentID]; } // As of the last Rebuild
+	float GetCellSize() const { return m_cellSize; }
+
+private:
+	// Entries are sorted by bucket and carry their position, so a query reads one contiguous run per cell without touching the agents
+	struct Entry
+	{
+		Vec3 m_position;
+		IntVec2 m_cellCoords; // Other cells can hash into the same bucket
+		int m_agentID = -1;
+	};
+
+	void ResizeForAgents(int numAgents, float cellSize);
+	void SetAgentPosition(int agentID, Vec3 const& position);
+	void SortIntoBuckets();
+	inline IntVec2 GetCellCoords(float x, float y) const;
+	inline int GetBucketIndex(int cellX, int cellY) const;
+
+private:
+	float m_cellSize = 1.f;
+	float m_inverseCellSize = 1.f;
+	int m_bucketMask = 0; // Number of buckets minus one, always a power of two
+	bool m_isBuiltFromAgents = false;
+
+	// By agent ID
+	std::vector<AIAgent*> m_agents; // Not owned
+	std::vector<Vec3> m_positions;
+	std::vector<IntVec2> m_agentCellCoords;
+	std::vector<int> m_agentBuckets; // -1 for null agents
+
+	std::vector<int> m_bucketStarts; // Entries of bucket b are [m_bucketStarts[b], m_bucketStarts[b + 1])
+	std::vector<int> m_bucketCursors; // Rebuild scratch
+	std::vector<Entry> m_entries;
+};
@@ -0,0 +1,348 @@
+#include "Engine/AI/CrowdSimulation.hpp"
+#include "Engine/AI/ObstacleAvoidance.hpp"
+#include "Engine/Core/EngineCommon.hpp"
+#include "Engine/Core/ErrorWarningAssert.hpp"
+#include "Engine/Core/JobSystem.hpp"
+#include "Engine/Math/MathUtils.hpp"
+#include <algorithm>
+#include <cmath>
+
+template <typename T_Function>
+void CrowdSimulation::ForEachAgentChunk(T_Function const& function) const
+{
+	int numAgents = GetNumAgents();
+	int numChunks = (numAgents + CROWD_SIMULATION_CHUNK_SIZE - 1) / CROWD_SIMULATION_CHUNK_SIZE;
+	ParallelForIfAvailable(g_theJobSystem, 0, numChunks, 1, [&](int chunk)
+	{
+		int beginAgentID = chunk * CROWD_SIMULATION_CHUNK_SIZE;
+		function(beginAgentID, std::min(beginAgentID + CROWD_SIMULATION_CHUNK_SIZE, numAgents));
+	}, JobType::AI);
+}
+
+int CrowdSimulation::AddAgent(Vec3 const& position, float radius, float maxSpeed)
+{
+	int agentID = GetNumAgents();
+	ResizeArrays(agentID + 1);
+	m_positionX[agentID] = position.x;
+	m_positionY[agentID] = position.y;
+	m_positionZ[agentID] = position.z;
+	m_radius[agentID] = radius;
+	m_maxSpeed[agentID] = maxSpeed;
+	return agentID;
+}
+
+void CrowdSimulation::Clear()
+{
+	ResizeArrays(0);
+	m_neighborIndex.Clear();
+	m_currentVelocityBuffer = 0;
+}
+
+void CrowdSimulation::ResizeArrays(int numAgents)
+{
+	m_positionX.resize(numAgents, 0.f);
+	m_positionY.resize(numAgents, 0.f);
+	m_positionZ.resize(numAgents, 0.f);
+	for (int buffer = 0; buffer < 2; buffer++)
+	{
+		m_velocityX[buffer].resize(numAgents, 0.f);
+		m_velocityY[buffer].resize(numAgents, 0.f);
+	}
+	m_preferredVelocityX.resize(numAgents, 0.f);
+	m_preferredVelocityY.resize(numAgents, 0.f);
+	m_radius.resize(numAgents, 0.f);
+	m_maxSpeed.resize(numAgents, 0.f);
+}
+
+void CrowdSimulation::ReadFromAgents(std::vector<AIAgent*> const& agents)
+{
+	int numAgents = static_cast<int>(agents.size());
+	ResizeArrays(numAgents);
+	for (int agentID = 0; agentID < numAgents; agentID++)
+	{
+		AIAgent const* agent = agents[agentID];
+		ASSERT_OR_DIE(agent != nullptr, "CrowdSimulation can't read a null agent");
+		m_positionX[agentID] = agent->m_position.x;
+		m_positionY[agentID] = agent->m_position.y;
+		m_positionZ[agentID] = agent->m_position.z;
+		m_velocityX[m_currentVelocityBuffer][agentID] = agent->m_velocity.x;
+		m_velocityY[m_currentVelocityBuffer][agentID] = agent->m_velocity.y;
+		m_preferredVelocityX[agentID] = agent->m_preferredVelocity.x;
+		m_preferredVelocityY[agentID] = agent->m_preferredVelocity.y;
+		m_radius[agentID] = agent->m_physicsRadius;
+		m_maxSpeed[agentID] = agent->m_moveSpeed;
+	}
+}
+
+void CrowdSimulation::WriteToAgents(std::vector<AIAgent*> const& agents) const
+{
+	int numAgents = std::min(static_cast<int>(agents.size()), GetNumAgents());
+	for (int agentID = 0; agentID < numAgents; agentID++)
+	{
+		AIAgent* agent = agents[agentID];
+		if (!agent) continue;
+		agent->m_position = GetPosition(agentID);
+		Vec2 velocity = GetVelocity(agentID);
+		agent->m_velocity = Vec3(velocity.x, velocity.y, 0.f);
+	}
+}
+
+void CrowdSimulation::Step(float deltaSeconds)
+{
+	if (deltaSeconds <= 0.f || GetNumAgents() == 0) return;
+
+	FindNeighbors();
+	SolveVelocities(deltaSeconds);
+	Integrate(deltaSeconds);
+}
+
+void CrowdSimulation::FindNeighbors()
+{
+	int numAgents = GetNumAgents();
+	m_neighborIndex.Rebuild(m_positionX.data(), m_positionY.data(), m_positionZ.data(), numAgents, m_neighborRadius);
+	m_neighborIDs.resize(numAgents * CROWD_SIMULATION_MAX_NEIGHBORS);
+	m_numNeighbors.resize(numAgents);
+	m_chunkQueryScratch.resize((numAgents + CROWD_SIMULATION_CHUNK_SIZE - 1) / CROWD_SIMULATION_CHUNK_SIZE);
+
+	ForEachAgentChunk([this](int beginAgentID, int endAgentID)
+	{
+		std::vector<int>& queryScratch = m_chunkQueryScratch[beginAgentID / CROWD_SIMULATION_CHUNK_SIZE];
+		for (int agentID = beginAgentID; agentID < endAgentID; agentID++)
+		{
+			queryScratch.clear();
+			int numFound = m_neighborIndex.QueryKNearest(agentID, CROWD_SIMULATION_MAX_NEIGHBORS, m_neighborRadius, queryScratch);
+			std::copy(queryScratch.begin(), queryScratch.begin() + numFound, m_neighborIDs.begin() + agentID * CROWD_SIMULATION_MAX_NEIGHBORS);
+			m_numNeighbors[agentID] = numFound;
+		}
+	});
+}
+
+void CrowdSimulation::SolveVelocities(float deltaSeconds)
+{
+	int nextVelocityBuffer = 1 - m_currentVelocityBuffer;
+	ForEachAgentChunk([this, deltaSeconds, nextVelocityBuffer](int beginAgentID, int endAgentID)
+	{
+		for (int agentID = beginAgentID; agentID < endAgentID; agentID++)
+		{
+			Vec2 newVelocity = SolveAgentVelocity(agentID, deltaSeconds);
+			m_velocityX[nextVelocityBuffer][agentID] = newVelocity.x;
+			m_velocityY[nextVelocityBuffer][agentID] = newVelocity.y;
+		}
+	});
+}
+
+void CrowdSimulation::Integrate(float deltaSeconds)
+{
+	int nextVelocityBuffer = 1 - m_currentVelocityBuffer;
+	ForEachAgentChunk([this, deltaSeconds, nextVelocityBuffer](int beginAgentID, int endAgentID)
+	{
+		// Straight runs over float arrays, so the compiler can vectorize them
+		float* positionX = m_positionX.data();
+		float* positionY = m_positionY.data();
+		float const* velocityX = m_velocityX[nextVelocityBuffer].data();
+		float const* velocityY = m_velocityY[nextVelocityBuffer].data();
+		for (int agentID = beginAgentID; agentID < endAgentID; agentID++)
+		{
+			positionX[agentID] += velocityX[agentID] * deltaSeconds;
+			positionY[agentID] += velocityY[agentID] * deltaSeconds;
+		}
+	});
+	m_currentVelocityBuffer = nextVelocityBuffer;
+}
+
+Vec2 CrowdSimulation::SolveAgentVelocity(int agentID, float deltaSeconds) const
+{
+	std::vector<float> const& currentVelocityX = m_velocityX[m_currentVelocityBuffer];
+	std::vector<float> const& currentVelocityY = m_velocityY[m_currentVelocityBuffer];
+	Vec2 position(m_positionX[agentID], m_positionY[agentID]);
+	Vec2 velocity(currentVelocityX[agentID], currentVelocityY[agentID]);
+	float radius = m_radius[agentID];
+	float inverseTimeHorizon = 1.f / m_timeHorizon;
+	float inverseDeltaSeconds = 1.f / deltaSeconds;
+
+	CrowdORCALine lines[CROWD_SIMULATION_MAX_NEIGHBORS];
+	int numLines = m_numNeighbors[agentID];
+	int const* neighborIDs = &m_neighborIDs[agentID * CROWD_SIMULATION_MAX_NEIGHBORS];
+	for (int neighbor = 0; neighbor < numLines; neighbor++)
+	{
+		int otherID = neighborIDs[neighbor];
+		Vec2 relativePosition(m_positionX[otherID] - position.x, m_positionY[otherID] - position.y);
+		Vec2 relativeVelocity(velocity.x - currentVelocityX[otherID], velocity.y - currentVelocityY[otherID]);
+		float distanceSq = relativePosition.GetLengthSquared();
+		float combinedRadius = radius + m_radius[otherID];
+		float combinedRadiusSq = combinedRadius * combinedRadius;
+
+		CrowdORCALine& line = lines[neighbor];
+		Vec2 u;
+		if (distanceSq > combinedRadiusSq)
+		{
+			// Not touching yet. w runs from the center of the cone's cut off circle to the relative velocity
+			Vec2 w = relativeVelocity - relativePosition * inverseTimeHorizon;
+			float wLengthSq = w.GetLengthSquared();
+			float wDotPosition = DotProduct2D(w, relativePosition);
+			if (wDotPosition < 0.f && wDotPosition * wDotPosition > combinedRadiusSq * wLengthSq)
+			{
+				// Closest to the cut off circle
+				float wLength = sqrtf(wLengthSq);
+				Vec2 unitW = w / wLength;
+				line.m_direction = Vec2(unitW.y, -unitW.x);
+				u = unitW * (combinedRadius * inverseTimeHorizon - wLength);
+			}
+			else
+			{
+				// Closest to one of the cone's legs
+				float leg = sqrtf(distanceSq - combinedRadiusSq);
+				if (CrossProduct2D(relativePosition, w) > 0.f)
+				{
+					line.m_direction = Vec2(relativePosition.x * leg - relativePosition.y * combinedRadius, relativePosition.x * combinedRadius + relativePosition.y * leg) / distanceSq;
+				}
+				else
+				{
+					line.m_direction = -Vec2(relativePosition.x * leg + relativePosition.y * combinedRadius, -relativePosition.x * combinedRadius + relativePosition.y * leg) / distanceSq;
+				}
+				u = line.m_direction * DotProduct2D(relativeVelocity, line.m_direction) - relativeVelocity;
+			}
+		}
+		else
+		{
+			// Already overlapping, get apart within this step
+			Vec2 w = relativeVelocity - relativePosition * inverseDeltaSeconds;
+			float wLength = w.GetLength();
+			Vec2 unitW = (wLength > CROWD_SIMULATION_EPSILON) ? w / wLength : Vec2(1.f, 0.f);
+			line.m_direction = Vec2(unitW.y, -unitW.x);
+			u = unitW * (combinedRadius * inverseDeltaSeconds - wLength);
+		}
+
+		// Each agent takes half of the avoidance, the other one does the rest from its side
+		line.m_point = velocity + u * 0.5f;
+	}
+
+	Vec2 preferredVelocity(m_preferredVelocityX[agentID], m_preferredVelocityY[agentID]);
+	float maxSpeed = m_maxSpeed[agentID];
+	Vec2 newVelocity;
+	int failedLine = SolveInsideLines(lines, numLines, maxSpeed, preferredVelocity, false, newVelocity);
+	if (failedLine < numLines)
+	{
+		SolveLeastViolation(lines, numLines, failedLine, maxSpeed, newVelocity);
+	}
+	return newVelocity;
+}
+
+bool CrowdSimulation::SolveOnLine(CrowdORCALine const* lines, int lineIndex, float maxSpeed, Vec2 const& optimalVelocity, bool isDirectionOptimal, Vec2& inOutResult)
+{
+	// Part of the line inside the max speed circle
+	CrowdORCALine const& line = lines[lineIndex];
+	float pointDotDirection = DotProduct2D(line.m_point, line.m_direction);
+	float discriminant = pointDotDirection * pointDotDirection + maxSpeed * maxSpeed - line.m_point.GetLengthSquared();
+	if (discriminant < 0.f) return false;
+
+	float sqrtDiscriminant = sqrtf(discriminant);
+	float tLeft = -pointDotDirection - sqrtDiscriminant;
+	float tRight = -pointDotDirection + sqrtDiscriminant;
+
+	// Cut it down by every earlier line
+	for (int otherIndex = 0; otherIndex < lineIndex; otherIndex++)
+	{
+		CrowdORCALine const& other = lines[otherIndex];
+		float denominator = CrossProduct2D(line.m_direction, other.m_direction);
+		float numerator = CrossProduct2D(other.m_direction, line.m_point - other.m_point);
+		if (fabsf(denominator) <= CROWD_SIMULATION_EPSILON)
+		{
+			// Parallel, either all of this line is allowed or none of it is
+			if (numerator < 0.f) return false;
+			continue;
+		}
+
+		float t = numerator / denominator;
+		if (denominator >= 0.f)
+		{
+			tRight = std::min(tRight, t);
+		}
+		else
+		{
+			tLeft = std::max(tLeft, t);
+		}
+		if (tLeft > tRight) return false;
+	}
+
+	if (isDirectionOptimal)
+	{
+		float t = (DotProduct2D(optimalVelocity, line.m_direction) > 0.f) ? tRight : tLeft;
+		inOutResult = line.m_point + line.m_direction * t;
+	}
+	else
+	{
+		float t = GetClamped(DotProduct2D(line.m_direction, optimalVelocity - line.m_point), tLeft, tRight);
+		inOutResult = line.m_point + line.m_direction * t;
+	}
+	return true;
+}
+
+int CrowdSimulation::SolveInsideLines(CrowdORCALine const* lines, int numLines, float maxSpeed, Vec2 const& optimalVelocity, bool isDirectionOptimal, Vec2& outResult)
+{
+	if (isDirectionOptimal)
+	{
+		outResult = optimalVelocity * maxSpeed;
+	}
+	else if (optimalVelocity.GetLengthSquared() > maxSpeed * maxSpeed)
+	{
+		outResult = optimalVelocity.GetNormalized() * maxSpeed;
+	}
+	else
+	{
+		outResult = optimalVelocity;
+	}
+
+	// Every line the result falls outside of moves it onto that line, returns the first line that can't be met
+	for (int lineIndex = 0; lineIndex < numLines; lineIndex++)
+	{
+		if (CrossProduct2D(lines[lineIndex].m_direction, lines[lineIndex].m_point - outResult) <= 0.f) continue;
+
+		Vec2 previousResult = outResult;
+		if (!SolveOnLine(lines, lineIndex, maxSpeed, optimalVelocity, isDirectionOptimal, outResult))
+		{
+			outResult = previousResult;
+			return lineIndex;
+		}
+	}
+	return numLines;
+}
+
+void CrowdSimulation::SolveLeastViolation(CrowdORCALine const* lines, int numLines, int failedLine, float maxSpeed, Vec2& inOutResult)
+{
+	// Too crowded to meet every line, so find the velocity that breaks the worst one by the least
+	float distance = 0.f;
+	CrowdORCALine projectedLines[CROWD_SIMULATION_MAX_NEIGHBORS];
+	for (int lineIndex = failedLine; lineIndex < numLines; lineIndex++)
+	{
+		CrowdORCALine const& line = lines[lineIndex];
+		if (CrossProduct2D(line.m_direction, line.m_point - inOutResult) <= distance) continue;
+
+		int numProjectedLines = 0;
+		for (int otherIndex = 0; otherIndex < lineIndex; otherIndex++)
+		{
+			CrowdORCALine const& other = lines[otherIndex];
+			CrowdORCALine& projectedLine = projectedLines[numProjectedLines];
+			float determinant = CrossProduct2D(line.m_direction, other.m_direction);
+			if (fabsf(determinant) <= CROWD_SIMULATION_EPSILON)
+			{
+				if (DotProduct2D(line.m_direction, other.m_direction) > 0.f) continue; // Same way, nothing new
+				projectedLine.m_point = (line.m_point + other.m_point) * 0.5f;
+			}
+			else
+			{
+				projectedLine.m_point = line.m_point + line.m_direction * (CrossProduct2D(other.m_direction, line.m_point - other.m_point) / determinant);
+			}
+			projectedLine.m_direction = (other.m_direction - line.m_direction).GetNormalized();
+			numProjectedLines++;
+		}
+
+		Vec2 previousResult = inOutResult;
+		if (SolveInsideLines(projectedLines, numProjectedLines, maxSpeed, Vec2(-line.m_direction.y, line.m_direction.x), true, inOutResult) < numProjectedLines)
+		{
+			// Can only fail from rounding, the result already satisfied these lines
+			inOutResult = previousResult;
+		}
+		distance = CrossProduct2D(line.m_direction, line.m_point - inOutResult);
+	}
+}
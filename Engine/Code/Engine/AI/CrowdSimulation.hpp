@@ -0,0 +1,80 @@
+#pragma once
+#include "Engine/AI/CrowdNeighborIndex.hpp"
+#include "Engine/Math/Vec2.hpp"
+#include "Engine/Math/Vec3.hpp"
+#include <vector>
+
+struct AIAgent;
+
+constexpr int CROWD_SIMULATION_MAX_NEIGHBORS = 10;
+constexpr int CROWD_SIMULATION_CHUNK_SIZE = 256; // Agents per job in every pass
+constexpr float CROWD_SIMULATION_EPSILON = 0.00001f;
+
+// ORCA half plane in velocity space, velocities on the left of the directed line are allowed
+struct CrowdORCALine
+{
+	Vec2 m_point;
+	Vec2 m_direction;
+};
+
+// Steps a whole crowd at once. Agents are stored as one array per field, and velocities are double buffered: every agent solves
+// against last step's velocities, so the result doesn't depend on agent order and the passes can split the crowd over any number of jobs.
+// Each step rebuilds the neighbor index, finds neighbors, solves ORCA (van den Berg et al.) on the XY plane, then integrates
+class CrowdSimulation
+{
+public:
+	CrowdSimulation() = default;
+	~CrowdSimulation() = default;
+
+	int AddAgent(Vec3 const& position, float radius, float maxSpeed); // Returns the agent ID
+	void Clear();
+	void Step(float deltaSeconds);
+
+	// Copy in from and back out to AIAgent structs, agent IDs match their index in the list
+	void ReadFromAgents(std::vector<AIAgent*> const& agents);
+	void WriteToAgents(std::vector<AIAgent*> const& agents) const;
+
+	void SetPreferredVelocity(int agentID, Vec2 const& preferredVelocity) { m_preferredVelocityX[agentID] = preferredVelocity.x; m_preferredVelocityY[agentID] = preferredVelocity.y; }
+	Vec3 GetPosition(int agentID) const { return Vec3(m_positionX[agentID], m_positionY[agentID], m_positionZ[agentID]); }
+	Vec2 GetVelocity(int agentID) const { return Vec2(m_velocityX[m_currentVelocityBuffer][agentID], m_velocityY[m_currentVelocityBuffer][agentID]); }
+	int GetNumAgents() const { return static_cast<int>(m_positionX.size()); }
+	CrowdNeighborIndex const& GetNeighborIndex() const { return m_neighborIndex; } // Built from the position arrays, so it holds no AIAgents and can't feed ObstacleAvoidnace
+
+	// Passes, Step runs them in this order
+	void FindNeighbors();
+	void SolveVelocities(float deltaSeconds); // Reads the current velocity buffer, writes the other one
+	void Integrate(float deltaSeconds); // Moves with the new velocities, then they become current
+
+private:
+	Vec2 SolveAgentVelocity(int agentID, float deltaSeconds) const;
+	void ResizeArrays(int numAgents);
+
+	// Linear programs over the ORCA lines, from the RVO2 reference solver
+	static bool SolveOnLine(CrowdORCALine const* lines, int lineIndex, float maxSpeed, Vec2 const& optimalVelocity, bool isDirectionOptimal, Vec2& inOutResult);
+	static int SolveInsideLines(CrowdORCALine const* lines, int numLines, float maxSpeed, Vec2 const& optimalVelocity, bool isDirectionOptimal, Vec2& outResult);
+	static void SolveLeastViolation(CrowdORCALine const* lines, int numLines, int failedLine, float maxSpeed, Vec2& inOutResult);
+
+	template <typename T_Function>
+	void ForEachAgentChunk(T_Function const& function) const; // function(beginAgentID, endAgentID) on every chunk, spread over the job system
+
+public:
+	float m_neighborRadius = 5.f; // Also the neighbor index cell size
+	float m_timeHorizon = 2.f; // Seconds ahead other agents are avoided
+
+private:
+	std::vector<float> m_positionX;
+	std::vector<float> m_positionY;
+	std::vector<float> m_positionZ;
+	std::vector<float> m_velocityX[2];
+	std::vector<float> m_velocityY[2];
+	std::vector<float> m_preferredVelocityX;
+	std::vector<float> m_preferredVelocityY;
+	std::vector<float> m_radius;
+	std::vector<float> m_maxSpeed;
+	int m_currentVelocityBuffer = 0;
+
+	CrowdNeighborIndex m_neighborIndex;
+	std::vector<int> m_neighborIDs; // CROWD_SIMULATION_MAX_NEIGHBORS slots per agent, nearest first
+	std::vector<int> m_numNeighbors;
+	std::vector<std::vector<int>> m_chunkQueryScratch; // One per chunk so neighbor queries don't allocate after the first step
+};
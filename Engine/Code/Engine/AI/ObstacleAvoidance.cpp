@@ -1,4 +1,6 @@
 #include "Engine/AI/ObstacleAvoidance.hpp"
+#include "Engine/AI/CrowdNeighborIndex.hpp"
+#include "Engine/Core/ErrorWarningAssert.hpp"
 #include "Engine/Renderer/DebugRenderer.hpp"
 #include "Engine/Renderer/NavMesh.hpp"
 
@@ -38,7 +40,34 @@ VO ObstacleAvoidnace::CalculateVO(const AIAgent& agent, const AIAgent& other)
 	return vo;
 }
 
-void ObstacleAvoidnace::ComputeVO(AIAgent& agent, float searchRadius, const std::vector<AIAgent*> nearbyActors, bool enableDebug)
+AIAgent* ObstacleAvoidnace::GatherNearbyActors(CrowdNeighborIndex const& crowdIndex, int agentID, float searchRadius)
+{
+	// An index rebuilt from position arrays has IDs but no AIAgents to steer, e.g. CrowdSimulation's
+	ASSERT_OR_DIE(crowdIndex.IsBuiltFromAgents(), "ObstacleAvoidnace needs a CrowdNeighborIndex rebuilt from AIAgents");
+	m_nearbyAgentIDs.clear();
+	m_nearbyActors.clear();
+
+	// Null agents are left out of the index, but an ID can still point at one
+	AIAgent* agent = (agentID >= 0 && agentID < crowdIndex.GetNumAgents()) ? crowdIndex.GetAgent(agentID) : nullptr;
+	if (!agent) return nullptr;
+
+	crowdIndex.QueryRadius(agentID, searchRadius, m_nearbyAgentIDs);
+	for (int nearbyAgentID : m_nearbyAgentIDs)
+	{
+		AIAgent* nearbyAgent = crowdIndex.GetAgent(nearbyAgentID);
+		if (nearbyAgent) m_nearbyActors.emplace_back(nearbyAgent);
+	}
+	return agent;
+}
+
+void ObstacleAvoidnace::ComputeVO(CrowdNeighborIndex const& crowdIndex, int agentID, float searchRadius, bool enableDebug)
+{
+	AIAgent* agent = GatherNearbyActors(crowdIndex, agentID, searchRadius);
+	if (!agent) return;
+	ComputeVO(*agent, searchRadius, m_nearbyActors, enableDebug);
+}
+
+void ObstacleAvoidnace::ComputeVO(AIAgent& agent, float searchRadius, std::vector<AIAgent*> const& nearbyActors, bool enableDebug)
 {
 	if (enableDebug)
 	{
@@ -121,7 +150,14 @@ Vec3 ObstacleAvoidnace::FindAlternativeVelocity(const AIAgent& agent, const VO&
 	return alternativeVelocity;
 }
 
-void ObstacleAvoidnace::ComputeRVO(AIAgent& agent, float searchRadius, const std::vector<AIAgent*> nearbyActors, bool enableDebug)
+void ObstacleAvoidnace::ComputeRVO(CrowdNeighborIndex const& crowdIndex, int agentID, float searchRadius, bool enableDebug)
+{
+	AIAgent* agent = GatherNearbyActors(crowdIndex, agentID, searchRadius);
+	if (!agent) return;
+	ComputeRVO(*agent, searchRadius, m_nearbyActors, enableDebug);
+}
+
+void ObstacleAvoidnace::ComputeRVO(AIAgent& agent, float searchRadius, std::vector<AIAgent*> const& nearbyActors, bool enableDebug)
 {
 	if (enableDebug)
 	{
@@ -196,7 +232,14 @@ bool ObstacleAvoidnace::IsInsideRVO(const Vec3& velocity, const RVO& rvo)
 	return leftCross.z < 0.f && rightCross.z > 0.f;
 }
 
-void ObstacleAvoidnace::ComputeHRVO(AIAgent& agent, float searchRadius, const std::vector<AIAgent*> nearbyActors, bool enableDebug)
+void ObstacleAvoidnace::ComputeHRVO(CrowdNeighborIndex const& crowdIndex, int agentID, float searchRadius, bool enableDebug)
+{
+	AIAgent* agent = GatherNearbyActors(crowdIndex, agentID, searchRadius);
+	if (!agent) return;
+	ComputeHRVO(*agent, searchRadius, m_nearbyActors, enableDebug);
+}
+
+void ObstacleAvoidnace::ComputeHRVO(AIAgent& agent, float searchRadius, std::vector<AIAgent*> const& nearbyActors, bool enableDebug)
 {
 	if (enableDebug)
 	{
@@ -280,7 +323,14 @@ bool ObstacleAvoidnace::IsInsideHRVO(const Vec3& velocity, const HRVO& hrvo)
 	return leftCross.z < 0.f && rightCross.z > 0.f;
 }
 
-void ObstacleAvoidnace::ComputeORCA(AIAgent& agent, float searchRadius, std::vector<AIAgent*> nearbyActors, bool enableDebug)
+void ObstacleAvoidnace::ComputeORCA(CrowdNeighborIndex const& crowdIndex, int agentID, float searchRadius, bool enableDebug)
+{
+	AIAgent* agent = GatherNearbyActors(crowdIndex, agentID, searchRadius);
+	if (!agent) return;
+	ComputeORCA(*agent, searchRadius, m_nearbyActors, enableDebug);
+}
+
+void ObstacleAvoidnace::ComputeORCA(AIAgent& agent, float searchRadius, std::vector<AIAgent*> const& nearbyActors, bool enableDebug)
 {
 	if (enableDebug)
 	{
@@ -5,6 +5,7 @@
 
 struct NavMesh;
 class NavMeshHeatMap;
+class CrowdNeighborIndex;
 
 struct AIAgent
 {
@@ -80,24 +81,36 @@ public:
 public:
 	// VO 
 	VO CalculateVO(const AIAgent& agent, const AIAgent& other);
-	void ComputeVO(AIAgent& agent, float searchRadius, const std::vector<AIAgent*> nearbyActors, bool enableDebug = false);
+	void ComputeVO(AIAgent& agent, float searchRadius, std::vector<AIAgent*> const& nearbyActors, bool enableDebug = false);
+	void ComputeVO(CrowdNeighborIndex const& crowdIndex, int agentID, float searchRadius, bool enableDebug = false);
 	bool IsInsideVO(const Vec3& velocity, const VO& vo);
 	Vec3 FindAlternativeVelocity(const AIAgent& agent, const VO& vo);
 
 	// RVO
-	void ComputeRVO(AIAgent& agent, float searchRadius, const std::vector<AIAgent*> nearbyActors, bool enableDebug = false);
+	void ComputeRVO(AIAgent& agent, float searchRadius, std::vector<AIAgent*> const& nearbyActors, bool enableDebug = false);
+	void ComputeRVO(CrowdNeighborIndex const& crowdIndex, int agentID, float searchRadius, bool enableDebug = false);
 	bool IsInsideRVO(const Vec3& velocity, const RVO& rvo);
 
 	// HRVO
-	void ComputeHRVO(AIAgent& agent, float searchRadius, const std::vector<AIAgent*> nearbyActors, bool enableDebug = false);
+	void ComputeHRVO(AIAgent& agent, float searchRadius, std::vector<AIAgent*> const& nearbyActors, bool enableDebug = false);
+	void ComputeHRVO(CrowdNeighborIndex const& crowdIndex, int agentID, float searchRadius, bool enableDebug = false);
 	bool IsInsideHRVO(const Vec3& velocity, const HRVO& hrvo);
 
 	// ORCA
-	void ComputeORCA(AIAgent& agent, float searchRadius, const std::vector<AIAgent*> nearbyActors, bool enableDebug = false);
+	void ComputeORCA(AIAgent& agent, float searchRadius, std::vector<AIAgent*> const& nearbyActors, bool enableDebug = false);
+	void ComputeORCA(CrowdNeighborIndex const& crowdIndex, int agentID, float searchRadius, bool enableDebug = false);
 	bool IsInsideORCAConstraint(const Vec3& velocity, const Vec3& constraintPoint, const Vec3& normal);
 	Vec3 FindAlternativeVelocity(const Vec3& preferredVelocity, const Vec3& halfPlaneNormal);
 
+private:
+	// Agents within searchRadius of agentID in the crowd index, into m_nearbyActors. Returns the agent itself, null when agentID has no agent
+	AIAgent* GatherNearbyActors(CrowdNeighborIndex const& crowdIndex, int agentID, float searchRadius);
+
 private:
 	NavMesh* m_navMesh = nullptr;
 	NavMeshHeatMap* m_heatMap = nullptr;
+
+	// Reused by the crowd index overloads, so give each thread its own ObstacleAvoidnace
+	std::vector<int> m_nearbyAgentIDs;
+	std::vector<AIAgent*> m_nearbyActors;
 };
\ No newline at end of file
@@ -1,7 +1,153 @@
 #include "Engine/AI/Pathfinding/Grid/GridAStar.hpp"
+#include "Engine/AI/Pathfinding/Grid/GridBenchmarkMaps.hpp"
 #include "Engine/Core/Time.hpp"
+#include "Engine/Core/EngineCommon.hpp"
 #include "Engine/Core/DevConsole.hpp"
+#include "Engine/Core/ErrorWarningAssert.hpp"
+#include "Engine/Math/RandomNumberGenerator.hpp"
 #include "Engine/Renderer/DebugRenderer.hpp"
+#include <algorithm>
+#include <limits>
+
+// GridAStar's layout before SearchScratch was split into arrays: one struct per cell, and a binary heap of pointers into them that
+// reads m_fCost through the pointer on every comparison. Only Command_GridAStarLayoutBenchmark uses it, as the thing to beat
+struct PointerHeapNode
+{
+	IntVec2 m_position = IntVec2(-1, -1);
+	IntVec2 m_parent = IntVec2(-1, -1);
+	float m_totalgCost = 0.f;
+	float m_fCost = 0.f;
+	int m_openPathGen = -1;
+	int m_closedPathGen = -1;
+	int m_heapIndex = -1;
+};
+
+struct PointerHeapSearch
+{
+	std::vector<PointerHeapNode> m_nodeGrid;
+	std::vector<PointerHeapNode*> m_heap;
+	int m_pathGen = 0;
+	int m_numNodesExpanded = 0;
+
+	void Push(PointerHeapNode* node)
+	{
+		m_heap.emplace_back(node);
+		node->m_heapIndex = static_cast<int>(m_heap.size()) - 1;
+		PercolateUp(static_cast<size_t>(node->m_heapIndex));
+	}
+
+	PointerHeapNode* Pop()
+	{
+		PointerHeapNode* minNode = m_heap.front();
+		m_heap[0] = m_heap.back();
+		m_heap[0]->m_heapIndex = 0;
+		m_heap.pop_back();
+		if (!m_heap.empty())
+		{
+			PercolateDown(0);
+		}
+		minNode->m_heapIndex = -1;
+		return minNode;
+	}
+
+	void PercolateUp(size_t index)
+	{
+		while (index > 0)
+		{
+			size_t parent = (index - 1) / 2;
+			if (!(m_heap[index]->m_fCost < m_heap[parent]->m_fCost)) break;
+
+			std::swap(m_heap[index], m_heap[parent]);
+			std::swap(m_heap[index]->m_heapIndex, m_heap[parent]->m_heapIndex);
+			index = parent;
+		}
+	}
+
+	void PercolateDown(size_t index)
+	{
+		while (true)
+		{
+			size_t leftChild = index * 2 + 1;
+			size_t rightChild = index * 2 + 2;
+			size_t smallest = index;
+			if (leftChild < m_heap.size() && m_heap[leftChild]->m_fCost < m_heap[smallest]->m_fCost) smallest = leftChild;
+			if (rightChild < m_heap.size() && m_heap[rightChild]->m_fCost < m_heap[smallest]->m_fCost) smallest = rightChild;
+			if (smallest == index) break;
+
+			std::swap(m_heap[index], m_heap[smallest]);
+			std::swap(m_heap[index]->m_heapIndex, m_heap[smallest]->m_heapIndex);
+			index = smallest;
+		}
+	}
+
+	// 8 way over the walkability grid with GridAStar's default squared distance costs, so both searches do the same work
+	void ComputePath(GridWalkabilityGrid const& walkabilityGrid, int grid, IntVec2 start, IntVec2 goal, std::vector<IntVec2>& outPath)
+	{
+		if (static_cast<int>(m_nodeGrid.size()) != grid * grid)
+		{
+			m_nodeGrid.assign(grid * grid, PointerHeapNode());
+		}
+
+		int pathGen = ++m_pathGen;
+		m_numNodesExpanded = 0;
+		m_heap.clear();
+		outPath.clear();
+
+		PointerHeapNode* startNode = &m_nodeGrid[(start.y * grid) + start.x];
+		startNode->m_position = start;
+		startNode->m_totalgCost = 0.f;
+		startNode->m_fCost = static_cast<float>(GetLengthSquared(start, goal));
+		startNode->m_openPathGen = pathGen;
+		Push(startNode);
+
+		while (!m_heap.empty())
+		{
+			PointerHeapNode* currentNode = Pop();
+			if (currentNode->m_closedPathGen == pathGen) continue;
+			currentNode->m_closedPathGen = pathGen;
+			m_numNodesExpanded++;
+
+			if (currentNode->m_position == goal)
+			{
+				while (currentNode->m_position != start)
+				{
+					outPath.emplace_back(currentNode->m_position);
+					currentNode = &m_nodeGrid[(currentNode->m_parent.y * grid) + currentNode->m_parent.x];
+				}
+				return;
+			}
+
+			for (int direction = 0; direction < NUM_INTERCARDINAL_DIRECTIONS; direction++)
+			{
+				IntVec2 stepDirection = GetStepInCardinalAndIntercardinalDirection(IntercardinalDir(direction));
+				if (!walkabilityGrid.CanStep(currentNode->m_position, stepDirection)) continue;
+
+				IntVec2 neighborCoords = currentNode->m_position + stepDirection;
+				PointerHeapNode* neighborNode = &m_nodeGrid[(neighborCoords.y * grid) + neighborCoords.x];
+				if (neighborNode->m_closedPathGen == pathGen) continue;
+
+				float totalgCost = currentNode->m_totalgCost + static_cast<float>(GetLengthSquared(neighborCoords, currentNode->m_position));
+				float fCost = totalgCost + static_cast<float>(GetLengthSquared(neighborCoords, goal));
+				bool isOpenThisSearch = (neighborNode->m_openPathGen == pathGen);
+				if (isOpenThisSearch && !(fCost < neighborNode->m_fCost)) continue;
+
+				neighborNode->m_position = neighborCoords;
+				neighborNode->m_totalgCost = totalgCost;
+				neighborNode->m_fCost = fCost;
+				neighborNode->m_parent = currentNode->m_position;
+				if (!isOpenThisSearch)
+				{
+					neighborNode->m_openPathGen = pathGen;
+					Push(neighborNode);
+				}
+				else
+				{
+					PercolateUp(static_cast<size_t>(neighborNode->m_heapIndex));
+				}
+			}
+		}
+	}
+};
 
 GridAStar::GridAStar(IntVec2 grid)
 {
@@ -11,118 +157,152 @@ GridAStar::GridAStar(IntVec2 grid)
 void GridAStar::InitializeNodeGrid(IntVec2 const& grid)
 {
 	m_grid = grid.x;
-	int mapDimensions = m_grid * m_grid;
-	m_nodeGrid.resize(mapDimensions);
-	for (int y = 0; y < grid.y; y++)
+	m_scratch.Initialize(m_grid);
+}
+
+void GridAStar::SetWalkabilityGrid(GridWalkabilityGrid const* walkabilityGrid)
+{
+	// The walkability border stands in for the bounds check, so it must not reach past the node grid
+	ASSERT_OR_DIE(!walkabilityGrid || (walkabilityGrid->GetDimensions().x <= m_grid && walkabilityGrid->GetDimensions().y <= m_grid), "Walkability grid is larger than the A* node grid");
+	m_walkabilityGrid = walkabilityGrid;
+}
+
+void GridAStar::SearchScratch::Initialize(int grid)
+{
+	m_pathGen = 0;
+	m_numNodes = grid * grid;
+	m_gCosts.assign(m_numNodes, std::numeric_limits<float>::max());
+	m_nodeGens.assign(m_numNodes, -1);
+	m_parents.assign(m_numNodes, GRID_ASTAR_NO_PARENT);
+	m_openList.Clear();
+	m_openList.Initialize(m_numNodes);
+}
+
+void GridAStar::ComputeAStar(IntVec2 start, IntVec2 goal, std::vector<IntVec2>& outPath)
+{
+	ComputeAStar(start, goal, outPath, m_scratch);
+}
+
+void GridAStar::ComputeAStar(IntVec2 start, IntVec2 goal, std::vector<IntVec2>& outPath, SearchScratch& scratch) const
+{
+	if (m_directionMode == DirectionMode::Cardinal4)
 	{
-		for (int x = 0; x < grid.x; x++)
-		{
-			int index = (y * m_grid) + x;
-			m_nodeGrid[index] = Node{ IntVec2(x, y), std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), IntVec2(-1, -1), -1, -1 };
-		}
+		ComputeAStarInMode<DirectionMode::Cardinal4>(start, goal, outPath, scratch);
+	}
+	else
+	{
+		ComputeAStarInMode<DirectionMode::Cardinal8>(start, goal, outPath, scratch);
 	}
 }
 
-void GridAStar::ComputeAStar(IntVec2 start, IntVec2 goal, std::vector<IntVec2>& outPath)
+template <DirectionMode T_Mode>
+void GridAStar::ComputeAStarInMode(IntVec2 start, IntVec2 goal, std::vector<IntVec2>& outPath, SearchScratch& scratch) const
 {
-	m_pathGen++;
-	
-	CustomHeap openList;
-	int mapSize = m_grid * m_grid;
-	openList.Resverve(mapSize);
+	typedef GridNeighborSteps<T_Mode> Steps;
+
+	if (scratch.m_numNodes != m_grid * m_grid)
+	{
+		scratch.Initialize(m_grid);
+	}
+
+	scratch.m_pathGen++;
+	scratch.m_numNodesExpanded = 0;
+	float* gCosts = scratch.m_gCosts.data();
+	int* parents = scratch.m_parents.data();
+	OpenList& openList = scratch.m_openList;
+	openList.Clear();
 
 	int startIndex = (start.y * m_grid) + start.x;
 
-	if (startIndex < 0 || startIndex >= static_cast<int>(m_nodeGrid.size())) return;
+	if (startIndex < 0 || startIndex >= scratch.m_numNodes) return;
+
+	int indexOffsets[Steps::NUM_STEPS];
+	GetGridNeighborIndexOffsets<T_Mode>(m_grid, indexOffsets);
 
-	Node* startNode = &m_nodeGrid[startIndex];
-	startNode->m_position = start;
-	startNode->m_totalgCost = 0;
-	startNode->m_fCost = static_cast<float>(GetLengthSquared(start, goal));
-	startNode->m_openPathGen = m_pathGen;
-	startNode->m_closedPathGen = -1;
+	bool isOctile = (m_costMetric == GridAStarCostMetric::Octile);
+	float stepCosts[Steps::NUM_STEPS];
+	for (int direction = 0; direction < Steps::NUM_STEPS; direction++)
+	{
+		bool isDiagonalStep = (Steps::STEP_X[direction] != 0 && Steps::STEP_Y[direction] != 0);
+		stepCosts[direction] = isDiagonalStep ? (isOctile ? 1.41421356f : 2.f) : 1.f;
+	}
+	auto getHeuristic = [&](IntVec2 const& from)
+	{
+		if (m_heuristic) return static_cast<float>(m_heuristic(from, goal));
+		return isOctile ? GetOctileDistance(from, goal) : static_cast<float>(GetLengthSquared(from, goal));
+	};
 
-	openList.Push(startNode);
+	gCosts[startIndex] = 0.f;
+	parents[startIndex] = GRID_ASTAR_NO_PARENT;
+	scratch.SetOpen(startIndex);
+	openList.Push(startIndex, getHeuristic(start));
 
+	int maxSearchDistanceSq = m_maxSearchDistance * m_maxSearchDistance;
 	while (!openList.Empty())
 	{
-		Node* currentNode = openList.Pop();
+		int currentIndex = openList.Pop();
 
-		if (currentNode->m_closedPathGen == m_pathGen) continue;
-		currentNode->m_closedPathGen = m_pathGen;
+		if (scratch.IsClosed(currentIndex)) continue;
+		scratch.SetClosed(currentIndex);
+		scratch.m_numNodesExpanded++;
 
-		// If we found goal then compute path
-		if (currentNode->m_position == goal)
-		{
-			if (!outPath.empty()) outPath.clear();
+		IntVec2 currentPosition(currentIndex % m_grid, currentIndex / m_grid);
 
-			while (currentNode->m_position != start)
+		// Found the goal, or got past the distance threshold and hand back the partial path
+		if (currentPosition == goal || GetLengthSquared(currentPosition, start) > maxSearchDistanceSq)
+		{
+			outPath.clear();
+			for (int pathIndex = currentIndex; pathIndex != startIndex; pathIndex = parents[pathIndex])
 			{
-				outPath.emplace_back(currentNode->m_position);
-				int parentIndex = (currentNode->m_parent.y * m_grid) + currentNode->m_parent.x;
-				currentNode = &m_nodeGrid[parentIndex];
+				outPath.emplace_back(IntVec2(pathIndex % m_grid, pathIndex / m_grid));
 			}
 			openList.Clear();
 			return;
 		}
 
-		// Distance Threshold check
-		int distanceSq = GetLengthSquared(currentNode->m_position, start);
-		if (distanceSq > MAX_DIST_THRESHOLD * MAX_DIST_THRESHOLD)
+		float currentgCost = gCosts[currentIndex];
+		auto visitNeighbor = [&](int direction, int stepX, int stepY)
 		{
-			// Generate Partial Path
-			if (!outPath.empty()) outPath.clear();
+			int neighborIndex = currentIndex + indexOffsets[direction];
+			if (scratch.IsClosed(neighborIndex)) return;
+
+			// Costs left over from an earlier search don't count, the node is untouched until this search opens it.
+			// A cell's heuristic never changes, so a lower g is a lower f
+			float totalgCost = currentgCost + stepCosts[direction];
+			bool isOpenThisSearch = scratch.IsOpen(neighborIndex);
+			if (isOpenThisSearch && totalgCost >= gCosts[neighborIndex]) return;
 
-			while (currentNode->m_position != start)
+			IntVec2 neighborCoords(currentPosition.x + stepX, currentPosition.y + stepY);
+			float fCost = totalgCost + getHeuristic(neighborCoords);
+			gCosts[neighborIndex] = totalgCost;
+			parents[neighborIndex] = currentIndex;
+
+			if (!isOpenThisSearch)
 			{
-				outPath.emplace_back(currentNode->m_position);
-				int parentIndex = (currentNode->m_parent.y * m_grid) + currentNode->m_parent.x;
-				currentNode = &m_nodeGrid[parentIndex];
+				scratch.SetOpen(neighborIndex);
+				openList.Push(neighborIndex, fCost);
 			}
-			return;
-		}
+			else
+			{
+				openList.DecreaseKey(neighborIndex, fCost);
+			}
+		};
 
-		int numDirections = (m_directionMode == DirectionMode::Cardinal4) ? NUM_CARDINAL_DIRECTIONS : NUM_INTERCARDINAL_DIRECTIONS;
-		for (int direction = 0; direction < numDirections; direction++)
+		if (m_walkabilityGrid)
 		{
-			IntVec2 stepDirection = (m_directionMode == DirectionMode::Cardinal4) ? GetStepInCardinalDirection(CardinalDir(direction)) : GetStepInCardinalAndIntercardinalDirection(IntercardinalDir(direction));
-			bool isDiagonal = IsDiagonal(stepDirection);
-			IntVec2 neighborCoords = currentNode->m_position + stepDirection;
+			// Padded border means no bounds check, and no std::function call per neighbor
+			m_walkabilityGrid->ForEachOpenStep<T_Mode>(currentPosition.x, currentPosition.y, visitNeighbor);
+			continue;
+		}
 
-			if (!m_isSolidCallback(neighborCoords))
-			{
-				if (isDiagonal || (!m_canMoveDiagonalCallback || m_canMoveDiagonalCallback(currentNode->m_position, neighborCoords)))
-				{
-					if (neighborCoords.x < 0 || neighborCoords.x >= m_grid || neighborCoords.y < 0 || neighborCoords.y >= m_grid) continue;
-
-					int neighborIndex = (neighborCoords.y * m_grid) + neighborCoords.x;
-					Node* neighborNode = &m_nodeGrid[neighborIndex];
-					if (neighborNode->m_closedPathGen == m_pathGen) continue;
-
-					int localgCost = GetLengthSquared(neighborCoords, currentNode->m_position);
-					float totatgCost = currentNode->m_totalgCost + localgCost;
-					int hCost = GetLengthSquared(neighborCoords, goal);
-					float fCost = totatgCost + hCost;
-
-					if (fCost < neighborNode->m_fCost)
-					{
-						neighborNode->m_position = neighborCoords;
-						neighborNode->m_totalgCost = totatgCost;
-						neighborNode->m_fCost = fCost;
-						neighborNode->m_parent = currentNode->m_position;
-
-						if (neighborNode->m_openPathGen != m_pathGen)
-						{
-							neighborNode->m_openPathGen = m_pathGen;
-							openList.Push(neighborNode);
-						}
-						else
-						{
-							openList.DecreaseKey(neighborNode);
-						}
-					}
-				}
-			}
+		for (int direction = 0; direction < Steps::NUM_STEPS; direction++)
+		{
+			IntVec2 stepDirection(Steps::STEP_X[direction], Steps::STEP_Y[direction]);
+			IntVec2 neighborCoords = currentPosition + stepDirection;
+			if (neighborCoords.x < 0 || neighborCoords.x >= m_grid || neighborCoords.y < 0 || neighborCoords.y >= m_grid) continue;
+			if (m_isSolidCallback(neighborCoords)) continue;
+			if (IsDiagonal(stepDirection) && m_canMoveDiagonalCallback && !m_canMoveDiagonalCallback(currentPosition, neighborCoords)) continue;
+			visitNeighbor(direction, stepDirection.x, stepDirection.y);
 		}
 	}
 
@@ -142,81 +322,147 @@ void GridAStar::TestAStarPathFinding(IntVec2 start, IntVec2 goal, std::vector<In
 	g_theConsole->AddLine(Rgba8::LIGHT_ORANGE, Stringf("The approximate size of one path is %i", pathSizeInBytes));
 }
 
-void GridAStar::CustomHeap::Push(Node* node)
+void GridAStar::SubscribeConsoleCommands()
 {
-	m_elements.emplace_back(node);
-	node->m_heapIndex = static_cast<int>(m_elements.size()) - 1;
-	PercolateUp(node->m_heapIndex);
+	if (g_theEventSystem)
+	{
+		g_theEventSystem->SubscribeEventCallbackFunction("GridAStarLayoutBenchmark", Command_GridAStarLayoutBenchmark);
+	}
 }
 
-void GridAStar::CustomHeap::DecreaseKey(Node* node)
+void GridAStar::UnsubscribeConsoleCommands()
 {
-	if (node->m_heapIndex >= 0 && node->m_heapIndex < static_cast<int>(m_elements.size()))
+	if (g_theEventSystem)
 	{
-		PercolateUp(static_cast<size_t>(node->m_heapIndex));
+		g_theEventSystem->UnsubscribeEventCallbackFunction("GridAStarLayoutBenchmark", Command_GridAStarLayoutBenchmark);
+	}
+}
+
+bool GridAStar::Command_GridAStarLayoutBenchmark(EventArgs& args)
+{
+	int mapSize = std::stoi(args.GetValue<std::string>("size", "1024"));
+	int numQueries = std::stoi(args.GetValue<std::string>("queries", "50"));
+	unsigned int seed = static_cast<unsigned int>(std::stoi(args.GetValue<std::string>("seed", "1")));
+
+	GridWalkabilityGrid walkabilityGrid;
+	BuildOpenGridBenchmarkMap(walkabilityGrid, IntVec2(mapSize, mapSize), 0.2f, seed);
+
+	GridAStar aStar(IntVec2(mapSize, mapSize));
+	aStar.SetDirectionMode(DirectionMode::Cardinal8);
+	aStar.SetWalkabilityGrid(&walkabilityGrid);
+	aStar.m_maxSearchDistance = mapSize * 2;
+
+	PointerHeapSearch pointerHeapSearch;
+	pointerHeapSearch.m_nodeGrid.resize(mapSize * mapSize);
+
+	// Pick every query up front so both searches get the same ones and rolling isn't timed
+	RandomNumberGenerator rng(seed);
+	std::vector<IntVec2> queryPoints;
+	queryPoints.reserve(numQueries * 2);
+	for (int attempt = 0; static_cast<int>(queryPoints.size()) < numQueries * 2 && attempt < numQueries * 200; attempt++)
+	{
+		IntVec2 point(rng.SRollRandomIntInRange(0, mapSize - 1), rng.SRollRandomIntInRange(0, mapSize - 1));
+		if (!walkabilityGrid.IsSolid(point))
+		{
+			queryPoints.emplace_back(point);
+		}
 	}
+	int numQueriesRun = static_cast<int>(queryPoints.size()) / 2;
+
+	std::vector<IntVec2> path;
+	double arraysMs = 0.0;
+	double pointerHeapMs = 0.0;
+	long long arraysNodesExpanded = 0;
+	long long pointerHeapNodesExpanded = 0;
+	for (int query = 0; query < numQueriesRun; query++)
+	{
+		IntVec2 start = queryPoints[query * 2];
+		IntVec2 goal = queryPoints[query * 2 + 1];
+
+		double timeBefore = GetCurrentTimeSeconds();
+		aStar.ComputeAStar(start, goal, path);
+		double timeMiddle = GetCurrentTimeSeconds();
+		pointerHeapSearch.ComputePath(walkabilityGrid, mapSize, start, goal, path);
+		double timeAfter = GetCurrentTimeSeconds();
+
+		arraysMs += 1000.0 * (timeMiddle - timeBefore);
+		pointerHeapMs += 1000.0 * (timeAfter - timeMiddle);
+		arraysNodesExpanded += aStar.GetNumNodesExpanded();
+		pointerHeapNodesExpanded += pointerHeapSearch.m_numNodesExpanded;
+	}
+
+	double arraysNodesPerSecond = (arraysMs > 0.0) ? static_cast<double>(arraysNodesExpanded) / (0.001 * arraysMs) : 0.0;
+	double pointerHeapNodesPerSecond = (pointerHeapMs > 0.0) ? static_cast<double>(pointerHeapNodesExpanded) / (0.001 * pointerHeapMs) : 0.0;
+	g_theConsole->AddLine(Rgba8::LIGHT_ORANGE, Stringf("A* node layout %ix%i, %i queries", mapSize, mapSize, numQueriesRun));
+	g_theConsole->AddLine(Rgba8::LIGHT_ORANGE, Stringf("  Arrays + %i-ary heap:         %.02f ms, %lld nodes expanded, %.02f M nodes/s", GRID_ASTAR_HEAP_ARITY, arraysMs, arraysNodesExpanded, arraysNodesPerSecond / 1000000.0));
+	g_theConsole->AddLine(Rgba8::LIGHT_ORANGE, Stringf("  Node structs + pointer heap: %.02f ms, %lld nodes expanded, %.02f M nodes/s", pointerHeapMs, pointerHeapNodesExpanded, pointerHeapNodesPerSecond / 1000000.0));
+	return true;
+}
+
+void GridAStar::OpenList::Push(int nodeIndex, float fCost)
+{
+	m_entries.emplace_back();
+	SiftUp(m_entries.size() - 1, Entry{ fCost, nodeIndex });
 }
 
-Node* GridAStar::CustomHeap::Pop()
+void GridAStar::OpenList::DecreaseKey(int nodeIndex, float fCost)
 {
-	if (m_elements.empty()) return nullptr;
+	SiftUp(static_cast<size_t>(m_heapIndices[nodeIndex]), Entry{ fCost, nodeIndex });
+}
 
-	Node* minNode = m_elements.front();
-	m_elements[0] = m_elements.back();
-	m_elements.pop_back();
-	PercolateDown(0);
-	minNode->m_heapIndex = -1;
+int GridAStar::OpenList::Pop()
+{
+	if (m_entries.empty()) return -1;
 
-	return minNode;
+	int minNodeIndex = m_entries.front().m_nodeIndex;
+	Entry lastEntry = m_entries.back();
+	m_entries.pop_back();
+	if (!m_entries.empty())
+	{
+		SiftDown(0, lastEntry);
+	}
+	return minNodeIndex;
 }
 
-void GridAStar::CustomHeap::PercolateUp(size_t index)
+// Both sifts move a hole instead of swapping, entry is written once where it lands
+void GridAStar::OpenList::SiftUp(size_t index, Entry entry)
 {
 	while (index > 0)
 	{
-		size_t parent = (index - 1) / 2;
-		if (m_elements[index]->m_fCost < m_elements[parent]->m_fCost)
-		{
-			std::swap(m_elements[index], m_elements[parent]);
-			std::swap(m_elements[index]->m_heapIndex, m_elements[parent]->m_heapIndex);
-			index = parent;
-		}
-		else
-		{
-			break;
-		}
+		size_t parent = (index - 1) / GRID_ASTAR_HEAP_ARITY;
+		if (!(entry.m_fCost < m_entries[parent].m_fCost)) break;
+
+		m_entries[index] = m_entries[parent];
+		m_heapIndices[m_entries[index].m_nodeIndex] = static_cast<int>(index);
+		index = parent;
 	}
+	m_entries[index] = entry;
+	m_heapIndices[entry.m_nodeIndex] = static_cast<int>(index);
 }
 
-void GridAStar::CustomHeap::PercolateDown(size_t index)
+void GridAStar::OpenList::SiftDown(size_t index, Entry entry)
 {
-	size_t leftChild, rightChild, smallest;
-
+	size_t numEntries = m_entries.size();
 	while (true)
 	{
-		leftChild = index * 2 + 1;
-		rightChild = index * 2 + 2;
-		smallest = index;
-
-		if (leftChild < m_elements.size() && m_elements[leftChild]->m_fCost < m_elements[smallest]->m_fCost)
-		{
-			smallest = leftChild;
-		}
+		size_t firstChild = index * GRID_ASTAR_HEAP_ARITY + 1;
+		if (firstChild >= numEntries) break;
 
-		if (rightChild < m_elements.size() && m_elements[rightChild]->m_fCost < m_elements[smallest]->m_fCost)
+		size_t endChild = std::min(firstChild + GRID_ASTAR_HEAP_ARITY, numEntries);
+		size_t smallest = firstChild;
+		for (size_t child = firstChild + 1; child < endChild; child++)
 		{
-			smallest = rightChild;
+			if (m_entries[child].m_fCost < m_entries[smallest].m_fCost)
+			{
+				smallest = child;
+			}
 		}
+		if (!(m_entries[smallest].m_fCost < entry.m_fCost)) break;
 
-		if (smallest != index)
-		{
-			std::swap(m_elements[index], m_elements[smallest]);
-			std::swap(m_elements[index]->m_heapIndex, m_elements[smallest]->m_heapIndex);
-			index = smallest;
-		}
-		else
-		{
-			break;
-		}
+		m_entries[index] = m_entries[smallest];
+		m_heapIndices[m_entries[index].m_nodeIndex] = static_cast<int>(index);
+		index = smallest;
 	}
+	m_entries[index] = entry;
+	m_heapIndices[entry.m_nodeIndex] = static_cast<int>(index);
 }
@@ -1,52 +1,112 @@
 #pragma once
-#include "Engine/AI/Pathfinding/Grid/GridCommon.hpp"
+#include "Engine/AI/Pathfinding/Grid/GridPathfindingManager.hpp"
+#include "Engine/AI/Pathfinding/Grid/GridWalkabilityGrid.hpp"
+#include "Engine/Core/EventSystem.hpp"
 #include <vector>
-#include <queue>
 
-struct Node
-{
-	IntVec2 m_position;
-	IntVec2 m_parent;
-	float m_totalgCost;
-	float m_fCost;
-	int m_openPathGen = -1; 
-	int m_closedPathGen = -1;
-	int m_heapIndex = -1;
-
-	Node() : m_position(-1, -1), m_totalgCost(0), m_fCost(0), m_parent(-1, -1), m_openPathGen(-1), m_closedPathGen(-1), m_heapIndex(-1) {}
-	Node(IntVec2 position, float gCost, float fCost, IntVec2 parent, int nodeOpen, int nodeClosed)
-		:m_position(position), m_totalgCost(gCost), m_fCost(fCost), m_parent(parent), m_openPathGen(nodeOpen), m_closedPathGen(nodeClosed), m_heapIndex(-1) {}
-};
+constexpr int GRID_ASTAR_HEAP_ARITY = 4;
+constexpr int GRID_ASTAR_NO_PARENT = -1;
 
-struct CompareNode
+enum class GridAStarCostMetric
 {
-	bool operator()(Node* left, Node* right) const { return left->m_fCost > right->m_fCost; };
+	SquaredLength, // Straight steps cost 1 and diagonal steps 2, squared distance heuristic. Fast, but the paths aren't the shortest
+	Octile // Straight steps cost 1 and diagonal steps sqrt(2), octile distance heuristic. Same costs as the other grid pathfinders
 };
 
-class GridAStar
+class GridAStar : public IGridPathfinder
 {
 public:
 	GridAStar() = default;
 	GridAStar(IntVec2 grid);
-	virtual ~GridAStar() = default;
+	~GridAStar() override = default;
 
 public:
 	void InitializeNodeGrid(IntVec2 const& grid);
 	void SetDirectionMode(DirectionMode mode) { m_directionMode = mode; }
+	void SetWalkabilityGrid(GridWalkabilityGrid const* walkabilityGrid); // When set, used instead of the callbacks
+	void SetCostMetric(GridAStarCostMetric metric) { m_costMetric = metric; }
+
+	// GRID_ASTAR_HEAP_ARITY-ary min heap of (fCost, node index) pairs held by value, so sifting compares costs in the heap's own
+	// array instead of going out to the nodes. Four children per parent sit next to each other and the tree is half as deep
+	class OpenList
+	{
+	public:
+		struct Entry
+		{
+			float m_fCost;
+			int m_nodeIndex;
+		};
+
+		void Initialize(int numNodes) { m_heapIndices.resize(numNodes); }
+		void Reserve(size_t amount) { m_entries.reserve(amount); }
+		void Push(int nodeIndex, float fCost);
+		void DecreaseKey(int nodeIndex, float fCost);
+		void Clear() { m_entries.clear(); }
+		int Pop();
+		bool Empty() const { return m_entries.empty(); }
+		size_t Size() const { return m_entries.size(); }
+
+	private:
+		std::vector<Entry> m_entries;
+		std::vector<int> m_heapIndices; // Slot in m_entries per node, only meaningful while the node is open
+
+		void SiftUp(size_t index, Entry entry);
+		void SiftDown(size_t index, Entry entry);
+	};
+
+	// Everything one search writes to, one array per field. Give each thread its own and they can all search the same GridAStar at once.
+	// The arrays touched for every neighbor are kept apart from the parents, which are only read to walk the path back
+	struct SearchScratch
+	{
+		void Initialize(int grid);
+		inline bool IsOpen(int nodeIndex) const { return m_nodeGens[nodeIndex] >= m_pathGen * 2; } // Opened this search, closed or not
+		inline bool IsClosed(int nodeIndex) const { return m_nodeGens[nodeIndex] == m_pathGen * 2 + 1; }
+		inline void SetOpen(int nodeIndex) { m_nodeGens[nodeIndex] = m_pathGen * 2; }
+		inline void SetClosed(int nodeIndex) { m_nodeGens[nodeIndex] = m_pathGen * 2 + 1; }
+
+		int m_pathGen = 0;
+		int m_numNodesExpanded = 0; // For the last search
+		int m_numNodes = 0;
+
+		// Hot
+		std::vector<float> m_gCosts;
+		std::vector<int> m_nodeGens; // m_pathGen * 2 once opened, + 1 once closed. Anything lower is left over from an earlier search
+
+		// Cold
+		std::vector<int> m_parents; // Node index, GRID_ASTAR_NO_PARENT for the start
+
+		OpenList m_openList; // Keeps its capacity between searches
+	};
 
 	// A-Star
 	void ComputeAStar(IntVec2 start, IntVec2 goal, std::vector<IntVec2>& outPath);
+	void ComputeAStar(IntVec2 start, IntVec2 goal, std::vector<IntVec2>& outPath, SearchScratch& scratch) const; // Only reads the grid and callbacks
+	template <DirectionMode T_Mode>
+	void ComputeAStarInMode(IntVec2 start, IntVec2 goal, std::vector<IntVec2>& outPath, SearchScratch& scratch) const; // ComputeAStar picks the mode once per search
+
+	void ComputePath(IntVec2 start, IntVec2 goal, std::vector<IntVec2>& outPath) override { ComputeAStar(start, goal, outPath); }
+	void SetHeuristic(std::function<int(IntVec2, IntVec2)> heuristic) override { m_heuristic = heuristic; }
+	int GetNumNodesExpanded() const override { return m_scratch.m_numNodesExpanded; }
 
 	// Debug A-Star
 	void TestAStarPathFinding(IntVec2 start, IntVec2 goal, std::vector<IntVec2>& path);
 
+	static void SubscribeConsoleCommands(); // Once at startup, after the event system exists
+	static void UnsubscribeConsoleCommands();
+	// Nodes expanded per second with these arrays and OpenList, against one Node struct per cell and a binary heap of Node pointers
+	static bool Command_GridAStarLayoutBenchmark(EventArgs& args);
+
 public:
-	int m_pathGen = 0;
 	int m_grid = 0;
+	int m_maxSearchDistance = MAX_DIST_THRESHOLD; // Past this many tiles from the start the search gives up and returns a partial path
 
 	DirectionMode m_directionMode = DirectionMode::Cardinal4;
+	GridAStarCostMetric m_costMetric = GridAStarCostMetric::SquaredLength;
+
+	SearchScratch m_scratch; // Used by the single threaded ComputeAStar
 
-	std::vector<Node> m_nodeGrid;
+	GridWalkabilityGrid const* m_walkabilityGrid = nullptr; // Not owned
+	std::function<int(IntVec2, IntVec2)> m_heuristic = nullptr; // Picked by m_costMetric when unset
 
 public:
 	using IsSolidCallbackFunc = std::function<bool(IntVec2)>;
@@ -58,23 +118,5 @@ public:
 	void SetIsSolidCallback(IsSolidCallbackFunc callbackFunc) { m_isSolidCallback = callbackFunc; }
 	void SetCanMoveDiagonalCallback(CanMoveDiagonalCallbackFunc callbackFunc) { m_canMoveDiagonalCallback = callbackFunc; }
 
-	inline bool IsDiagonal(IntVec2 step) { return step.x != 0 && step.y != 0; }
-
-	class CustomHeap
-	{
-	public:
-		void Resverve(size_t amount) { m_elements.reserve(amount); }
-		void Push(Node* node);
-		void DecreaseKey(Node* node);
-		void Clear() { m_elements.clear(); }
-		Node* Pop();
-		bool Empty() const { return m_elements.empty(); }
-		size_t Size() const { return m_elements.size(); }
-
-	private:
-		std::vector<Node*> m_elements;
-
-		void PercolateUp(size_t index);
-		void PercolateDown(size_t index);
-	};
+	inline bool IsDiagonal(IntVec2 step) const { return step.x != 0 && step.y != 0; }
 };
\ No newline at end of file
@@ -0,0 +1,72 @@
+#include "Engine/AI/Pathfinding/Grid/GridBenchmarkMaps.hpp"
+#include "Engine/AI/Pathfinding/Grid/GridWalkabilityGrid.hpp"
+#include "Engine/Math/RandomNumberGenerator.hpp"
+#include <vector>
+
+void BuildOpenGridBenchmarkMap(GridWalkabilityGrid& walkabilityGrid, IntVec2 dimensions, float solidFraction, unsigned int seed)
+{
+	walkabilityGrid.Initialize(dimensions);
+
+	RandomNumberGenerator rng(seed);
+	for (int y = 0; y < dimensions.y; y++)
+	{
+		for (int x = 0; x < dimensions.x; x++)
+		{
+			if (rng.SRollRandomFloatZeroToOne() < solidFraction)
+			{
+				walkabilityGrid.SetSolid(IntVec2(x, y), true);
+			}
+		}
+	}
+}
+
+void BuildMazeGridBenchmarkMap(GridWalkabilityGrid& walkabilityGrid, IntVec2 dimensions, unsigned int seed)
+{
+	walkabilityGrid.Initialize(dimensions);
+	for (int y = 0; y < dimensions.y; y++)
+	{
+		for (int x = 0; x < dimensions.x; x++)
+		{
+			walkabilityGrid.SetSolid(IntVec2(x, y), true);
+		}
+	}
+
+	// Depth first maze carved through the odd tiles, walls sit on the even ones
+	int numCellsX = (dimensions.x - 1) / 2;
+	int numCellsY = (dimensions.y - 1) / 2;
+	if (numCellsX <= 0 || numCellsY <= 0) return;
+
+	RandomNumberGenerator rng(seed);
+	std::vector<bool> isVisited(numCellsX * numCellsY, false);
+	std::vector<IntVec2> stack;
+	stack.emplace_back(IntVec2(0, 0));
+	isVisited[0] = true;
+	walkabilityGrid.SetSolid(IntVec2(1, 1), false);
+
+	while (!stack.empty())
+	{
+		IntVec2 cell = stack.back();
+
+		IntVec2 unvisitedNeighbors[NUM_CARDINAL_DIRECTIONS];
+		int numUnvisited = 0;
+		for (int direction = 0; direction < NUM_CARDINAL_DIRECTIONS; direction++)
+		{
+			IntVec2 neighbor = cell + GetStepInCardinalDirection(CardinalDir(direction));
+			if (neighbor.x < 0 || neighbor.x >= numCellsX || neighbor.y < 0 || neighbor.y >= numCellsY) continue;
+			if (isVisited[neighbor.y * numCellsX + neighbor.x]) continue;
+			unvisitedNeighbors[numUnvisited++] = neighbor;
+		}
+
+		if (numUnvisited == 0)
+		{
+			stack.pop_back();
+			continue;
+		}
+
+		IntVec2 next = unvisitedNeighbors[rng.SRollRandomIntInRange(0, numUnvisited - 1)];
+		isVisited[next.y * numCellsX + next.x] = true;
+		walkabilityGrid.SetSolid(IntVec2(cell.x + next.x + 1, cell.y + next.y + 1), false); // Wall between the two cells
+		walkabilityGrid.SetSolid(IntVec2(next.x * 2 + 1, next.y * 2 + 1), false);
+		stack.emplace_back(next);
+	}
+}
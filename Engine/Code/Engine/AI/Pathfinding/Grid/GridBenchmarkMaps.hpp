@@ -0,0 +1,8 @@
+#pragma once
+#include "Engine/AI/Pathfinding/Grid/GridCommon.hpp"
+
+class GridWalkabilityGrid;
+
+// Maps the grid pathfinder benchmarks share, so every pathfinder is timed on the same layouts for a given seed
+void BuildOpenGridBenchmarkMap(GridWalkabilityGrid& walkabilityGrid, IntVec2 dimensions, float solidFraction, unsigned int seed); // Random solid tiles
+void BuildMazeGridBenchmarkMap(GridWalkabilityGrid& walkabilityGrid, IntVec2 dimensions, unsigned int seed); // Corridors one tile wide
@@ -1,9 +1,7 @@
 #pragma once
 #include "Engine/Math/MathUtils.hpp"
 #include <functional>
-
-class GridPathfindingManager;
-extern GridPathfindingManager* g_gridPathfindingManager;
+#include <cstdlib>
 
 constexpr int MAX_DIST_THRESHOLD = 32;
 
@@ -64,3 +62,44 @@ inline IntVec2 GetStepInCardinalAndIntercardinalDirection(IntercardinalDir direc
 	default: return IntVec2(0, 0);
 	}
 };
+
+// Steps of a direction mode known at compile time, in the same order as GetStepInCardinalDirection and
+// GetStepInCardinalAndIntercardinalDirection. Loops up to NUM_STEPS unroll, with no direction mode branch or step switch per neighbor
+template <DirectionMode T_Mode>
+struct GridNeighborSteps;
+
+template <>
+struct GridNeighborSteps<DirectionMode::Cardinal4>
+{
+	static constexpr int NUM_STEPS = NUM_CARDINAL_DIRECTIONS;
+	static constexpr int STEP_X[NUM_STEPS] = { 1, 0, -1, 0 };
+	static constexpr int STEP_Y[NUM_STEPS] = { 0, 1, 0, -1 };
+};
+
+template <>
+struct GridNeighborSteps<DirectionMode::Cardinal8>
+{
+	static constexpr int NUM_STEPS = NUM_INTERCARDINAL_DIRECTIONS;
+	static constexpr int STEP_X[NUM_STEPS] = { 1, 1, 0, -1, -1, -1, 0, 1 };
+	static constexpr int STEP_Y[NUM_STEPS] = { 0, 1, 1, 1, 0, -1, -1, -1 };
+};
+
+// Node index offset of every step in a row major grid rowWidth nodes wide, so a neighbor is one add away from the current node
+template <DirectionMode T_Mode>
+inline void GetGridNeighborIndexOffsets(int rowWidth, int* outIndexOffsets)
+{
+	for (int direction = 0; direction < GridNeighborSteps<T_Mode>::NUM_STEPS; direction++)
+	{
+		outIndexOffsets[direction] = GridNeighborSteps<T_Mode>::STEP_Y[direction] * rowWidth + GridNeighborSteps<T_Mode>::STEP_X[direction];
+	}
+}
+
+// Exact cost of an unobstructed 8 way walk, straight steps cost 1 and diagonal steps sqrt(2)
+inline float GetOctileDistance(IntVec2 const& from, IntVec2 const& to)
+{
+	int deltaX = abs(to.x - from.x);
+	int deltaY = abs(to.y - from.y);
+	int minDelta = (deltaX < deltaY) ? deltaX : deltaY;
+	int maxDelta = (deltaX < deltaY) ? deltaY : deltaX;
+	return static_cast<float>(maxDelta - minDelta) + 1.41421356f * static_cast<float>(minDelta);
+}
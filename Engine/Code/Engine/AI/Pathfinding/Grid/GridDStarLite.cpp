@@ -1,6 +1,11 @@
 #include "Engine/AI/Pathfinding/Grid/GridDStarLite.hpp"
+#include "Engine/AI/Pathfinding/Grid/GridAStar.hpp"
+#include "Engine/AI/Pathfinding/Grid/GridBenchmarkMaps.hpp"
 #include "Engine/Core/Time.hpp"
+#include "Engine/Core/EngineCommon.hpp"
 #include "Engine/Core/DevConsole.hpp"
+#include "Engine/Core/ErrorWarningAssert.hpp"
+#include "Engine/Math/RandomNumberGenerator.hpp"
 #include "Engine/Renderer/DebugRenderer.hpp"
 #include <algorithm>
 
@@ -11,6 +16,7 @@ GridDStarLite::GridDStarLite(IntVec2 grid)
 
 void GridDStarLite::InitializeNodeGrid(IntVec2 const& grid)
 {
+	m_openList.Clear(); // Before the nodes it points at move
 	m_gridWidth = grid.x;
 	m_gridHeight = grid.y;
 	int mapDimensions = m_gridWidth * m_gridHeight;
@@ -20,175 +26,307 @@ void GridDStarLite::InitializeNodeGrid(IntVec2 const& grid)
 		for (int x = 0; x < grid.x; x++)
 		{
 			int index = (y * m_gridWidth) + x;
-			m_nodeGrid[index] = Node{ IntVec2(x, y), std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), IntVec2(-1, -1), false, false };
+			m_nodeGrid[index] = DStarLiteNode(IntVec2(x, y));
 		}
 	}
+	m_openList.Reserve(mapDimensions / 8);
+	SetDirectionMode(m_directionMode); // Index offsets follow the grid width
 }
 
-void GridDStarLite::ComputeDStarLite(IntVec2 startPoint, IntVec2 goalPoint, std::vector<IntVec2>& outPath)
-{	
-	m_start = startPoint;
-	m_goal = goalPoint;
+void GridDStarLite::SetDirectionMode(DirectionMode mode)
+{
+	m_directionMode = mode;
+	if (m_directionMode == DirectionMode::Cardinal4)
+	{
+		GetGridNeighborIndexOffsets<DirectionMode::Cardinal4>(m_gridWidth, m_neighborIndexOffsets);
+	}
+	else
+	{
+		GetGridNeighborIndexOffsets<DirectionMode::Cardinal8>(m_gridWidth, m_neighborIndexOffsets);
+	}
+	ResetSearch();
+}
+
+void GridDStarLite::ResetSearch()
+{
+	m_openList.Clear();
+	m_searchGen++; // Every node reads as unvisited from here on, without touching them
+	m_km = 0.f;
+	m_hasSearch = false;
+	if (m_walkabilityGrid)
+	{
+		m_gridVersion = m_walkabilityGrid->GetVersion();
+	}
+}
 
+void GridDStarLite::ComputeDStarLite(IntVec2 startPoint, IntVec2 goalPoint, std::vector<IntVec2>& outPath)
+{
 	outPath.clear();
+	m_numNodesExpanded = 0;
+	if (!GetNode(startPoint) || !GetNode(goalPoint)) return;
 
-	Node* goalNode = GetNode(m_goal);
-	goalNode->m_rhs = 0;
-	Key key;
-	CalculateKey(key, goalNode);
-	m_openList.emplace(key, goalNode);
-	goalNode->m_isOpen = true;
+	// Edits made without NotifyCellsChanged can't be repaired, so the old search is thrown away
+	if (m_walkabilityGrid && m_walkabilityGrid->GetVersion() != m_gridVersion)
+	{
+		ResetSearch();
+	}
 
-	ComputeShortestPath(m_start, m_goal);
+	if (!m_hasSearch || goalPoint != m_goal)
+	{
+		ResetSearch();
+		m_hasSearch = true;
+		m_start = startPoint;
+		m_goal = goalPoint;
 
-	IntVec2 current = m_start;
-	while (current != m_goal)
+		DStarLiteNode* goalNode = GetFreshNode(goalPoint.y * m_gridWidth + goalPoint.x);
+		goalNode->m_rhs = 0.f;
+		CalculateKey(goalNode->m_key, goalNode);
+		m_openList.Push(goalNode);
+	}
+	else if (startPoint != m_start)
 	{
-		Node* currentNode = GetNode(current);
-		IntVec2 bestNeighbor = IntVec2(-1, -1);
-		float minCost = std::numeric_limits<float>::max();
+		RecalculateNode(startPoint);
+	}
+
+	ComputeShortestPath();
 
-		ForEachNeighbor(currentNode, [&](Node* neighbor, IntVec2)
+	// The search can stop with the start itself still open, but its rhs is settled and so is g around it, so the path is walked downhill from there
+	DStarLiteNode* currentNode = GetFreshNode(m_start.y * m_gridWidth + m_start.x);
+	if (currentNode->m_rhs == DSTAR_LITE_INFINITY) return; // No path was found
+
+	int maxSteps = m_gridWidth * m_gridHeight;
+	while (currentNode->m_position != m_goal && maxSteps-- > 0)
+	{
+		DStarLiteNode* bestNeighbor = nullptr;
+		float minCost = DSTAR_LITE_INFINITY;
+		ForEachNeighbor(currentNode, false, [&](DStarLiteNode* neighbor, float stepCost)
 		{
-			float cost = GetCost(current, neighbor->m_position) + neighbor->m_totalgCost;
+			float cost = stepCost + neighbor->m_totalgCost;
 			if (cost < minCost)
 			{
 				minCost = cost;
-				bestNeighbor = neighbor->m_position;
+				bestNeighbor = neighbor;
 			}
 		});
 
-		if (bestNeighbor == IntVec2(-1, -1)) break; // No path was found
-		outPath.emplace_back(bestNeighbor);
-		current = bestNeighbor;
+		if (!bestNeighbor) break;
+		outPath.emplace_back(bestNeighbor->m_position);
+		currentNode = bestNeighbor;
+	}
+
+	if (currentNode->m_position != m_goal)
+	{
+		outPath.clear();
 	}
 }
 
-void GridDStarLite::ComputeShortestPath(IntVec2 start, IntVec2 goal)
+void GridDStarLite::ComputePath(IntVec2 start, IntVec2 goal, std::vector<IntVec2>& outPath)
 {
-	int maxSteps = MAX_CYCLES;
-	while (!m_openList.empty())
+	ComputeDStarLite(start, goal, outPath);
+	std::reverse(outPath.begin(), outPath.end());
+}
+
+void GridDStarLite::NotifyCellsChanged(IntVec2 const* cells, int numCells)
+{
+	if (m_walkabilityGrid)
 	{
-		maxSteps--;
-		if (maxSteps <= 0) break;
-		auto [topKey, current] = m_openList.top();
-		m_openList.pop();
+		m_gridVersion = m_walkabilityGrid->GetVersion();
+	}
+	if (!m_hasSearch) return;
+
+	// Every step into or out of a changed cell starts or ends next to it, and so does every diagonal squeezing past its corner.
+	// Recomputing rhs for the cell and its eight neighbors covers every node whose outgoing costs changed
+	for (int cellIndex = 0; cellIndex < numCells; cellIndex++)
+	{
+		IntVec2 const& cell = cells[cellIndex];
+		for (int offsetY = -1; offsetY <= 1; offsetY++)
+		{
+			for (int offsetX = -1; offsetX <= 1; offsetX++)
+			{
+				IntVec2 coords(cell.x + offsetX, cell.y + offsetY);
+				if (coords.x < 0 || coords.x >= m_gridWidth || coords.y < 0 || coords.y >= m_gridHeight) continue;
+				UpdateVertex(GetFreshNode(coords.y * m_gridWidth + coords.x));
+			}
+		}
+	}
+}
+
+void GridDStarLite::ComputeShortestPath()
+{
+	DStarLiteNode* startNode = GetFreshNode(m_start.y * m_gridWidth + m_start.x);
+	DStarKey startKey;
+	CalculateKey(startKey, startNode);
 
-		if (current->m_isClosed || current->m_totalgCost == current->m_rhs) continue;
+	while (!m_openList.Empty() && (m_openList.TopKey() < startKey || startNode->m_rhs > startNode->m_totalgCost))
+	{
+		DStarLiteNode* current = m_openList.Top();
+		m_numNodesExpanded++;
 
-		Key newKey;
-		CalculateKey(newKey,current);
+		DStarKey newKey;
+		CalculateKey(newKey, current);
 
-		if (topKey < newKey)
+		if (current->m_key < newKey)
 		{
-			m_openList.emplace(newKey, current);
-			continue;
+			// Keyed before the start moved, put it back where it belongs
+			current->m_key = newKey;
+			m_openList.Update(current);
 		}
-
-		if (current->m_totalgCost > current->m_rhs)
+		else if (current->m_totalgCost > current->m_rhs)
 		{
+			// Got cheaper, which can only lower the rhs of the nodes stepping into it
 			current->m_totalgCost = current->m_rhs;
-			UpdatePredecessors(current);
+			m_openList.Remove(current);
+			ForEachNeighbor(current, true, [&](DStarLiteNode* predecessor, float stepCost)
+			{
+				if (predecessor->m_position != m_goal)
+				{
+					float costThroughCurrent = stepCost + current->m_totalgCost;
+					predecessor->m_rhs = std::min(predecessor->m_rhs, costThroughCurrent);
+				}
+				UpdateVertex(predecessor, false);
+			});
 		}
 		else
 		{
-			current->m_totalgCost = std::numeric_limits<float>::max();
+			// Got dearer, only the nodes whose rhs came through it need to look for another way
+			float oldgCost = current->m_totalgCost;
+			current->m_totalgCost = DSTAR_LITE_INFINITY;
+			ForEachNeighbor(current, true, [&](DStarLiteNode* predecessor, float stepCost)
+			{
+				float costThroughCurrent = stepCost + oldgCost;
+				UpdateVertex(predecessor, predecessor->m_rhs == costThroughCurrent);
+			});
 			UpdateVertex(current);
-			UpdatePredecessors(current);
 		}
-	}
-}
 
-void GridDStarLite::UpdatePredecessors(Node* node)
-{
-	ForEachNeighbor(node, [this](Node* neighbor, IntVec2 stepDir)
-	{
-		UpdateVertex(neighbor);
-	});
+		CalculateKey(startKey, startNode);
+	}
 }
 
-void GridDStarLite::UpdateVertex(Node* node)
+void GridDStarLite::UpdateVertex(DStarLiteNode* node, bool isRHSRecomputed /*= true*/)
 {
-	if (node->m_position != m_goal)
+	if (isRHSRecomputed && node->m_position != m_goal)
 	{
-		float minRHS = std::numeric_limits<float>::max();
-		ForEachNeighbor(node, [this, &minRHS, node](Node* neighbor, IntVec2 neighborCoords)
+		float minRHS = DSTAR_LITE_INFINITY;
+		ForEachNeighbor(node, false, [&minRHS](DStarLiteNode* neighbor, float stepCost)
 		{
-			int cost = GetCost(node->m_position, neighborCoords);
-			minRHS = std::min(minRHS, cost + neighbor->m_totalgCost);
+			minRHS = std::min(minRHS, stepCost + neighbor->m_totalgCost);
 		});
 		node->m_rhs = minRHS;
 	}
 
-	if (node->m_isOpen)
+	// Only inconsistent nodes belong in the open list
+	bool isOpen = node->m_heapIndex != -1;
+	if (node->m_totalgCost != node->m_rhs)
 	{
-		node->m_isOpen = false;
-		node->m_isClosed = true;
+		CalculateKey(node->m_key, node);
+		if (isOpen)
+		{
+			m_openList.Update(node);
+		}
+		else
+		{
+			m_openList.Push(node);
+		}
 	}
-
-	if (node->m_totalgCost != node->m_rhs)
+	else if (isOpen)
 	{
-		Key key;
-		CalculateKey(key, node);
-		m_openList.emplace(key, node);
-		node->m_isOpen = true;
+		m_openList.Remove(node);
 	}
 }
 
-void GridDStarLite::CalculateKey(Key& key, Node* node)
+void GridDStarLite::CalculateKey(DStarKey& key, DStarLiteNode const* node) const
 {
 	float min_g_rhs = std::min(node->m_totalgCost, node->m_rhs);
-	int hCost = GetLengthSquared(m_start, node->m_position);
+	float hCost = GetHeuristic(m_start, node->m_position);
 	key = { min_g_rhs + hCost + m_km, min_g_rhs };
 }
 
+float GridDStarLite::GetHeuristic(IntVec2 const& from, IntVec2 const& to) const
+{
+	// Has to stay at or under the real step costs, or the m_km shift stops being safe
+	int deltaX = abs(to.x - from.x);
+	int deltaY = abs(to.y - from.y);
+	if (m_directionMode == DirectionMode::Cardinal4)
+	{
+		return static_cast<float>(DSTAR_LITE_STRAIGHT_COST * (deltaX + deltaY));
+	}
+	int minDelta = (deltaX < deltaY) ? deltaX : deltaY;
+	int maxDelta = (deltaX < deltaY) ? deltaY : deltaX;
+	return static_cast<float>(DSTAR_LITE_STRAIGHT_COST * (maxDelta - minDelta) + DSTAR_LITE_DIAGONAL_COST * minDelta);
+}
+
 void GridDStarLite::RecalculateNode(IntVec2 newStart)
 {
-	int heuristicChange = GetLengthSquared(m_start, newStart);
-	m_km += heuristicChange;
+	// Keys already in the open list were made from the old start, shifting every new key up by the distance moved keeps them comparable
+	if (m_hasSearch)
+	{
+		m_km += GetHeuristic(m_start, newStart);
+	}
 	m_start = newStart;
+}
 
-	Node* startNode = GetNode(newStart);
-	UpdateVertex(startNode);
+template <typename T_Callback>
+void GridDStarLite::ForEachNeighbor(DStarLiteNode* node, bool isPredecessor, T_Callback const& callback)
+{
+	if (m_directionMode == DirectionMode::Cardinal4)
+	{
+		if (isPredecessor) ForEachNeighborInMode<DirectionMode::Cardinal4, true>(node, callback);
+		else ForEachNeighborInMode<DirectionMode::Cardinal4, false>(node, callback);
+	}
+	else
+	{
+		if (isPredecessor) ForEachNeighborInMode<DirectionMode::Cardinal8, true>(node, callback);
+		else ForEachNeighborInMode<DirectionMode::Cardinal8, false>(node, callback);
+	}
 }
 
-void GridDStarLite::ForEachNeighbor(Node* node, std::function<void(Node*, IntVec2)> callback)
+template <DirectionMode T_Mode, bool T_IsPredecessor, typename T_Callback>
+void GridDStarLite::ForEachNeighborInMode(DStarLiteNode* node, T_Callback const& callback)
 {
-	int numDirections = (m_directionMode == DirectionMode::Cardinal4) ? NUM_CARDINAL_DIRECTIONS : NUM_INTERCARDINAL_DIRECTIONS;
-	for (int direction = 0; direction < numDirections; direction++)
+	typedef GridNeighborSteps<T_Mode> Steps;
+	int nodeIndex = (node->m_position.y * m_gridWidth) + node->m_position.x;
+	auto visitStep = [&](int direction, int stepX, int stepY)
 	{
-		IntVec2 stepDirection = (m_directionMode == DirectionMode::Cardinal4) ? GetStepInCardinalDirection(CardinalDir(direction)) : GetStepInCardinalAndIntercardinalDirection(IntercardinalDir(direction));
-		bool isDiagonal = IsDiagonal(stepDirection);
-		IntVec2 neighborCoords = node->m_position + stepDirection;
+		float stepCost = (stepX != 0 && stepY != 0) ? static_cast<float>(DSTAR_LITE_DIAGONAL_COST) : static_cast<float>(DSTAR_LITE_STRAIGHT_COST);
+		callback(GetFreshNode(nodeIndex + m_neighborIndexOffsets[direction]), stepCost);
+	};
 
-		if (!m_isSolidCallback(neighborCoords))
-		{
-			if (isDiagonal || (!m_canMoveDiagonalCallback || m_canMoveDiagonalCallback(node->m_position, neighborCoords)))
-			{
-				if (neighborCoords.x < 0 || neighborCoords.x >= m_gridWidth || neighborCoords.y < 0 || neighborCoords.y >= m_gridHeight) continue;
+	if (m_walkabilityGrid)
+	{
+		m_walkabilityGrid->ForEachOpenStep<T_Mode, T_IsPredecessor>(node->m_position.x, node->m_position.y, visitStep);
+		return;
+	}
 
-				int neighborIndex = (neighborCoords.y * m_gridWidth) + neighborCoords.x;
-				Node* neighbor = &m_nodeGrid[neighborIndex];
+	for (int direction = 0; direction < Steps::NUM_STEPS; direction++)
+	{
+		IntVec2 stepDirection(Steps::STEP_X[direction], Steps::STEP_Y[direction]);
+		IntVec2 neighborCoords = node->m_position + stepDirection;
+		if (neighborCoords.x < 0 || neighborCoords.x >= m_gridWidth || neighborCoords.y < 0 || neighborCoords.y >= m_gridHeight) continue;
 
-				callback(neighbor, stepDirection);
-			}
-		}
+		// A predecessor steps from the neighbor into this node
+		IntVec2 fromCoords = T_IsPredecessor ? neighborCoords : node->m_position;
+		IntVec2 toCoords = T_IsPredecessor ? node->m_position : neighborCoords;
+		if (m_isSolidCallback(toCoords)) continue;
+		if (IsDiagonal(stepDirection) && m_canMoveDiagonalCallback && !m_canMoveDiagonalCallback(fromCoords, toCoords)) continue;
+		visitStep(direction, stepDirection.x, stepDirection.y);
 	}
 }
 
-int GridDStarLite::GetCost(IntVec2 currentPosition, IntVec2 neighborPosition)
+void GridDStarLite::SetWalkabilityGrid(GridWalkabilityGrid const* walkabilityGrid)
 {
-	IntVec2 diff = currentPosition - neighborPosition;
-	bool isDiagonal = (diff.x != 0 && diff.y != 0);
-	return isDiagonal ? 141 : 100;
+	// The walkability border stands in for the bounds check, so it must not reach past the node grid
+	ASSERT_OR_DIE(!walkabilityGrid || (walkabilityGrid->GetDimensions().x <= m_gridWidth && walkabilityGrid->GetDimensions().y <= m_gridHeight), "Walkability grid is larger than the D* Lite node grid");
+	m_walkabilityGrid = walkabilityGrid;
+	ResetSearch();
 }
 
-Node* GridDStarLite::GetNode(IntVec2 point)
+DStarLiteNode* GridDStarLite::GetNode(IntVec2 point)
 {
 	if (point.x < 0 || point.x >= m_gridWidth || point.y < 0 || point.y >= m_gridHeight) return nullptr;
 
 	int index = point.y * m_gridWidth + point.x;
-	return &m_nodeGrid[index];
+	return GetFreshNode(index);
 }
 
 void GridDStarLite::TestDStarLitePathFinding(IntVec2 start, IntVec2 goal, std::vector<IntVec2>& path)
@@ -198,8 +336,204 @@ void GridDStarLite::TestDStarLitePathFinding(IntVec2 start, IntVec2 goal, std::v
 	double timeAfter = GetCurrentTimeSeconds();
 
 	float msElapsed = 1000.f * float(timeAfter - timeBefore);
-	g_theConsole->AddLine(Rgba8::RED, Stringf("Generated a path of %i steps from (%i,%i) to (%i,%i) in %.02f ms", path.size(), start.x, start.y, goal.x, goal.y, msElapsed));
+	g_theConsole->AddLine(Rgba8::RED, Stringf("Generated a path of %i steps from (%i,%i) to (%i,%i) in %.02f ms", static_cast<int>(path.size()), start.x, start.y, goal.x, goal.y, msElapsed));
 
-	size_t pathSizeInBytes = m_currentStoredPathfindingPath.size() * sizeof(IntVec2); // Approximate size of one path
-	g_theConsole->AddLine(Rgba8::LIGHT_ORANGE, Stringf("The approximate size of one path is %i", pathSizeInBytes));
+	size_t pathSizeInBytes = path.size() * sizeof(IntVec2); // Approximate size of one path
+	g_theConsole->AddLine(Rgba8::LIGHT_ORANGE, Stringf("The approximate size of one path is %i", static_cast<int>(pathSizeInBytes)));
+}
+
+void GridDStarLite::SubscribeConsoleCommands()
+{
+	if (g_theEventSystem)
+	{
+		g_theEventSystem->SubscribeEventCallbackFunction("GridDStarLiteBenchmark", Command_GridDStarLiteBenchmark);
+	}
+}
+
+void GridDStarLite::UnsubscribeConsoleCommands()
+{
+	if (g_theEventSystem)
+	{
+		g_theEventSystem->UnsubscribeEventCallbackFunction("GridDStarLiteBenchmark", Command_GridDStarLiteBenchmark);
+	}
+}
+
+bool GridDStarLite::Command_GridDStarLiteBenchmark(EventArgs& args)
+{
+	int mapSize = std::stoi(args.GetValue<std::string>("size", "256"));
+	int numDoors = std::stoi(args.GetValue<std::string>("doors", "50"));
+	int stepsPerDoor = std::stoi(args.GetValue<std::string>("steps", "4"));
+	unsigned int seed = static_cast<unsigned int>(std::stoi(args.GetValue<std::string>("seed", "1")));
+
+	GridWalkabilityGrid walkabilityGrid;
+	BuildOpenGridBenchmarkMap(walkabilityGrid, IntVec2(mapSize, mapSize), 0.2f, seed);
+
+	RandomNumberGenerator rng(seed);
+	auto rollWalkableTile = [&]()
+	{
+		for (int attempt = 0; attempt < 1000; attempt++)
+		{
+			IntVec2 tile(rng.SRollRandomIntInRange(0, mapSize - 1), rng.SRollRandomIntInRange(0, mapSize - 1));
+			if (!walkabilityGrid.IsSolid(tile)) return tile;
+		}
+		return IntVec2(0, 0);
+	};
+
+	GridDStarLite dStarLite(IntVec2(mapSize, mapSize));
+	dStarLite.SetDirectionMode(DirectionMode::Cardinal8);
+	dStarLite.SetWalkabilityGrid(&walkabilityGrid);
+
+	// Octile costs like D* Lite's, so both are timed finding equally short routes
+	GridAStar aStar(IntVec2(mapSize, mapSize));
+	aStar.SetDirectionMode(DirectionMode::Cardinal8);
+	aStar.SetCostMetric(GridAStarCostMetric::Octile);
+	aStar.SetWalkabilityGrid(&walkabilityGrid);
+	aStar.m_maxSearchDistance = mapSize * 2;
+
+	// Start and goal in opposite corners so the route is long enough to keep closing doors on
+	IntVec2 agentTile = rollWalkableTile();
+	IntVec2 goal = rollWalkableTile();
+	for (int attempt = 0; attempt < 100 && GetOctileDistance(agentTile, goal) < static_cast<float>(mapSize); attempt++)
+	{
+		agentTile = rollWalkableTile();
+		goal = rollWalkableTile();
+	}
+
+	std::vector<IntVec2> path;
+	double timeBefore = GetCurrentTimeSeconds();
+	dStarLite.ComputeDStarLite(agentTile, goal, path);
+	double initialMs = 1000.0 * (GetCurrentTimeSeconds() - timeBefore);
+	int initialNodesExpanded = dStarLite.GetNumNodesExpanded();
+
+	std::vector<IntVec2> aStarPath;
+	double replanMs = 0.0;
+	double aStarMs = 0.0;
+	long long replanNodesExpanded = 0;
+	long long aStarNodesExpanded = 0;
+	int numReplans = 0;
+	for (int door = 0; door < numDoors && !path.empty(); door++)
+	{
+		// Walk a few steps, then a door closes a little way ahead on the route
+		int numSteps = std::min(stepsPerDoor, static_cast<int>(path.size()) - 1);
+		if (numSteps <= 0) break;
+		agentTile = path[numSteps - 1];
+		int doorIndex = std::min(numSteps + 3, static_cast<int>(path.size()) - 2);
+		if (doorIndex < numSteps) break;
+		IntVec2 doorTile = path[doorIndex];
+		walkabilityGrid.SetSolid(doorTile, true);
+		dStarLite.NotifyCellsChanged(&doorTile, 1);
+
+		timeBefore = GetCurrentTimeSeconds();
+		dStarLite.ComputeDStarLite(agentTile, goal, path);
+		double timeMiddle = GetCurrentTimeSeconds();
+		aStar.ComputeAStar(agentTile, goal, aStarPath);
+		double timeAfter = GetCurrentTimeSeconds();
+
+		replanMs += 1000.0 * (timeMiddle - timeBefore);
+		aStarMs += 1000.0 * (timeAfter - timeMiddle);
+		replanNodesExpanded += dStarLite.GetNumNodesExpanded();
+		aStarNodesExpanded += aStar.GetNumNodesExpanded();
+		numReplans++;
+	}
+
+	g_theConsole->AddLine(Rgba8::LIGHT_ORANGE, Stringf("D* Lite %ix%i, %i doors closed on the route", mapSize, mapSize, numReplans));
+	g_theConsole->AddLine(Rgba8::LIGHT_ORANGE, Stringf("  First plan:    %.02f ms, %i nodes expanded", initialMs, initialNodesExpanded));
+	g_theConsole->AddLine(Rgba8::LIGHT_ORANGE, Stringf("  D* Lite replan: %.02f ms, %lld nodes expanded", replanMs, replanNodesExpanded));
+	g_theConsole->AddLine(Rgba8::LIGHT_ORANGE, Stringf("  Fresh A*:      %.02f ms, %lld nodes expanded", aStarMs, aStarNodesExpanded));
+	return true;
+}
+
+// --------------------------------------------------------------------------------------------------------
+
+void GridDStarLite::DStarLiteHeap::Push(DStarLiteNode* node)
+{
+	m_elements.emplace_back(node);
+	node->m_heapIndex = static_cast<int>(m_elements.size()) - 1;
+	PercolateUp(node->m_heapIndex);
+}
+
+void GridDStarLite::DStarLiteHeap::Update(DStarLiteNode* node)
+{
+	if (node->m_heapIndex < 0 || node->m_heapIndex >= static_cast<int>(m_elements.size())) return;
+
+	size_t index = static_cast<size_t>(node->m_heapIndex);
+	PercolateUp(index);
+	PercolateDown(static_cast<size_t>(node->m_heapIndex));
+}
+
+void GridDStarLite::DStarLiteHeap::Remove(DStarLiteNode* node)
+{
+	if (node->m_heapIndex < 0 || node->m_heapIndex >= static_cast<int>(m_elements.size())) return;
+
+	size_t index = static_cast<size_t>(node->m_heapIndex);
+	DStarLiteNode* lastNode = m_elements.back();
+	m_elements.pop_back();
+	node->m_heapIndex = -1;
+	if (lastNode == node) return;
+
+	// The last node fills the hole and moves whichever way its key says
+	m_elements[index] = lastNode;
+	lastNode->m_heapIndex = static_cast<int>(index);
+	PercolateUp(index);
+	PercolateDown(static_cast<size_t>(lastNode->m_heapIndex));
+}
+
+void GridDStarLite::DStarLiteHeap::Clear()
+{
+	for (DStarLiteNode* node : m_elements)
+	{
+		node->m_heapIndex = -1;
+	}
+	m_elements.clear();
+}
+
+void GridDStarLite::DStarLiteHeap::PercolateUp(size_t index)
+{
+	while (index > 0)
+	{
+		size_t parent = (index - 1) / 2;
+		if (m_elements[index]->m_key < m_elements[parent]->m_key)
+		{
+			std::swap(m_elements[index], m_elements[parent]);
+			std::swap(m_elements[index]->m_heapIndex, m_elements[parent]->m_heapIndex);
+			index = parent;
+		}
+		else
+		{
+			break;
+		}
+	}
+}
+
+void GridDStarLite::DStarLiteHeap::PercolateDown(size_t index)
+{
+	size_t leftChild, rightChild, smallest;
+
+	while (true)
+	{
+		leftChild = index * 2 + 1;
+		rightChild = index * 2 + 2;
+		smallest = index;
+
+		if (leftChild < m_elements.size() && m_elements[leftChild]->m_key < m_elements[smallest]->m_key)
+		{
+			smallest = leftChild;
+		}
+
+		if (rightChild < m_elements.size() && m_elements[rightChild]->m_key < m_elements[smallest]->m_key)
+		{
+			smallest = rightChild;
+		}
+
+		if (smallest != index)
+		{
+			std::swap(m_elements[index], m_elements[smallest]);
+			std::swap(m_elements[index]->m_heapIndex, m_elements[smallest]->m_heapIndex);
+			index = smallest;
+		}
+		else
+		{
+			break;
+		}
+	}
 }
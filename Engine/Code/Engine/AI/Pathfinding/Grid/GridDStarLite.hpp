@@ -1,67 +1,123 @@
 #pragma once
-#include "Engine/AI/Pathfinding/Grid/GridCommon.hpp"
+#include "Engine/AI/Pathfinding/Grid/GridPathfindingManager.hpp"
+#include "Engine/AI/Pathfinding/Grid/GridWalkabilityGrid.hpp"
+#include "Engine/Core/EventSystem.hpp"
 #include <vector>
-#include <queue>
+#include <limits>
+#include <utility>
 
-constexpr int MAX_CYCLES = 20;
+constexpr float DSTAR_LITE_INFINITY = std::numeric_limits<float>::infinity();
+constexpr int DSTAR_LITE_STRAIGHT_COST = 100;
+constexpr int DSTAR_LITE_DIAGONAL_COST = 141;
 
-struct Node
-{
-	IntVec2 m_position;
-	IntVec2 m_parent;
-	float m_totalgCost;
-	float m_rhs; // right-hand side. This represents the estimated cost of the shortest path from a node 's' to the goal
-	bool m_isOpen;
-	bool m_isClosed;
-
-	Node() : m_position(-1, -1), m_parent(-1, -1), m_totalgCost(std::numeric_limits<float>::max()), m_rhs(std::numeric_limits<float>::max()), m_isOpen(false), m_isClosed(false) {}
-	Node(IntVec2 position, float gCost, float rhs, IntVec2 parent, bool isOpen, bool isClosed)
-		:m_position(position), m_totalgCost(gCost), m_rhs(rhs), m_parent(parent), m_isOpen(isOpen), m_isClosed(isClosed) {}
-};
+using DStarKey = std::pair<float, float>;
 
-using Key = std::pair<float, float>;
-struct CompareNode
+struct DStarLiteNode
 {
-	bool operator()(const std::pair<Key, Node*>& entryA, const std::pair<Key, Node*>& entryB)
-	{
-		const Key& keyA = entryA.first;
-		const Key& keyB = entryB.first;
-		if (keyA.first != keyB.first) { return keyA.first > keyB.first; }
-		return keyA.second > keyB.second;
-	}
+	IntVec2 m_position;
+	float m_totalgCost = DSTAR_LITE_INFINITY;
+	float m_rhs = DSTAR_LITE_INFINITY; // right-hand side. One step lookahead of g, the cheapest neighbor's g plus the step to it
+	DStarKey m_key = DStarKey(DSTAR_LITE_INFINITY, DSTAR_LITE_INFINITY); // Valid while in the open list
+	int m_heapIndex = -1; // Slot in GridDStarLite::DStarLiteHeap, -1 when not in it
+	int m_searchGen = -1; // Nodes from an earlier goal read as fresh
+
+	DStarLiteNode() : m_position(-1, -1) {}
+	DStarLiteNode(IntVec2 position) : m_position(position) {}
 };
 
-class GridDStarLite
+// D* Lite (Koenig and Likhachev), searching from the goal back to the start. As long as the goal stays the same, later calls
+// keep the previous search: moving the start only shifts the keys by m_km, and changed cells only reopen the nodes next to them,
+// so a replan after a door closes only touches the part of the map whose distance to the goal actually changed
+class GridDStarLite : public IGridPathfinder
 {
 public:
 	GridDStarLite() = default;
 	GridDStarLite(IntVec2 grid);
-	virtual ~GridDStarLite() = default;
+	~GridDStarLite() override = default;
 
 public:
 	void InitializeNodeGrid(IntVec2 const& grid);
-	void SetDirectionMode(DirectionMode mode) { m_directionMode = mode; }
+	void SetDirectionMode(DirectionMode mode);
+	void SetWalkabilityGrid(GridWalkabilityGrid const* walkabilityGrid); // When set, used instead of the callbacks
 
-	// A-Star
+	// Open list indexed by DStarLiteNode::m_heapIndex, so a node's key can be changed or the node taken out wherever it sits
+	class DStarLiteHeap
+	{
+	public:
+		void Reserve(size_t amount) { m_elements.reserve(amount); }
+		void Push(DStarLiteNode* node);
+		void Update(DStarLiteNode* node); // After m_key changed either way
+		void Remove(DStarLiteNode* node);
+		void Clear();
+		DStarLiteNode* Top() const { return m_elements.front(); }
+		DStarKey const& TopKey() const { return m_elements.front()->m_key; }
+		bool Empty() const { return m_elements.empty(); }
+		size_t Size() const { return m_elements.size(); }
+
+	private:
+		std::vector<DStarLiteNode*> m_elements;
+
+		void PercolateUp(size_t index);
+		void PercolateDown(size_t index);
+	};
+
+	// D* Lite, the path comes back in walking order and leaves out the start. Empty when the goal can't be reached
 	void ComputeDStarLite(IntVec2 startPoint, IntVec2 goalPoint, std::vector<IntVec2>& outPath);
-	void ComputeShortestPath(IntVec2 start, IntVec2 goal);
-	void UpdatePredecessors(Node* node);
-	void UpdateVertex(Node* node);
-	void CalculateKey(Key& key, Node* node);
-	void RecalculateNode(IntVec2 newStart);
+	void ComputePath(IntVec2 start, IntVec2 goal, std::vector<IntVec2>& outPath) override; // Goal first, ComputeDStarLite gives walking order
+	void OnTileChanged(IntVec2 tile) override { NotifyCellsChanged(&tile, 1); }
+	int GetNumNodesExpanded() const override { return m_numNodesExpanded; }
+
+	// Call after the walkability grid (or what the callbacks return) changed for these cells. Only reopens the cells and
+	// their neighbors, the next ComputeDStarLite repairs the search from there
+	void NotifyCellsChanged(IntVec2 const* cells, int numCells);
+	void NotifyCellsChanged(std::vector<IntVec2> const& cells) { NotifyCellsChanged(cells.data(), static_cast<int>(cells.size())); }
+	void ResetSearch(); // Forget the previous search, the next call starts over
+
+	void ComputeShortestPath();
+	void UpdateVertex(DStarLiteNode* node, bool isRHSRecomputed = true); // Then puts the node in, moves it in or takes it out of the open list
+	void CalculateKey(DStarKey& key, DStarLiteNode const* node) const;
+	float GetHeuristic(IntVec2 const& from, IntVec2 const& to) const; // Octile, or Manhattan with 4 way movement, in step cost units
+	void RecalculateNode(IntVec2 newStart); // Moves the start without searching
+
+	// Calls callback(neighbor, stepCost). isPredecessor walks the steps into the node instead of out of it, they differ when the node or a neighbor is solid
+	template <typename T_Callback>
+	void ForEachNeighbor(DStarLiteNode* node, bool isPredecessor, T_Callback const& callback);
+	template <DirectionMode T_Mode, bool T_IsPredecessor, typename T_Callback>
+	void ForEachNeighborInMode(DStarLiteNode* node, T_Callback const& callback); // ForEachNeighbor picks the mode once per node
+	DStarLiteNode* GetNode(IntVec2 point);
+
+	// Debug D* Lite, times one search and reports the path it found
+	void TestDStarLitePathFinding(IntVec2 start, IntVec2 goal, std::vector<IntVec2>& path);
 
-	void ForEachNeighbor(Node* node, std::function<void(Node*, IntVec2)> callback);
-	int GetCost(IntVec2 currentPosition, IntVec2 neighborPosition);
-	Node* GetNode(IntVec2 point);
+	static void SubscribeConsoleCommands(); // Once at startup, after the event system exists
+	static void UnsubscribeConsoleCommands();
+	// Walks an agent across a map while doors close on its path, replanning with D* Lite and with a fresh GridAStar each time
+	static bool Command_GridDStarLiteBenchmark(EventArgs& args);
 
-	// Debug A-Star
-	void TestDStarLitePathFinding(IntVec2 start, IntVec2 goal, std::vector<IntVec2>& path);
+private:
+	inline DStarLiteNode* GetFreshNode(int index)
+	{
+		DStarLiteNode* node = &m_nodeGrid[index];
+		if (node->m_searchGen != m_searchGen)
+		{
+			node->m_totalgCost = DSTAR_LITE_INFINITY;
+			node->m_rhs = DSTAR_LITE_INFINITY;
+			node->m_heapIndex = -1;
+			node->m_searchGen = m_searchGen;
+		}
+		return node;
+	}
 
 private:
-	int m_km = 0; // global value use to adjust the heuristic key whenever the start moves or the environment changes
-	IntVec2 m_start; // Store because the start and goal can constantly be changed
-	IntVec2 m_goal;
-	std::priority_queue<std::pair<Key, Node*>, std::vector<std::pair<Key, Node*>>, CompareNode> m_openList;
+	float m_km = 0.f; // global value use to adjust the heuristic key whenever the start moves or the environment changes
+	IntVec2 m_start = IntVec2(-1, -1); // Store because the start and goal can constantly be changed
+	IntVec2 m_goal = IntVec2(-1, -1);
+	int m_searchGen = 0;
+	bool m_hasSearch = false;
+	unsigned int m_gridVersion = 0; // Of the walkability grid when last searched or notified
+	int m_numNodesExpanded = 0;
+	DStarLiteHeap m_openList;
+	int m_neighborIndexOffsets[NUM_INTERCARDINAL_DIRECTIONS] = {}; // Per GridNeighborSteps direction, for the current mode and grid width
 
 public:
 	int m_gridWidth = 0;
@@ -69,8 +125,9 @@ public:
 
 	DirectionMode m_directionMode = DirectionMode::Cardinal4;
 
-	std::vector<IntVec2> m_currentStoredPathfindingPath;
-	std::vector<Node> m_nodeGrid;
+	std::vector<DStarLiteNode> m_nodeGrid;
+
+	GridWalkabilityGrid const* m_walkabilityGrid = nullptr; // Not owned
 
 public:
 	using IsSolidCallbackFunc = std::function<bool(IntVec2)>;
@@ -79,8 +136,8 @@ public:
 	using CanMoveDiagonalCallbackFunc = std::function<bool(IntVec2 fromPos, IntVec2 toPos)>;
 	CanMoveDiagonalCallbackFunc m_canMoveDiagonalCallback = nullptr;
 
-	void SetIsSolidCallback(IsSolidCallbackFunc callbackFunc) { m_isSolidCallback = callbackFunc; }
-	void SetCanMoveDiagonalCallback(CanMoveDiagonalCallbackFunc callbackFunc) { m_canMoveDiagonalCallback = callbackFunc; }
+	void SetIsSolidCallback(IsSolidCallbackFunc callbackFunc) { m_isSolidCallback = callbackFunc; ResetSearch(); }
+	void SetCanMoveDiagonalCallback(CanMoveDiagonalCallbackFunc callbackFunc) { m_canMoveDiagonalCallback = callbackFunc; ResetSearch(); }
 
-	inline bool IsDiagonal(IntVec2 step) { return step.x != 0 && step.y != 0; }
-};
\ No newline at end of file
+	inline bool IsDiagonal(IntVec2 step) const { return step.x != 0 && step.y != 0; }
+};
@@ -0,0 +1,456 @@
+#include "Engine/AI/Pathfinding/Grid/GridFlowField.hpp"
+#include "Engine/AI/Pathfinding/Grid/GridAStar.hpp"
+#include "Engine/AI/Pathfinding/Grid/GridBenchmarkMaps.hpp"
+#include "Engine/Core/JobSystem.hpp"
+#include "Engine/Core/Time.hpp"
+#include "Engine/Core/EngineCommon.hpp"
+#include "Engine/Core/DevConsole.hpp"
+#include "Engine/Math/RandomNumberGenerator.hpp"
+#include <algorithm>
+#include <cfloat>
+
+using OpenEntry = std::pair<float, int>;
+
+// Step and cost per IntercardinalDir, indexed by direction so the inner loops skip the switch
+static int const s_stepsX[NUM_INTERCARDINAL_DIRECTIONS] = { 1, 1, 0, -1, -1, -1, 0, 1 };
+static int const s_stepsY[NUM_INTERCARDINAL_DIRECTIONS] = { 0, 1, 1, 1, 0, -1, -1, -1 };
+static float const s_stepCosts[NUM_INTERCARDINAL_DIRECTIONS] = { 1.f, 1.41421356f, 1.f, 1.41421356f, 1.f, 1.41421356f, 1.f, 1.41421356f };
+
+bool GridFlowField::IsReachable(IntVec2 tile) const
+{
+	return IsInBounds(tile) && m_integration[GetIndex(tile)] != FLT_MAX;
+}
+
+float GridFlowField::GetIntegrationCost(IntVec2 tile) const
+{
+	return IsInBounds(tile) ? m_integration[GetIndex(tile)] : FLT_MAX;
+}
+
+IntVec2 GridFlowField::GetDirection(IntVec2 tile) const
+{
+	if (!IsInBounds(tile)) return IntVec2(0, 0);
+
+	uint8_t direction = m_directions[GetIndex(tile)];
+	if (direction == FLOW_FIELD_NO_DIRECTION) return IntVec2(0, 0);
+	return IntVec2(s_stepsX[direction], s_stepsY[direction]);
+}
+
+GridFlowFieldPathfinder::GridFlowFieldPathfinder(GridWalkabilityGrid const* walkabilityGrid, JobSystem* jobSystem)
+	: m_jobSystem(jobSystem)
+{
+	SetWalkabilityGrid(walkabilityGrid);
+}
+
+void GridFlowFieldPathfinder::SetWalkabilityGrid(GridWalkabilityGrid const* walkabilityGrid)
+{
+	m_walkabilityGrid = walkabilityGrid;
+	m_fields.clear();
+	m_repairGen.clear();
+	m_currentRepairGen = 0;
+	if (m_walkabilityGrid)
+	{
+		IntVec2 dimensions = m_walkabilityGrid->GetDimensions();
+		m_repairGen.assign(dimensions.x * dimensions.y, 0);
+	}
+}
+
+void GridFlowFieldPathfinder::SetMaxCachedFields(int maxCachedFields)
+{
+	m_maxCachedFields = (maxCachedFields > 0) ? maxCachedFields : 1;
+	while (static_cast<int>(m_fields.size()) > m_maxCachedFields)
+	{
+		EvictLeastRecentField();
+	}
+}
+
+void GridFlowFieldPathfinder::EvictLeastRecentField()
+{
+	if (m_fields.empty()) return;
+
+	auto leastRecent = m_fields.begin();
+	for (auto iter = m_fields.begin(); iter != m_fields.end(); ++iter)
+	{
+		if (iter->second.m_lastUsedTick < leastRecent->second.m_lastUsedTick) leastRecent = iter;
+	}
+	m_fields.erase(leastRecent);
+}
+
+GridFlowField const* GridFlowFieldPathfinder::GetFlowField(IntVec2 goal)
+{
+	if (!m_walkabilityGrid || !m_walkabilityGrid->IsInBounds(goal)) return nullptr;
+
+	m_tick++;
+	m_numTilesUpdated = 0;
+	IntVec2 dimensions = m_walkabilityGrid->GetDimensions();
+	int goalIndex = goal.y * dimensions.x + goal.x;
+
+	auto found = m_fields.find(goalIndex);
+	if (found != m_fields.end())
+	{
+		// Someone changed the grid without telling us, a repair can't know which tiles moved so start over
+		if (found->second.m_gridVersion != m_walkabilityGrid->GetVersion())
+		{
+			BuildField(found->second);
+		}
+		found->second.m_lastUsedTick = m_tick;
+		return &found->second;
+	}
+
+	if (static_cast<int>(m_fields.size()) >= m_maxCachedFields)
+	{
+		EvictLeastRecentField();
+	}
+
+	GridFlowField& field = m_fields[goalIndex];
+	field.m_goal = goal;
+	field.m_lastUsedTick = m_tick;
+	BuildField(field);
+	return &field;
+}
+
+void GridFlowFieldPathfinder::OnTileChanged(IntVec2 tile)
+{
+	if (!m_walkabilityGrid || !m_walkabilityGrid->IsInBounds(tile)) return;
+
+	bool isSolid = m_walkabilityGrid->IsSolid(tile);
+	m_numTilesUpdated = 0;
+	for (auto& goalAndField : m_fields)
+	{
+		GridFlowField& field = goalAndField.second;
+		if (tile == field.m_goal)
+		{
+			BuildField(field);
+		}
+		else if (isSolid)
+		{
+			RepairAfterTileBlocked(field, tile);
+		}
+		else
+		{
+			RepairAfterTileOpened(field, tile);
+		}
+		field.m_gridVersion = m_walkabilityGrid->GetVersion();
+	}
+}
+
+void GridFlowFieldPathfinder::ComputePath(IntVec2 start, IntVec2 goal, std::vector<IntVec2>& outPath)
+{
+	outPath.clear();
+	GridFlowField const* field = GetFlowField(goal);
+	if (!field || !field->IsReachable(start)) return;
+
+	// Costs fall strictly along the field so this always ends at the goal, the cap is only a guard against a corrupt field
+	int maxSteps = field->m_dimensions.x * field->m_dimensions.y;
+	IntVec2 tile = start;
+	while (tile != goal && static_cast<int>(outPath.size()) < maxSteps)
+	{
+		IntVec2 step = field->GetDirection(tile);
+		if (step == IntVec2(0, 0)) break;
+		tile += step;
+		outPath.emplace_back(tile);
+	}
+	std::reverse(outPath.begin(), outPath.end());
+}
+
+void GridFlowFieldPathfinder::BuildField(GridFlowField& field)
+{
+	double timeBefore = GetCurrentTimeSeconds();
+
+	IntVec2 dimensions = m_walkabilityGrid->GetDimensions();
+	field.m_dimensions = dimensions;
+	field.m_gridVersion = m_walkabilityGrid->GetVersion();
+	field.m_integration.assign(dimensions.x * dimensions.y, FLT_MAX);
+	field.m_directions.assign(dimensions.x * dimensions.y, FLOW_FIELD_NO_DIRECTION);
+
+	if (!m_walkabilityGrid->IsSolid(field.m_goal))
+	{
+		int goalIndex = field.GetIndex(field.m_goal);
+		field.m_integration[goalIndex] = 0.f;
+		m_openList.clear();
+		m_openList.emplace_back(0.f, goalIndex);
+		RunIntegration(field, false);
+		BuildDirections(field);
+	}
+
+	double timeAfter = GetCurrentTimeSeconds();
+	m_lastBuildMilliseconds = 1000.0 * (timeAfter - timeBefore);
+}
+
+void GridFlowFieldPathfinder::BuildDirections(GridFlowField& field) const
+{
+	IntVec2 dimensions = field.m_dimensions;
+	int numSectorsX = (dimensions.x + m_sectorSize - 1) / m_sectorSize;
+	int numSectorsY = (dimensions.y + m_sectorSize - 1) / m_sectorSize;
+
+	// Every tile only reads the finished integration field and writes its own direction, so sectors never touch each other's output
+	auto buildSector = [&](int sectorIndex)
+	{
+		int minX = (sectorIndex % numSectorsX) * m_sectorSize;
+		int minY = (sectorIndex / numSectorsX) * m_sectorSize;
+		int maxX = (minX + m_sectorSize < dimensions.x) ? minX + m_sectorSize : dimensions.x;
+		int maxY = (minY + m_sectorSize < dimensions.y) ? minY + m_sectorSize : dimensions.y;
+		for (int y = minY; y < maxY; y++)
+		{
+			for (int x = minX; x < maxX; x++)
+			{
+				int index = y * dimensions.x + x;
+				if (field.m_integration[index] == FLT_MAX || field.m_integration[index] == 0.f) continue;
+
+				float bestCost = FLT_MAX;
+				field.m_directions[index] = GetBestDirection(field, x, y, bestCost);
+			}
+		}
+	};
+
+	ParallelForIfAvailable(m_jobSystem, 0, numSectorsX * numSectorsY, 1, buildSector, JobType::AI);
+}
+
+uint8_t GridFlowFieldPathfinder::GetBestDirection(GridFlowField const& field, int x, int y, float& outCost) const
+{
+	uint8_t bestDirection = FLOW_FIELD_NO_DIRECTION;
+	outCost = FLT_MAX;
+	for (int direction = 0; direction < NUM_INTERCARDINAL_DIRECTIONS; direction++)
+	{
+		if (!m_walkabilityGrid->CanStep(x, y, s_stepsX[direction], s_stepsY[direction])) continue;
+
+		float neighborCost = field.m_integration[(y + s_stepsY[direction]) * field.m_dimensions.x + (x + s_stepsX[direction])];
+		if (neighborCost == FLT_MAX) continue;
+
+		float cost = neighborCost + s_stepCosts[direction];
+		if (cost < outCost)
+		{
+			outCost = cost;
+			bestDirection = static_cast<uint8_t>(direction);
+		}
+	}
+	return bestDirection;
+}
+
+void GridFlowFieldPathfinder::RunIntegration(GridFlowField& field, bool isTrackingDirections)
+{
+	int width = field.m_dimensions.x;
+	std::make_heap(m_openList.begin(), m_openList.end(), std::greater<OpenEntry>());
+
+	while (!m_openList.empty())
+	{
+		std::pop_heap(m_openList.begin(), m_openList.end(), std::greater<OpenEntry>());
+		OpenEntry entry = m_openList.back();
+		m_openList.pop_back();
+		if (entry.first > field.m_integration[entry.second]) continue; // Stale, this tile was settled cheaper already
+
+		m_numTilesUpdated++;
+		int x = entry.second % width;
+		int y = entry.second / width;
+		for (int direction = 0; direction < NUM_INTERCARDINAL_DIRECTIONS; direction++)
+		{
+			// Steps are symmetric, so the walk from the neighbor onto this tile is allowed exactly when this one is
+			if (!m_walkabilityGrid->CanStep(x, y, s_stepsX[direction], s_stepsY[direction])) continue;
+
+			int neighborIndex = entry.second + s_stepsY[direction] * width + s_stepsX[direction];
+			float cost = entry.first + s_stepCosts[direction];
+			if (cost < field.m_integration[neighborIndex])
+			{
+				field.m_integration[neighborIndex] = cost;
+				if (isTrackingDirections)
+				{
+					field.m_directions[neighborIndex] = static_cast<uint8_t>((direction + NUM_INTERCARDINAL_DIRECTIONS / 2) % NUM_INTERCARDINAL_DIRECTIONS);
+				}
+				m_openList.emplace_back(cost, neighborIndex);
+				std::push_heap(m_openList.begin(), m_openList.end(), std::greater<OpenEntry>());
+			}
+		}
+	}
+}
+
+void GridFlowFieldPathfinder::RepairAfterTileBlocked(GridFlowField& field, IntVec2 const& tile)
+{
+	// Only costs routed through the blocked tile can go up. Directions form a tree rooted at the goal, so everything downstream of a
+	// step that just became illegal is wiped, then refilled from the untouched tiles around it
+	int width = field.m_dimensions.x;
+	m_currentRepairGen++;
+	m_repairStack.clear();
+	m_invalidatedTiles.clear();
+
+	int tileIndex = field.GetIndex(tile);
+	m_repairGen[tileIndex] = m_currentRepairGen;
+	m_repairStack.emplace_back(tileIndex);
+	for (int direction = 0; direction < NUM_INTERCARDINAL_DIRECTIONS; direction++)
+	{
+		IntVec2 neighbor(tile.x + s_stepsX[direction], tile.y + s_stepsY[direction]);
+		if (!field.IsInBounds(neighbor)) continue;
+
+		// Diagonals squeezing past the tile count too, not just steps onto it
+		int neighborIndex = field.GetIndex(neighbor);
+		uint8_t neighborDirection = field.m_directions[neighborIndex];
+		if (neighborDirection == FLOW_FIELD_NO_DIRECTION) continue;
+		if (m_walkabilityGrid->CanStep(neighbor.x, neighbor.y, s_stepsX[neighborDirection], s_stepsY[neighborDirection])) continue;
+
+		m_repairGen[neighborIndex] = m_currentRepairGen;
+		m_repairStack.emplace_back(neighborIndex);
+	}
+
+	while (!m_repairStack.empty())
+	{
+		int index = m_repairStack.back();
+		m_repairStack.pop_back();
+		field.m_integration[index] = FLT_MAX;
+		field.m_directions[index] = FLOW_FIELD_NO_DIRECTION;
+		m_invalidatedTiles.emplace_back(index);
+
+		int x = index % width;
+		int y = index / width;
+		for (int direction = 0; direction < NUM_INTERCARDINAL_DIRECTIONS; direction++)
+		{
+			IntVec2 neighbor(x + s_stepsX[direction], y + s_stepsY[direction]);
+			if (!field.IsInBounds(neighbor)) continue;
+
+			int neighborIndex = field.GetIndex(neighbor);
+			if (m_repairGen[neighborIndex] == m_currentRepairGen) continue;
+
+			// A neighbor whose step lands back on this tile hangs off it in the tree
+			uint8_t neighborDirection = field.m_directions[neighborIndex];
+			if (neighborDirection != (direction + NUM_INTERCARDINAL_DIRECTIONS / 2) % NUM_INTERCARDINAL_DIRECTIONS) continue;
+
+			m_repairGen[neighborIndex] = m_currentRepairGen;
+			m_repairStack.emplace_back(neighborIndex);
+		}
+	}
+
+	m_openList.clear();
+	for (int index : m_invalidatedTiles)
+	{
+		int x = index % width;
+		int y = index / width;
+		if (m_walkabilityGrid->IsSolid(x, y)) continue;
+
+		float bestCost = FLT_MAX;
+		uint8_t bestDirection = GetBestDirection(field, x, y, bestCost);
+		if (bestDirection == FLOW_FIELD_NO_DIRECTION) continue;
+
+		field.m_integration[index] = bestCost;
+		field.m_directions[index] = bestDirection;
+		m_openList.emplace_back(bestCost, index);
+	}
+	RunIntegration(field, true);
+}
+
+void GridFlowFieldPathfinder::RepairAfterTileOpened(GridFlowField& field, IntVec2 const& tile)
+{
+	// Opening a tile can only lower costs. Every newly legal step touches the tile or joins two of its neighbors,
+	// so reseeding those nine tiles and letting Dijkstra spread the improvement is enough
+	m_openList.clear();
+	for (int direction = -1; direction < NUM_INTERCARDINAL_DIRECTIONS; direction++)
+	{
+		IntVec2 seed = (direction < 0) ? tile : IntVec2(tile.x + s_stepsX[direction], tile.y + s_stepsY[direction]);
+		if (!field.IsInBounds(seed) || seed == field.m_goal || m_walkabilityGrid->IsSolid(seed)) continue;
+
+		int seedIndex = field.GetIndex(seed);
+		float bestCost = FLT_MAX;
+		uint8_t bestDirection = GetBestDirection(field, seed.x, seed.y, bestCost);
+		if (bestCost < field.m_integration[seedIndex])
+		{
+			field.m_integration[seedIndex] = bestCost;
+			field.m_directions[seedIndex] = bestDirection;
+			m_openList.emplace_back(bestCost, seedIndex);
+		}
+	}
+	RunIntegration(field, true);
+}
+
+void GridFlowFieldPathfinder::SubscribeConsoleCommands()
+{
+	if (g_theEventSystem)
+	{
+		g_theEventSystem->SubscribeEventCallbackFunction("GridFlowFieldBenchmark", Command_GridFlowFieldBenchmark);
+	}
+}
+
+void GridFlowFieldPathfinder::UnsubscribeConsoleCommands()
+{
+	if (g_theEventSystem)
+	{
+		g_theEventSystem->UnsubscribeEventCallbackFunction("GridFlowFieldBenchmark", Command_GridFlowFieldBenchmark);
+	}
+}
+
+bool GridFlowFieldPathfinder::Command_GridFlowFieldBenchmark(EventArgs& args)
+{
+	int mapSize = std::stoi(args.GetValue<std::string>("size", "512"));
+	int numAgents = std::stoi(args.GetValue<std::string>("agents", "5000"));
+	int numAStarSamples = std::stoi(args.GetValue<std::string>("samples", "200")); // Per agent A* is too slow to run for every agent
+	int numEdits = std::stoi(args.GetValue<std::string>("edits", "100"));
+	unsigned int seed = static_cast<unsigned int>(std::stoi(args.GetValue<std::string>("seed", "1")));
+
+	GridWalkabilityGrid walkabilityGrid;
+	BuildOpenGridBenchmarkMap(walkabilityGrid, IntVec2(mapSize, mapSize), 0.1f, seed);
+
+	RandomNumberGenerator rng(seed);
+	auto rollWalkableTile = [&]()
+	{
+		for (int attempt = 0; attempt < 1000; attempt++)
+		{
+			IntVec2 tile(rng.SRollRandomIntInRange(0, mapSize - 1), rng.SRollRandomIntInRange(0, mapSize - 1));
+			if (!walkabilityGrid.IsSolid(tile)) return tile;
+		}
+		return IntVec2(0, 0);
+	};
+	IntVec2 goal = rollWalkableTile();
+	std::vector<IntVec2> agentTiles(numAgents);
+	for (IntVec2& agentTile : agentTiles)
+	{
+		agentTile = rollWalkableTile();
+	}
+
+	GridAStar aStar(IntVec2(mapSize, mapSize));
+	aStar.SetDirectionMode(DirectionMode::Cardinal8);
+	aStar.SetWalkabilityGrid(&walkabilityGrid);
+	aStar.m_maxSearchDistance = mapSize * 2;
+
+	std::vector<IntVec2> path;
+	int numSamples = (numAStarSamples < numAgents) ? numAStarSamples : numAgents;
+	double timeBefore = GetCurrentTimeSeconds();
+	for (int agent = 0; agent < numSamples; agent++)
+	{
+		aStar.ComputeAStar(agentTiles[agent], goal, path);
+	}
+	double aStarMs = 1000.0 * (GetCurrentTimeSeconds() - timeBefore);
+	double aStarEstimateMs = (numSamples > 0) ? aStarMs * static_cast<double>(numAgents) / static_cast<double>(numSamples) : 0.0;
+
+	GridFlowFieldPathfinder flowFieldPathfinder(&walkabilityGrid, g_theJobSystem);
+	GridFlowField const* field = flowFieldPathfinder.GetFlowField(goal);
+	double buildMs = flowFieldPathfinder.GetLastBuildMilliseconds();
+
+	// Every agent walks its whole route by sampling, the same work agents would spread over many frames
+	int numReachable = 0;
+	long long numSteps = 0;
+	timeBefore = GetCurrentTimeSeconds();
+	for (IntVec2 agentTile : agentTiles)
+	{
+		if (!field->IsReachable(agentTile)) continue;
+		numReachable++;
+		while (agentTile != goal)
+		{
+			agentTile += field->GetDirection(agentTile);
+			numSteps++;
+		}
+	}
+	double sampleMs = 1000.0 * (GetCurrentTimeSeconds() - timeBefore);
+
+	long long numTilesRepaired = 0;
+	timeBefore = GetCurrentTimeSeconds();
+	for (int edit = 0; edit < numEdits; edit++)
+	{
+		IntVec2 tile(rng.SRollRandomIntInRange(0, mapSize - 1), rng.SRollRandomIntInRange(0, mapSize - 1));
+		if (tile == goal) continue;
+		walkabilityGrid.SetSolid(tile, !walkabilityGrid.IsSolid(tile));
+		flowFieldPathfinder.OnTileChanged(tile);
+		numTilesRepaired += flowFieldPathfinder.GetNumTilesUpdated();
+	}
+	double repairMs = 1000.0 * (GetCurrentTimeSeconds() - timeBefore);
+
+	g_theConsole->AddLine(Rgba8::LIGHT_ORANGE, Stringf("Flow field %ix%i, %i agents, %i reach the goal", mapSize, mapSize, numAgents, numReachable));
+	g_theConsole->AddLine(Rgba8::LIGHT_ORANGE, Stringf("  A* per agent: %.02f ms for %i agents, about %.02f ms for all of them", aStarMs, numSamples, aStarEstimateMs));
+	g_theConsole->AddLine(Rgba8::LIGHT_ORANGE, Stringf("  Flow field:   %.02f ms to build, %.02f ms to walk %lld steps", buildMs, sampleMs, numSteps));
+	g_theConsole->AddLine(Rgba8::LIGHT_ORANGE, Stringf("  Repair:       %.02f ms for %i edits, %lld tiles resettled", repairMs, numEdits, numTilesRepaired));
+	return true;
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include "Engine/AI/Pathfinding/Grid/GridPathfindingManager.hpp"
+#include "Engine/AI/Pathfinding/Grid/GridWalkabilityGrid.hpp"
+#include "Engine/Core/EventSystem.hpp"
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+class JobSystem;
+
+constexpr int FLOW_FIELD_DEFAULT_SECTOR_SIZE = 64;
+constexpr int FLOW_FIELD_DEFAULT_MAX_CACHED_FIELDS = 8;
+constexpr uint8_t FLOW_FIELD_NO_DIRECTION = 0xFF;
+
+// Walking cost from every tile to one goal tile (the integration or distance field) plus the step each tile should take (the flow field).
+// Every agent heading to the same goal shares one and only looks up the tile it stands on
+class GridFlowField
+{
+public:
+	IntVec2 GetGoal() const { return m_goal; }
+	IntVec2 GetDimensions() const { return m_dimensions; }
+
+	bool IsReachable(IntVec2 tile) const; // False for solid tiles and tiles walled off from the goal
+	float GetIntegrationCost(IntVec2 tile) const; // Octile walking cost to the goal, FLT_MAX when it can't be reached
+	IntVec2 GetDirection(IntVec2 tile) const; // Step toward the goal, zero on the goal itself and wherever the goal can't be reached
+
+	friend class GridFlowFieldPathfinder;
+
+private:
+	int GetIndex(IntVec2 const& tile) const { return tile.y * m_dimensions.x + tile.x; }
+	bool IsInBounds(IntVec2 const& tile) const { return tile.x >= 0 && tile.x < m_dimensions.x && tile.y >= 0 && tile.y < m_dimensions.y; }
+
+private:
+	IntVec2 m_goal = IntVec2(0, 0);
+	IntVec2 m_dimensions = IntVec2(0, 0);
+	std::vector<float> m_integration;
+	std::vector<uint8_t> m_directions; // IntercardinalDir per tile, or FLOW_FIELD_NO_DIRECTION
+	unsigned int m_gridVersion = 0; // Walkability grid version this field matches
+	unsigned int m_lastUsedTick = 0;
+};
+
+// Builds flow fields on demand and keeps the most recently used ones, keyed by goal tile. The integration pass is one Dijkstra from the goal,
+// the direction pass runs per sector across the job system when one is set. OnTileChanged repairs every cached field in place,
+// only the tiles whose cost actually changes are touched
+class GridFlowFieldPathfinder : public IGridPathfinder
+{
+public:
+	GridFlowFieldPathfinder() = default;
+	explicit GridFlowFieldPathfinder(GridWalkabilityGrid const* walkabilityGrid, JobSystem* jobSystem = nullptr);
+	~GridFlowFieldPathfinder() override = default;
+
+	void SetWalkabilityGrid(GridWalkabilityGrid const* walkabilityGrid); // Drops every cached field
+	void SetJobSystem(JobSystem* jobSystem) { m_jobSystem = jobSystem; } // Null builds the direction pass on the calling thread
+	void SetSectorSize(int sectorSize) { m_sectorSize = (sectorSize > 0) ? sectorSize : FLOW_FIELD_DEFAULT_SECTOR_SIZE; }
+	void SetMaxCachedFields(int maxCachedFields);
+
+	// Builds the field the first time a goal is asked for. The pointer stays valid until that field is evicted or the cache is cleared
+	GridFlowField const* GetFlowField(IntVec2 goal);
+	void OnTileChanged(IntVec2 tile) override; // Call once per changed tile, after changing the walkability grid
+	void ClearCache() { m_fields.clear(); }
+
+	// Follows the field for goal from start. Path is goal first and leaves out the start, same as GridAStar::ComputeAStar
+	void ComputePath(IntVec2 start, IntVec2 goal, std::vector<IntVec2>& outPath) override;
+
+	int GetNumCachedFields() const { return static_cast<int>(m_fields.size()); }
+	int GetNumTilesUpdated() const { return m_numTilesUpdated; } // Tiles settled by the last GetFlowField or OnTileChanged, over every field it touched
+	int GetNumNodesExpanded() const override { return m_numTilesUpdated; } // Zero when ComputePath found its field cached
+	double GetLastBuildMilliseconds() const { return m_lastBuildMilliseconds; }
+
+	static void SubscribeConsoleCommands(); // Once at startup, after the event system exists
+	static void UnsubscribeConsoleCommands();
+	static bool Command_GridFlowFieldBenchmark(EventArgs& args);
+
+private:
+	void EvictLeastRecentField();
+	void BuildField(GridFlowField& field);
+	void BuildDirections(GridFlowField& field) const;
+	uint8_t GetBestDirection(GridFlowField const& field, int x, int y, float& outCost) const;
+	void RunIntegration(GridFlowField& field, bool isTrackingDirections);
+	void RepairAfterTileBlocked(GridFlowField& field, IntVec2 const& tile);
+	void RepairAfterTileOpened(GridFlowField& field, IntVec2 const& tile);
+
+private:
+	GridWalkabilityGrid const* m_walkabilityGrid = nullptr; // Not owned
+	JobSystem* m_jobSystem = nullptr; // Not owned
+	int m_sectorSize = FLOW_FIELD_DEFAULT_SECTOR_SIZE;
+	int m_maxCachedFields = FLOW_FIELD_DEFAULT_MAX_CACHED_FIELDS;
+
+	std::unordered_map<int, GridFlowField> m_fields; // Goal tile index to field
+	unsigned int m_tick = 0;
+
+	// Repair and integration scratch
+	std::vector<std::pair<float, int>> m_openList;
+	std::vector<int> m_repairStack;
+	std::vector<int> m_invalidatedTiles;
+	std::vector<unsigned int> m_repairGen;
+	unsigned int m_currentRepairGen = 0;
+
+	int m_numTilesUpdated = 0;
+	double m_lastBuildMilliseconds = 0.0;
+};
@@ -0,0 +1,562 @@
+#include "Engine/AI/Pathfinding/Grid/GridHierarchicalPathfinder.hpp"
+#include <algorithm>
+
+using OpenEntry = std::pair<float, int>;
+
+GridHierarchicalPathfinder::GridHierarchicalPathfinder(GridWalkabilityGrid const* walkabilityGrid, int clusterSize)
+{
+	Build(walkabilityGrid, clusterSize);
+}
+
+void GridHierarchicalPathfinder::Build(GridWalkabilityGrid const* walkabilityGrid, int clusterSize)
+{
+	m_walkabilityGrid = walkabilityGrid;
+	m_clusterSize = (clusterSize < 2) ? 2 : clusterSize;
+	m_clusters.clear();
+	m_nodes.clear();
+	m_freeNodes.clear();
+	m_nodeIndexByTile.clear();
+	m_dirtyClusters.clear();
+	if (!m_walkabilityGrid) return;
+
+	IntVec2 dimensions = m_walkabilityGrid->GetDimensions();
+	m_numClusters = IntVec2((dimensions.x + m_clusterSize - 1) / m_clusterSize, (dimensions.y + m_clusterSize - 1) / m_clusterSize);
+	m_clusters.resize(m_numClusters.x * m_numClusters.y);
+	for (int clusterY = 0; clusterY < m_numClusters.y; clusterY++)
+	{
+		for (int clusterX = 0; clusterX < m_numClusters.x; clusterX++)
+		{
+			GridHPACluster& cluster = m_clusters[clusterY * m_numClusters.x + clusterX];
+			cluster.m_mins = IntVec2(clusterX * m_clusterSize, clusterY * m_clusterSize);
+			cluster.m_maxs = IntVec2(std::min(cluster.m_mins.x + m_clusterSize, dimensions.x), std::min(cluster.m_mins.y + m_clusterSize, dimensions.y));
+		}
+	}
+
+	int numLocalTiles = m_clusterSize * m_clusterSize;
+	m_localCosts.assign(numLocalTiles, 0.f);
+	m_localParents.assign(numLocalTiles, -1);
+	m_localSearchGen.assign(numLocalTiles, 0);
+	m_localGen = 0;
+
+	// Every border is shared, so each cluster only builds the ones to its east and north
+	for (int clusterIndex = 0; clusterIndex < static_cast<int>(m_clusters.size()); clusterIndex++)
+	{
+		BuildBorderEntrances(clusterIndex, EAST);
+		BuildBorderEntrances(clusterIndex, NORTH);
+	}
+	for (int clusterIndex = 0; clusterIndex < static_cast<int>(m_clusters.size()); clusterIndex++)
+	{
+		BuildIntraClusterEdges(clusterIndex);
+	}
+}
+
+void GridHierarchicalPathfinder::OnTileChanged(IntVec2 tile)
+{
+	if (!m_walkabilityGrid || !m_walkabilityGrid->IsInBounds(tile)) return;
+
+	int clusterIndex = GetClusterIndex(tile);
+	if (!m_clusters[clusterIndex].m_isDirty)
+	{
+		m_clusters[clusterIndex].m_isDirty = true;
+		m_dirtyClusters.emplace_back(clusterIndex);
+	}
+}
+
+void GridHierarchicalPathfinder::RebuildDirtyClusters()
+{
+	for (int clusterIndex : m_dirtyClusters)
+	{
+		RebuildCluster(clusterIndex);
+	}
+	m_dirtyClusters.clear();
+}
+
+void GridHierarchicalPathfinder::ComputePath(IntVec2 start, IntVec2 goal, std::vector<IntVec2>& outPath)
+{
+	outPath.clear();
+	if (!ComputeAbstractPath(start, goal, m_waypoints)) return;
+
+	for (int waypointIndex = static_cast<int>(m_waypoints.size()) - 1; waypointIndex > 0; waypointIndex--)
+	{
+		if (!RefineSegment(m_waypoints[waypointIndex - 1], m_waypoints[waypointIndex], m_segmentTiles))
+		{
+			outPath.clear();
+			return;
+		}
+
+		for (int tileIndex = static_cast<int>(m_segmentTiles.size()) - 1; tileIndex >= 0; tileIndex--)
+		{
+			outPath.emplace_back(m_segmentTiles[tileIndex]);
+		}
+	}
+}
+
+bool GridHierarchicalPathfinder::ComputeAbstractPath(IntVec2 start, IntVec2 goal, std::vector<IntVec2>& outWaypoints)
+{
+	outWaypoints.clear();
+	m_numNodesExpanded = 0;
+	if (!m_walkabilityGrid) return false;
+
+	RebuildDirtyClusters();
+
+	if (!m_walkabilityGrid->IsInBounds(start) || !m_walkabilityGrid->IsInBounds(goal)) return false;
+	if (m_walkabilityGrid->IsSolid(start) || m_walkabilityGrid->IsSolid(goal)) return false;
+
+	if (start == goal)
+	{
+		outWaypoints.emplace_back(start);
+		return true;
+	}
+
+	// Neighbors in one cluster rarely need to leave it, so try the cheap local walk before touching the abstract graph
+	int startCluster = GetClusterIndex(start);
+	if (startCluster == GetClusterIndex(goal) && SearchWithinCluster(startCluster, start, &goal))
+	{
+		outWaypoints.emplace_back(start);
+		outWaypoints.emplace_back(goal);
+		return true;
+	}
+
+	// Endpoints that aren't already entrances join the graph just for this query
+	IntVec2 dimensions = m_walkabilityGrid->GetDimensions();
+	bool isStartTemporary = (m_nodeIndexByTile.find(start.y * dimensions.x + start.x) == m_nodeIndexByTile.end());
+	int startNode = FindOrCreateNode(start);
+	if (isStartTemporary)
+	{
+		ConnectNodeWithinCluster(startNode);
+	}
+
+	bool isGoalTemporary = (m_nodeIndexByTile.find(goal.y * dimensions.x + goal.x) == m_nodeIndexByTile.end());
+	int goalNode = FindOrCreateNode(goal);
+	if (isGoalTemporary)
+	{
+		ConnectNodeWithinCluster(goalNode);
+	}
+
+	bool isPathFound = SearchAbstractGraph(startNode, goalNode, outWaypoints);
+
+	if (isGoalTemporary)
+	{
+		RemoveNode(goalNode);
+	}
+	if (isStartTemporary)
+	{
+		RemoveNode(startNode);
+	}
+	return isPathFound;
+}
+
+bool GridHierarchicalPathfinder::RefineSegment(IntVec2 from, IntVec2 to, std::vector<IntVec2>& outTiles)
+{
+	outTiles.clear();
+	if (!m_walkabilityGrid) return false;
+
+	IntVec2 step = to - from;
+	if (abs(step.x) <= 1 && abs(step.y) <= 1 && step != IntVec2(0, 0) && m_walkabilityGrid->CanStep(from, step))
+	{
+		outTiles.emplace_back(to);
+		return true;
+	}
+
+	int clusterIndex = GetClusterIndex(from);
+	if (clusterIndex != GetClusterIndex(to)) return false;
+	if (!SearchWithinCluster(clusterIndex, from, &to)) return false;
+
+	GridHPACluster const& cluster = m_clusters[clusterIndex];
+	int fromLocal = GetLocalIndex(cluster, from);
+	for (int localIndex = GetLocalIndex(cluster, to); localIndex != fromLocal; localIndex = m_localParents[localIndex])
+	{
+		outTiles.emplace_back(IntVec2(cluster.m_mins.x + localIndex % m_clusterSize, cluster.m_mins.y + localIndex / m_clusterSize));
+	}
+	std::reverse(outTiles.begin(), outTiles.end());
+	return true;
+}
+
+int GridHierarchicalPathfinder::GetClusterIndex(IntVec2 const& tile) const
+{
+	return (tile.y / m_clusterSize) * m_numClusters.x + (tile.x / m_clusterSize);
+}
+
+int GridHierarchicalPathfinder::FindOrCreateNode(IntVec2 const& tile)
+{
+	int tileIndex = tile.y * m_walkabilityGrid->GetDimensions().x + tile.x;
+	auto found = m_nodeIndexByTile.find(tileIndex);
+	if (found != m_nodeIndexByTile.end()) return found->second;
+
+	int nodeIndex = -1;
+	if (!m_freeNodes.empty())
+	{
+		nodeIndex = m_freeNodes.back();
+		m_freeNodes.pop_back();
+	}
+	else
+	{
+		nodeIndex = static_cast<int>(m_nodes.size());
+		m_nodes.emplace_back();
+	}
+
+	GridHPANode& node = m_nodes[nodeIndex];
+	node.m_tile = tile;
+	node.m_clusterIndex = GetClusterIndex(tile);
+	node.m_numInterClusterEdges = 0;
+	node.m_isAlive = true;
+	node.m_edges.clear();
+
+	m_clusters[node.m_clusterIndex].m_nodes.emplace_back(nodeIndex);
+	m_nodeIndexByTile[tileIndex] = nodeIndex;
+	return nodeIndex;
+}
+
+void GridHierarchicalPathfinder::RemoveNode(int nodeIndex)
+{
+	GridHPANode& node = m_nodes[nodeIndex];
+	for (GridHPAEdge const& edge : node.m_edges)
+	{
+		RemoveEdgesTo(edge.m_toNode, nodeIndex);
+	}
+	node.m_edges.clear();
+	node.m_numInterClusterEdges = 0;
+	node.m_isAlive = false;
+
+	std::vector<int>& clusterNodes = m_clusters[node.m_clusterIndex].m_nodes;
+	clusterNodes.erase(std::remove(clusterNodes.begin(), clusterNodes.end(), nodeIndex), clusterNodes.end());
+	m_nodeIndexByTile.erase(node.m_tile.y * m_walkabilityGrid->GetDimensions().x + node.m_tile.x);
+	m_freeNodes.emplace_back(nodeIndex);
+}
+
+void GridHierarchicalPathfinder::AddEdge(int fromNode, int toNode, float cost, bool isInterCluster)
+{
+	GridHPANode& node = m_nodes[fromNode];
+	for (GridHPAEdge& edge : node.m_edges)
+	{
+		if (edge.m_toNode == toNode && edge.m_isInterCluster == isInterCluster)
+		{
+			edge.m_cost = cost;
+			return;
+		}
+	}
+
+	GridHPAEdge edge;
+	edge.m_toNode = toNode;
+	edge.m_cost = cost;
+	edge.m_isInterCluster = isInterCluster;
+	node.m_edges.emplace_back(edge);
+	if (isInterCluster)
+	{
+		node.m_numInterClusterEdges++;
+	}
+}
+
+void GridHierarchicalPathfinder::RemoveEdgesTo(int fromNode, int toNode)
+{
+	GridHPANode& node = m_nodes[fromNode];
+	for (int edgeIndex = static_cast<int>(node.m_edges.size()) - 1; edgeIndex >= 0; edgeIndex--)
+	{
+		if (node.m_edges[edgeIndex].m_toNode != toNode) continue;
+
+		if (node.m_edges[edgeIndex].m_isInterCluster)
+		{
+			node.m_numInterClusterEdges--;
+		}
+		node.m_edges[edgeIndex] = node.m_edges.back();
+		node.m_edges.pop_back();
+	}
+}
+
+void GridHierarchicalPathfinder::BuildBorderEntrances(int clusterIndex, CardinalDir direction)
+{
+	IntVec2 clusterCoords(clusterIndex % m_numClusters.x, clusterIndex / m_numClusters.x);
+	IntVec2 step = GetStepInCardinalDirection(direction);
+	IntVec2 neighborCoords = clusterCoords + step;
+	if (neighborCoords.x < 0 || neighborCoords.x >= m_numClusters.x || neighborCoords.y < 0 || neighborCoords.y >= m_numClusters.y) return;
+
+	GridHPACluster const& cluster = m_clusters[clusterIndex];
+	bool isAlongY = (step.x != 0);
+	IntVec2 along = isAlongY ? IntVec2(0, 1) : IntVec2(1, 0);
+	IntVec2 firstTile;
+	firstTile.x = isAlongY ? ((step.x > 0) ? cluster.m_maxs.x - 1 : cluster.m_mins.x) : cluster.m_mins.x;
+	firstTile.y = isAlongY ? cluster.m_mins.y : ((step.y > 0) ? cluster.m_maxs.y - 1 : cluster.m_mins.y);
+	int borderLength = isAlongY ? (cluster.m_maxs.y - cluster.m_mins.y) : (cluster.m_maxs.x - cluster.m_mins.x);
+
+	int openingStart = -1;
+	for (int offset = 0; offset <= borderLength; offset++)
+	{
+		bool isOpen = false;
+		if (offset < borderLength)
+		{
+			IntVec2 tile(firstTile.x + along.x * offset, firstTile.y + along.y * offset);
+			isOpen = !m_walkabilityGrid->IsSolid(tile) && !m_walkabilityGrid->IsSolid(tile + step);
+		}
+
+		if (isOpen && openingStart < 0)
+		{
+			openingStart = offset;
+		}
+		else if (!isOpen && openingStart >= 0)
+		{
+			// One transition in the middle of a narrow opening, one at each end of a wide one
+			int openingLength = offset - openingStart;
+			int transitions[2] = { openingStart + openingLength / 2, -1 };
+			if (openingLength >= HPA_ENTRANCE_SPLIT_LENGTH)
+			{
+				transitions[0] = openingStart;
+				transitions[1] = offset - 1;
+			}
+
+			for (int transition : transitions)
+			{
+				if (transition < 0) continue;
+
+				IntVec2 tile(firstTile.x + along.x * transition, firstTile.y + along.y * transition);
+				int nodeA = FindOrCreateNode(tile);
+				int nodeB = FindOrCreateNode(tile + step);
+				AddEdge(nodeA, nodeB, 1.f, true);
+				AddEdge(nodeB, nodeA, 1.f, true);
+			}
+			openingStart = -1;
+		}
+	}
+}
+
+void GridHierarchicalPathfinder::BuildIntraClusterEdges(int clusterIndex)
+{
+	GridHPACluster const& cluster = m_clusters[clusterIndex];
+	for (int nodeIndex : cluster.m_nodes)
+	{
+		std::vector<GridHPAEdge>& edges = m_nodes[nodeIndex].m_edges;
+		edges.erase(std::remove_if(edges.begin(), edges.end(), [](GridHPAEdge const& edge) { return !edge.m_isInterCluster; }), edges.end());
+	}
+
+	// Walks are symmetric, so each pair only needs the search from its first node
+	int numNodes = static_cast<int>(cluster.m_nodes.size());
+	for (int first = 0; first < numNodes; first++)
+	{
+		int firstNode = cluster.m_nodes[first];
+		SearchWithinCluster(clusterIndex, m_nodes[firstNode].m_tile, nullptr);
+		for (int second = first + 1; second < numNodes; second++)
+		{
+			int secondNode = cluster.m_nodes[second];
+			int localIndex = GetLocalIndex(cluster, m_nodes[secondNode].m_tile);
+			if (m_localSearchGen[localIndex] != m_localGen) continue;
+
+			AddEdge(firstNode, secondNode, m_localCosts[localIndex], false);
+			AddEdge(secondNode, firstNode, m_localCosts[localIndex], false);
+		}
+	}
+}
+
+void GridHierarchicalPathfinder::ConnectNodeWithinCluster(int nodeIndex)
+{
+	int clusterIndex = m_nodes[nodeIndex].m_clusterIndex;
+	GridHPACluster const& cluster = m_clusters[clusterIndex];
+	SearchWithinCluster(clusterIndex, m_nodes[nodeIndex].m_tile, nullptr);
+	for (int otherNode : cluster.m_nodes)
+	{
+		if (otherNode == nodeIndex) continue;
+
+		int localIndex = GetLocalIndex(cluster, m_nodes[otherNode].m_tile);
+		if (m_localSearchGen[localIndex] != m_localGen) continue;
+
+		AddEdge(nodeIndex, otherNode, m_localCosts[localIndex], false);
+		AddEdge(otherNode, nodeIndex, m_localCosts[localIndex], false);
+	}
+}
+
+void GridHierarchicalPathfinder::RebuildCluster(int clusterIndex)
+{
+	IntVec2 clusterCoords(clusterIndex % m_numClusters.x, clusterIndex / m_numClusters.x);
+	int dimensionsX = m_walkabilityGrid->GetDimensions().x;
+
+	// Remember which entrance tiles each neighbor had, its cached walks only need redoing if that set changes
+	int neighborClusters[NUM_CARDINAL_DIRECTIONS];
+	std::vector<int> neighborTilesBefore[NUM_CARDINAL_DIRECTIONS];
+	for (int direction = 0; direction < NUM_CARDINAL_DIRECTIONS; direction++)
+	{
+		IntVec2 neighborCoords = clusterCoords + GetStepInCardinalDirection(CardinalDir(direction));
+		bool isInBounds = neighborCoords.x >= 0 && neighborCoords.x < m_numClusters.x && neighborCoords.y >= 0 && neighborCoords.y < m_numClusters.y;
+		neighborClusters[direction] = isInBounds ? neighborCoords.y * m_numClusters.x + neighborCoords.x : -1;
+		if (!isInBounds) continue;
+
+		for (int nodeIndex : m_clusters[neighborClusters[direction]].m_nodes)
+		{
+			neighborTilesBefore[direction].emplace_back(m_nodes[nodeIndex].m_tile.y * dimensionsX + m_nodes[nodeIndex].m_tile.x);
+		}
+		std::sort(neighborTilesBefore[direction].begin(), neighborTilesBefore[direction].end());
+	}
+
+	// Drop every node of this cluster and rebuild its borders
+	std::vector<int> clusterNodes = m_clusters[clusterIndex].m_nodes;
+	std::vector<int> pairedNodes;
+	for (int nodeIndex : clusterNodes)
+	{
+		for (GridHPAEdge const& edge : m_nodes[nodeIndex].m_edges)
+		{
+			if (edge.m_isInterCluster)
+			{
+				pairedNodes.emplace_back(edge.m_toNode);
+			}
+		}
+	}
+	for (int nodeIndex : clusterNodes)
+	{
+		RemoveNode(nodeIndex);
+	}
+
+	for (int direction = 0; direction < NUM_CARDINAL_DIRECTIONS; direction++)
+	{
+		BuildBorderEntrances(clusterIndex, CardinalDir(direction));
+	}
+
+	// Only now drop neighbor nodes left with nothing to pair with. A neighbor node that got paired again keeps its cached walks
+	for (int nodeIndex : pairedNodes)
+	{
+		if (m_nodes[nodeIndex].m_isAlive && m_nodes[nodeIndex].m_numInterClusterEdges == 0)
+		{
+			RemoveNode(nodeIndex);
+		}
+	}
+
+	BuildIntraClusterEdges(clusterIndex);
+	for (int direction = 0; direction < NUM_CARDINAL_DIRECTIONS; direction++)
+	{
+		if (neighborClusters[direction] < 0) continue;
+
+		std::vector<int> neighborTilesAfter;
+		for (int nodeIndex : m_clusters[neighborClusters[direction]].m_nodes)
+		{
+			neighborTilesAfter.emplace_back(m_nodes[nodeIndex].m_tile.y * dimensionsX + m_nodes[nodeIndex].m_tile.x);
+		}
+		std::sort(neighborTilesAfter.begin(), neighborTilesAfter.end());
+		if (neighborTilesAfter != neighborTilesBefore[direction])
+		{
+			BuildIntraClusterEdges(neighborClusters[direction]);
+		}
+	}
+
+	m_clusters[clusterIndex].m_isDirty = false;
+}
+
+bool GridHierarchicalPathfinder::SearchWithinCluster(int clusterIndex, IntVec2 const& source, IntVec2 const* target)
+{
+	GridHPACluster const& cluster = m_clusters[clusterIndex];
+	m_localGen++;
+	m_localOpenList.clear();
+
+	// Every cluster is rebuilt with one of these per node, so the loop sticks to plain ints
+	int minX = cluster.m_mins.x;
+	int minY = cluster.m_mins.y;
+	int maxX = cluster.m_maxs.x;
+	int maxY = cluster.m_maxs.y;
+	int targetIndex = target ? GetLocalIndex(cluster, *target) : -1;
+	int stepsX[NUM_INTERCARDINAL_DIRECTIONS];
+	int stepsY[NUM_INTERCARDINAL_DIRECTIONS];
+	for (int direction = 0; direction < NUM_INTERCARDINAL_DIRECTIONS; direction++)
+	{
+		IntVec2 step = GetStepInCardinalAndIntercardinalDirection(IntercardinalDir(direction));
+		stepsX[direction] = step.x;
+		stepsY[direction] = step.y;
+	}
+
+	int sourceIndex = GetLocalIndex(cluster, source);
+	m_localCosts[sourceIndex] = 0.f;
+	m_localParents[sourceIndex] = -1;
+	m_localSearchGen[sourceIndex] = m_localGen;
+	m_localOpenList.emplace_back(0.f, sourceIndex);
+
+	while (!m_localOpenList.empty())
+	{
+		std::pop_heap(m_localOpenList.begin(), m_localOpenList.end(), std::greater<OpenEntry>());
+		OpenEntry entry = m_localOpenList.back();
+		m_localOpenList.pop_back();
+		if (entry.first > m_localCosts[entry.second]) continue; // Stale, a cheaper entry for this tile was already settled
+
+		m_numNodesExpanded++;
+		if (entry.second == targetIndex) return true;
+
+		int x = minX + entry.second % m_clusterSize;
+		int y = minY + entry.second / m_clusterSize;
+		for (int direction = 0; direction < NUM_INTERCARDINAL_DIRECTIONS; direction++)
+		{
+			int neighborX = x + stepsX[direction];
+			int neighborY = y + stepsY[direction];
+			if (neighborX < minX || neighborX >= maxX || neighborY < minY || neighborY >= maxY) continue;
+			if (!m_walkabilityGrid->CanStep(x, y, stepsX[direction], stepsY[direction])) continue;
+
+			int neighborIndex = (neighborY - minY) * m_clusterSize + (neighborX - minX);
+			float cost = entry.first + ((stepsX[direction] != 0 && stepsY[direction] != 0) ? 1.41421356f : 1.f);
+			if (m_localSearchGen[neighborIndex] != m_localGen || cost < m_localCosts[neighborIndex])
+			{
+				m_localSearchGen[neighborIndex] = m_localGen;
+				m_localCosts[neighborIndex] = cost;
+				m_localParents[neighborIndex] = entry.second;
+				m_localOpenList.emplace_back(cost, neighborIndex);
+				std::push_heap(m_localOpenList.begin(), m_localOpenList.end(), std::greater<OpenEntry>());
+			}
+		}
+	}
+	return target == nullptr;
+}
+
+bool GridHierarchicalPathfinder::SearchAbstractGraph(int startNode, int goalNode, std::vector<IntVec2>& outWaypoints)
+{
+	int numNodeSlots = static_cast<int>(m_nodes.size());
+	if (static_cast<int>(m_abstractCosts.size()) < numNodeSlots)
+	{
+		m_abstractCosts.resize(numNodeSlots, 0.f);
+		m_abstractParents.resize(numNodeSlots, -1);
+		m_abstractSearchGen.resize(numNodeSlots, 0);
+		m_abstractClosedGen.resize(numNodeSlots, 0);
+	}
+
+	m_abstractGen++;
+	m_abstractOpenList.clear();
+
+	IntVec2 const& goalTile = m_nodes[goalNode].m_tile;
+	m_abstractCosts[startNode] = 0.f;
+	m_abstractParents[startNode] = -1;
+	m_abstractSearchGen[startNode] = m_abstractGen;
+	m_abstractOpenList.emplace_back(GetHeuristic(m_nodes[startNode].m_tile, goalTile), startNode);
+
+	while (!m_abstractOpenList.empty())
+	{
+		std::pop_heap(m_abstractOpenList.begin(), m_abstractOpenList.end(), std::greater<OpenEntry>());
+		int nodeIndex = m_abstractOpenList.back().second;
+		m_abstractOpenList.pop_back();
+
+		if (m_abstractClosedGen[nodeIndex] == m_abstractGen) continue;
+		m_abstractClosedGen[nodeIndex] = m_abstractGen;
+		m_numNodesExpanded++;
+
+		if (nodeIndex == goalNode)
+		{
+			for (int pathNode = goalNode; pathNode >= 0; pathNode = m_abstractParents[pathNode])
+			{
+				outWaypoints.emplace_back(m_nodes[pathNode].m_tile);
+			}
+			std::reverse(outWaypoints.begin(), outWaypoints.end());
+			return true;
+		}
+
+		for (GridHPAEdge const& edge : m_nodes[nodeIndex].m_edges)
+		{
+			if (m_abstractClosedGen[edge.m_toNode] == m_abstractGen) continue;
+
+			float cost = m_abstractCosts[nodeIndex] + edge.m_cost;
+			if (m_abstractSearchGen[edge.m_toNode] != m_abstractGen || cost < m_abstractCosts[edge.m_toNode])
+			{
+				m_abstractSearchGen[edge.m_toNode] = m_abstractGen;
+				m_abstractCosts[edge.m_toNode] = cost;
+				m_abstractParents[edge.m_toNode] = nodeIndex;
+				m_abstractOpenList.emplace_back(cost + GetHeuristic(m_nodes[edge.m_toNode].m_tile, goalTile), edge.m_toNode);
+				std::push_heap(m_abstractOpenList.begin(), m_abstractOpenList.end(), std::greater<OpenEntry>());
+			}
+		}
+	}
+	return false;
+}
+
+float GridHierarchicalPathfinder::GetHeuristic(IntVec2 const& from, IntVec2 const& goal) const
+{
+	if (m_heuristic) return static_cast<float>(m_heuristic(from, goal));
+	return GetOctileDistance(from, goal);
+}
@@ -0,0 +1,109 @@
+#pragma once
+#include "Engine/AI/Pathfinding/Grid/GridPathfindingManager.hpp"
+#include "Engine/AI/Pathfinding/Grid/GridWalkabilityGrid.hpp"
+#include <vector>
+#include <unordered_map>
+
+constexpr int HPA_DEFAULT_CLUSTER_SIZE = 32;
+constexpr int HPA_ENTRANCE_SPLIT_LENGTH = 6; // Border openings at least this wide get a transition at each end instead of one in the middle
+
+struct GridHPAEdge
+{
+	int m_toNode = -1;
+	float m_cost = 0.f;
+	bool m_isInterCluster = false; // One step across a cluster border, otherwise a cached walk inside one cluster
+};
+
+struct GridHPANode
+{
+	IntVec2 m_tile;
+	int m_clusterIndex = -1;
+	int m_numInterClusterEdges = 0;
+	bool m_isAlive = false;
+	std::vector<GridHPAEdge> m_edges;
+};
+
+struct GridHPACluster
+{
+	IntVec2 m_mins;
+	IntVec2 m_maxs; // Exclusive
+	std::vector<int> m_nodes;
+	bool m_isDirty = false;
+};
+
+// HPA*. The grid is cut into square clusters, every opening along a cluster border gets a pair of abstract nodes, and the walks between
+// nodes of the same cluster are searched once and cached as edges. A query searches the small abstract graph and only walks tiles
+// inside one cluster at a time when a segment is refined. Editing a tile rebuilds just its cluster and the borders it shares
+class GridHierarchicalPathfinder : public IGridPathfinder
+{
+public:
+	GridHierarchicalPathfinder() = default;
+	GridHierarchicalPathfinder(GridWalkabilityGrid const* walkabilityGrid, int clusterSize = HPA_DEFAULT_CLUSTER_SIZE);
+	~GridHierarchicalPathfinder() override = default;
+
+	void Build(GridWalkabilityGrid const* walkabilityGrid, int clusterSize = HPA_DEFAULT_CLUSTER_SIZE);
+	void OnTileChanged(IntVec2 tile) override; // Call after changing the walkability grid, the cluster is rebuilt on the next query
+	void RebuildDirtyClusters();
+
+	// Path is goal first and leaves out the start, same as GridAStar::ComputeAStar. Every segment is refined here
+	void ComputePath(IntVec2 start, IntVec2 goal, std::vector<IntVec2>& outPath) override;
+	void SetHeuristic(std::function<int(IntVec2, IntVec2)> heuristic) override { m_heuristic = heuristic; }
+
+	// For lazy refinement. Waypoints run start to goal, and any two in a row are either in the same cluster or one step apart.
+	// RefineSegment then gives the tiles from one waypoint to the next in walking order, leaving out from and including to
+	bool ComputeAbstractPath(IntVec2 start, IntVec2 goal, std::vector<IntVec2>& outWaypoints);
+	bool RefineSegment(IntVec2 from, IntVec2 to, std::vector<IntVec2>& outTiles);
+
+	int GetNumClusters() const { return static_cast<int>(m_clusters.size()); }
+	int GetNumAbstractNodes() const { return static_cast<int>(m_nodes.size() - m_freeNodes.size()); }
+	int GetNumNodesExpanded() const override { return m_numNodesExpanded; } // Abstract nodes plus refinement tiles for the last ComputePath
+
+private:
+	int GetClusterIndex(IntVec2 const& tile) const;
+	int FindOrCreateNode(IntVec2 const& tile);
+	void RemoveNode(int nodeIndex);
+	void AddEdge(int fromNode, int toNode, float cost, bool isInterCluster);
+	void RemoveEdgesTo(int fromNode, int toNode);
+
+	void BuildBorderEntrances(int clusterIndex, CardinalDir direction);
+	void BuildIntraClusterEdges(int clusterIndex);
+	void ConnectNodeWithinCluster(int nodeIndex); // Edges from one node to every node of its cluster it can reach
+	void RebuildCluster(int clusterIndex);
+
+	// Dijkstra limited to one cluster. With a target it stops as soon as the target is settled
+	bool SearchWithinCluster(int clusterIndex, IntVec2 const& source, IntVec2 const* target);
+	int GetLocalIndex(GridHPACluster const& cluster, IntVec2 const& tile) const { return (tile.y - cluster.m_mins.y) * m_clusterSize + (tile.x - cluster.m_mins.x); }
+	bool SearchAbstractGraph(int startNode, int goalNode, std::vector<IntVec2>& outWaypoints);
+	float GetHeuristic(IntVec2 const& from, IntVec2 const& goal) const;
+
+private:
+	GridWalkabilityGrid const* m_walkabilityGrid = nullptr; // Not owned
+	int m_clusterSize = HPA_DEFAULT_CLUSTER_SIZE;
+	IntVec2 m_numClusters = IntVec2(0, 0);
+
+	std::vector<GridHPACluster> m_clusters;
+	std::vector<GridHPANode> m_nodes;
+	std::vector<int> m_freeNodes;
+	std::unordered_map<int, int> m_nodeIndexByTile; // Tile index to node, only border tiles and query endpoints have one
+	std::vector<int> m_dirtyClusters;
+	std::function<int(IntVec2, IntVec2)> m_heuristic = nullptr; // Octile distance when unset
+
+	// Scratch for the cluster Dijkstra, one cluster worth of tiles
+	std::vector<float> m_localCosts;
+	std::vector<int> m_localParents;
+	std::vector<int> m_localSearchGen;
+	std::vector<std::pair<float, int>> m_localOpenList;
+	int m_localGen = 0;
+
+	// Scratch for the abstract search, one entry per node slot
+	std::vector<float> m_abstractCosts;
+	std::vector<int> m_abstractParents;
+	std::vector<int> m_abstractSearchGen;
+	std::vector<int> m_abstractClosedGen;
+	std::vector<std::pair<float, int>> m_abstractOpenList;
+	int m_abstractGen = 0;
+
+	std::vector<IntVec2> m_waypoints;
+	std::vector<IntVec2> m_segmentTiles;
+	int m_numNodesExpanded = 0;
+};
@@ -0,0 +1,363 @@
+#include "Engine/AI/Pathfinding/Grid/GridJumpPointSearch.hpp"
+#include "Engine/AI/Pathfinding/Grid/GridBenchmarkMaps.hpp"
+#include "Engine/Core/Time.hpp"
+#include "Engine/Core/EngineCommon.hpp"
+#include "Engine/Core/DevConsole.hpp"
+#include "Engine/Math/RandomNumberGenerator.hpp"
+#include <cmath>
+
+static int GetSign(int value)
+{
+	return (value > 0) - (value < 0);
+}
+
+GridJumpPointSearch::GridJumpPointSearch(GridWalkabilityGrid const* walkabilityGrid)
+{
+	SetWalkabilityGrid(walkabilityGrid);
+}
+
+void GridJumpPointSearch::SetWalkabilityGrid(GridWalkabilityGrid const* walkabilityGrid)
+{
+	m_walkabilityGrid = walkabilityGrid;
+	m_nodeGridSize = 0;
+	if (m_walkabilityGrid)
+	{
+		IntVec2 dimensions = m_walkabilityGrid->GetDimensions();
+		m_nodeGridSize = (dimensions.x > dimensions.y) ? dimensions.x : dimensions.y;
+	}
+	m_scratch.Initialize(m_nodeGridSize);
+}
+
+void GridJumpPointSearch::ComputePath(IntVec2 start, IntVec2 goal, std::vector<IntVec2>& outPath)
+{
+	ComputePath(start, goal, outPath, m_scratch);
+}
+
+void GridJumpPointSearch::ComputePath(IntVec2 start, IntVec2 goal, std::vector<IntVec2>& outPath, GridAStar::SearchScratch& scratch) const
+{
+	outPath.clear();
+	if (!m_walkabilityGrid) return;
+	if (!m_walkabilityGrid->IsInBounds(start) || !m_walkabilityGrid->IsInBounds(goal)) return;
+	if (!IsWalkable(start.x, start.y) || !IsWalkable(goal.x, goal.y)) return;
+
+	if (scratch.m_numNodes != m_nodeGridSize * m_nodeGridSize)
+	{
+		scratch.Initialize(m_nodeGridSize);
+	}
+
+	scratch.m_pathGen++;
+	scratch.m_numNodesExpanded = 0;
+	float* gCosts = scratch.m_gCosts.data();
+	int* parents = scratch.m_parents.data();
+	GridAStar::OpenList& openList = scratch.m_openList;
+	openList.Clear();
+
+	int startIndex = (start.y * m_nodeGridSize) + start.x;
+	gCosts[startIndex] = 0.f;
+	parents[startIndex] = GRID_ASTAR_NO_PARENT;
+	scratch.SetOpen(startIndex);
+	openList.Push(startIndex, GetHeuristic(start, goal));
+
+	IntVec2 directions[NUM_INTERCARDINAL_DIRECTIONS];
+	while (!openList.Empty())
+	{
+		int currentIndex = openList.Pop();
+
+		if (scratch.IsClosed(currentIndex)) continue;
+		scratch.SetClosed(currentIndex);
+		scratch.m_numNodesExpanded++;
+
+		IntVec2 position(currentIndex % m_nodeGridSize, currentIndex / m_nodeGridSize);
+		if (position == goal)
+		{
+			// Fill in every tile between consecutive jump points, those runs are always straight or 45 degrees
+			for (int pathIndex = currentIndex; pathIndex != startIndex; pathIndex = parents[pathIndex])
+			{
+				IntVec2 tile(pathIndex % m_nodeGridSize, pathIndex / m_nodeGridSize);
+				IntVec2 parent(parents[pathIndex] % m_nodeGridSize, parents[pathIndex] / m_nodeGridSize);
+				IntVec2 step(GetSign(parent.x - tile.x), GetSign(parent.y - tile.y));
+				while (tile != parent)
+				{
+					outPath.emplace_back(tile);
+					tile += step;
+				}
+			}
+			openList.Clear();
+			return;
+		}
+
+		IntVec2 parent = (currentIndex == startIndex) ? start : IntVec2(parents[currentIndex] % m_nodeGridSize, parents[currentIndex] / m_nodeGridSize);
+		int numDirections = GetSearchDirections(position, parent, start, directions);
+		for (int directionIndex = 0; directionIndex < numDirections; directionIndex++)
+		{
+			IntVec2 const& direction = directions[directionIndex];
+
+			IntVec2 jumpPoint;
+			bool isDiagonal = (direction.x != 0 && direction.y != 0);
+			bool hasJumpPoint = isDiagonal ? JumpDiagonal(position.x, position.y, direction.x, direction.y, goal, jumpPoint) : JumpStraight(position.x, position.y, direction.x, direction.y, goal, jumpPoint);
+			if (!hasJumpPoint) continue;
+
+			int jumpIndex = (jumpPoint.y * m_nodeGridSize) + jumpPoint.x;
+			if (scratch.IsClosed(jumpIndex)) continue;
+
+			float totalgCost = gCosts[currentIndex] + GetOctileDistance(position, jumpPoint);
+			bool isOpenThisSearch = scratch.IsOpen(jumpIndex);
+			if (!isOpenThisSearch || totalgCost < gCosts[jumpIndex])
+			{
+				gCosts[jumpIndex] = totalgCost;
+				parents[jumpIndex] = currentIndex;
+				float fCost = totalgCost + GetHeuristic(jumpPoint, goal);
+
+				if (!isOpenThisSearch)
+				{
+					scratch.SetOpen(jumpIndex);
+					openList.Push(jumpIndex, fCost);
+				}
+				else
+				{
+					openList.DecreaseKey(jumpIndex, fCost);
+				}
+			}
+		}
+	}
+}
+
+bool GridJumpPointSearch::JumpStraight(int fromX, int fromY, int stepX, int stepY, IntVec2 const& goal, IntVec2& outJumpPoint) const
+{
+	int x = fromX + stepX;
+	int y = fromY + stepY;
+	while (IsWalkable(x, y))
+	{
+		bool isJumpPoint = (x == goal.x && y == goal.y);
+
+		// A forced neighbor is a side tile that only opened up because the tile behind it was solid
+		if (!isJumpPoint && stepX != 0)
+		{
+			isJumpPoint = (IsWalkable(x, y - 1) && !IsWalkable(x - stepX, y - 1)) || (IsWalkable(x, y + 1) && !IsWalkable(x - stepX, y + 1));
+		}
+		else if (!isJumpPoint)
+		{
+			isJumpPoint = (IsWalkable(x - 1, y) && !IsWalkable(x - 1, y - stepY)) || (IsWalkable(x + 1, y) && !IsWalkable(x + 1, y - stepY));
+		}
+
+		if (isJumpPoint)
+		{
+			outJumpPoint = IntVec2(x, y);
+			return true;
+		}
+
+		x += stepX;
+		y += stepY;
+	}
+	return false;
+}
+
+bool GridJumpPointSearch::JumpDiagonal(int fromX, int fromY, int stepX, int stepY, IntVec2 const& goal, IntVec2& outJumpPoint) const
+{
+	int x = fromX + stepX;
+	int y = fromY + stepY;
+	IntVec2 straightJumpPoint;
+	while (IsWalkable(x, y))
+	{
+		// Stop on any tile whose straight runs find something, the straight jumps get redone when this tile is expanded
+		if ((x == goal.x && y == goal.y) || JumpStraight(x, y, stepX, 0, goal, straightJumpPoint) || JumpStraight(x, y, 0, stepY, goal, straightJumpPoint))
+		{
+			outJumpPoint = IntVec2(x, y);
+			return true;
+		}
+
+		if (!IsWalkable(x + stepX, y) || !IsWalkable(x, y + stepY)) return false; // Next diagonal step would cut a corner
+		x += stepX;
+		y += stepY;
+	}
+	return false;
+}
+
+int GridJumpPointSearch::GetSearchDirections(IntVec2 const& position, IntVec2 const& parent, IntVec2 const& start, IntVec2* outDirections) const
+{
+	int x = position.x;
+	int y = position.y;
+	int numDirections = 0;
+
+	if (position == start)
+	{
+		for (int direction = 0; direction < NUM_INTERCARDINAL_DIRECTIONS; direction++)
+		{
+			IntVec2 step = GetStepInCardinalAndIntercardinalDirection(IntercardinalDir(direction));
+			if (!IsWalkable(x + step.x, y + step.y)) continue;
+			if (step.x != 0 && step.y != 0 && (!IsWalkable(x + step.x, y) || !IsWalkable(x, y + step.y))) continue;
+			outDirections[numDirections++] = step;
+		}
+		return numDirections;
+	}
+
+	// Everything else was already covered by the parent, so only keep the natural and forced directions
+	int stepX = GetSign(x - parent.x);
+	int stepY = GetSign(y - parent.y);
+	if (stepX != 0 && stepY != 0)
+	{
+		bool isVerticalOpen = IsWalkable(x, y + stepY);
+		bool isHorizontalOpen = IsWalkable(x + stepX, y);
+		if (isVerticalOpen) outDirections[numDirections++] = IntVec2(0, stepY);
+		if (isHorizontalOpen) outDirections[numDirections++] = IntVec2(stepX, 0);
+		if (isVerticalOpen && isHorizontalOpen && IsWalkable(x + stepX, y + stepY)) outDirections[numDirections++] = IntVec2(stepX, stepY);
+	}
+	else if (stepX != 0)
+	{
+		bool isNextOpen = IsWalkable(x + stepX, y);
+		bool isUpOpen = IsWalkable(x, y + 1);
+		bool isDownOpen = IsWalkable(x, y - 1);
+		if (isNextOpen)
+		{
+			outDirections[numDirections++] = IntVec2(stepX, 0);
+			if (isUpOpen && IsWalkable(x + stepX, y + 1)) outDirections[numDirections++] = IntVec2(stepX, 1);
+			if (isDownOpen && IsWalkable(x + stepX, y - 1)) outDirections[numDirections++] = IntVec2(stepX, -1);
+		}
+		if (isUpOpen) outDirections[numDirections++] = IntVec2(0, 1);
+		if (isDownOpen) outDirections[numDirections++] = IntVec2(0, -1);
+	}
+	else
+	{
+		bool isNextOpen = IsWalkable(x, y + stepY);
+		bool isRightOpen = IsWalkable(x + 1, y);
+		bool isLeftOpen = IsWalkable(x - 1, y);
+		if (isNextOpen)
+		{
+			outDirections[numDirections++] = IntVec2(0, stepY);
+			if (isRightOpen && IsWalkable(x + 1, y + stepY)) outDirections[numDirections++] = IntVec2(1, stepY);
+			if (isLeftOpen && IsWalkable(x - 1, y + stepY)) outDirections[numDirections++] = IntVec2(-1, stepY);
+		}
+		if (isRightOpen) outDirections[numDirections++] = IntVec2(1, 0);
+		if (isLeftOpen) outDirections[numDirections++] = IntVec2(-1, 0);
+	}
+	return numDirections;
+}
+
+float GridJumpPointSearch::GetHeuristic(IntVec2 const& from, IntVec2 const& goal) const
+{
+	if (m_heuristic) return static_cast<float>(m_heuristic(from, goal));
+	return GetOctileDistance(from, goal);
+}
+
+static float GetOctilePathCost(IntVec2 const& start, std::vector<IntVec2> const& path)
+{
+	float cost = 0.f;
+	IntVec2 previous = start;
+	for (int index = static_cast<int>(path.size()) - 1; index >= 0; index--)
+	{
+		cost += GetOctileDistance(previous, path[index]);
+		previous = path[index];
+	}
+	return cost;
+}
+
+GridPathfinderBenchmarkResult GridJumpPointSearch::RunBenchmark(GridWalkabilityGrid const& walkabilityGrid, int numQueries, unsigned int seed)
+{
+	IntVec2 dimensions = walkabilityGrid.GetDimensions();
+	int gridSize = (dimensions.x > dimensions.y) ? dimensions.x : dimensions.y;
+
+	// Octile costs make the A* baseline optimal, so both searches should agree on every path cost
+	GridAStar aStar(IntVec2(gridSize, gridSize));
+	aStar.SetDirectionMode(DirectionMode::Cardinal8);
+	aStar.SetCostMetric(GridAStarCostMetric::Octile);
+	aStar.SetWalkabilityGrid(&walkabilityGrid);
+	aStar.m_maxSearchDistance = gridSize * 2;
+
+	GridJumpPointSearch jumpPointSearch(&walkabilityGrid);
+
+	// Pick every query up front so both searches get the same ones and rolling isn't timed
+	RandomNumberGenerator rng(seed);
+	std::vector<IntVec2> queryPoints;
+	queryPoints.reserve(numQueries * 2);
+	for (int attempt = 0; static_cast<int>(queryPoints.size()) < numQueries * 2 && attempt < numQueries * 200; attempt++)
+	{
+		IntVec2 point(rng.SRollRandomIntInRange(0, dimensions.x - 1), rng.SRollRandomIntInRange(0, dimensions.y - 1));
+		if (!walkabilityGrid.IsSolid(point))
+		{
+			queryPoints.emplace_back(point);
+		}
+	}
+
+	GridPathfinderBenchmarkResult result;
+	result.m_numQueries = static_cast<int>(queryPoints.size()) / 2;
+
+	std::vector<IntVec2> aStarPath;
+	std::vector<IntVec2> jumpPointPath;
+	for (int query = 0; query < result.m_numQueries; query++)
+	{
+		IntVec2 start = queryPoints[query * 2];
+		IntVec2 goal = queryPoints[query * 2 + 1];
+
+		double timeBefore = GetCurrentTimeSeconds();
+		aStar.ComputeAStar(start, goal, aStarPath);
+		double timeMiddle = GetCurrentTimeSeconds();
+		jumpPointSearch.ComputePath(start, goal, jumpPointPath);
+		double timeAfter = GetCurrentTimeSeconds();
+
+		result.m_aStarMs += 1000.0 * (timeMiddle - timeBefore);
+		result.m_jumpPointMs += 1000.0 * (timeAfter - timeMiddle);
+		result.m_aStarNodesExpanded += aStar.m_scratch.m_numNodesExpanded;
+		result.m_jumpPointNodesExpanded += jumpPointSearch.GetNumNodesExpanded();
+		float aStarPathCost = GetOctilePathCost(start, aStarPath);
+		float jumpPointPathCost = GetOctilePathCost(start, jumpPointPath);
+		result.m_aStarPathCost += aStarPathCost;
+		result.m_jumpPointPathCost += jumpPointPathCost;
+
+		bool isAStarPathFound = (start == goal) || (!aStarPath.empty() && aStarPath.front() == goal);
+		bool isJumpPointPathFound = (start == goal) || (!jumpPointPath.empty() && jumpPointPath.front() == goal);
+		if (isAStarPathFound && !isJumpPointPathFound)
+		{
+			result.m_numPathsMissed++;
+		}
+		else if (isAStarPathFound && fabsf(aStarPathCost - jumpPointPathCost) > 0.001f * aStarPathCost + 0.001f) // Float sums taken in a different order
+		{
+			result.m_numPathCostMismatches++;
+		}
+	}
+	return result;
+}
+
+void GridJumpPointSearch::SubscribeConsoleCommands()
+{
+	if (g_theEventSystem)
+	{
+		g_theEventSystem->SubscribeEventCallbackFunction("GridJumpPointBenchmark", Command_GridJumpPointBenchmark);
+	}
+}
+
+void GridJumpPointSearch::UnsubscribeConsoleCommands()
+{
+	if (g_theEventSystem)
+	{
+		g_theEventSystem->UnsubscribeEventCallbackFunction("GridJumpPointBenchmark", Command_GridJumpPointBenchmark);
+	}
+}
+
+bool GridJumpPointSearch::Command_GridJumpPointBenchmark(EventArgs& args)
+{
+	int mapSize = std::stoi(args.GetValue<std::string>("size", "512"));
+	int numQueries = std::stoi(args.GetValue<std::string>("queries", "100"));
+	unsigned int seed = static_cast<unsigned int>(std::stoi(args.GetValue<std::string>("seed", "1")));
+
+	GridWalkabilityGrid walkabilityGrid;
+	for (int mapIndex = 0; mapIndex < 2; mapIndex++)
+	{
+		bool isMaze = (mapIndex == 1);
+		if (isMaze)
+		{
+			BuildMazeGridBenchmarkMap(walkabilityGrid, IntVec2(mapSize, mapSize), seed);
+		}
+		else
+		{
+			BuildOpenGridBenchmarkMap(walkabilityGrid, IntVec2(mapSize, mapSize), 0.05f, seed);
+		}
+
+		GridPathfinderBenchmarkResult result = RunBenchmark(walkabilityGrid, numQueries, seed);
+		char const* mapName = isMaze ? "Maze" : "Open";
+		g_theConsole->AddLine(Rgba8::LIGHT_ORANGE, Stringf("%s %ix%i, %i queries", mapName, mapSize, mapSize, result.m_numQueries));
+		g_theConsole->AddLine(Rgba8::LIGHT_ORANGE, Stringf("  A*:  %.02f ms, %lld nodes expanded, path cost %.01f", result.m_aStarMs, result.m_aStarNodesExpanded, result.m_aStarPathCost));
+		g_theConsole->AddLine(Rgba8::LIGHT_ORANGE, Stringf("  JPS: %.02f ms, %lld nodes expanded, path cost %.01f, %i paths missed, %i path costs differ", result.m_jumpPointMs, result.m_jumpPointNodesExpanded,
+			result.m_jumpPointPathCost, result.m_numPathsMissed, result.m_numPathCostMismatches));
+	}
+	return true;
+}
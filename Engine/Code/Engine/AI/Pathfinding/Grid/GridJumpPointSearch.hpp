@@ -0,0 +1,56 @@
+#pragma once
+#include "Engine/AI/Pathfinding/Grid/GridPathfindingManager.hpp"
+#include "Engine/AI/Pathfinding/Grid/GridAStar.hpp"
+#include "Engine/AI/Pathfinding/Grid/GridWalkabilityGrid.hpp"
+#include "Engine/Core/EventSystem.hpp"
+
+struct GridPathfinderBenchmarkResult
+{
+	int m_numQueries = 0;
+	double m_aStarMs = 0.0;
+	double m_jumpPointMs = 0.0;
+	long long m_aStarNodesExpanded = 0;
+	long long m_jumpPointNodesExpanded = 0;
+	double m_aStarPathCost = 0.0; // Octile cost summed over every query
+	double m_jumpPointPathCost = 0.0;
+	int m_numPathsMissed = 0; // Queries A* solved and jump point search didn't, should always be zero
+	int m_numPathCostMismatches = 0; // Queries both solved with different path costs, should always be zero since both are optimal
+};
+
+// Jump Point Search over a uniform cost 8 way grid. Straight steps cost 1, diagonal steps cost sqrt(2), and diagonals may never cut a solid corner.
+// Only jump points go on the open list, the straight and diagonal runs between them are scanned directly from the walkability bits
+class GridJumpPointSearch : public IGridPathfinder
+{
+public:
+	GridJumpPointSearch() = default;
+	explicit GridJumpPointSearch(GridWalkabilityGrid const* walkabilityGrid);
+	~GridJumpPointSearch() override = default;
+
+	void SetWalkabilityGrid(GridWalkabilityGrid const* walkabilityGrid);
+
+	// Path is goal first and leaves out the start, same as GridAStar::ComputeAStar. Empty when the goal can't be reached
+	void ComputePath(IntVec2 start, IntVec2 goal, std::vector<IntVec2>& outPath) override;
+	void ComputePath(IntVec2 start, IntVec2 goal, std::vector<IntVec2>& outPath, GridAStar::SearchScratch& scratch) const;
+	void SetHeuristic(std::function<int(IntVec2, IntVec2)> heuristic) override { m_heuristic = heuristic; }
+
+	int GetNumNodesExpanded() const override { return m_scratch.m_numNodesExpanded; }
+
+	// Times GridAStar (8 way, no distance limit) against jump point search on the same random queries
+	static GridPathfinderBenchmarkResult RunBenchmark(GridWalkabilityGrid const& walkabilityGrid, int numQueries, unsigned int seed);
+	static void SubscribeConsoleCommands(); // Once at startup, after the event system exists
+	static void UnsubscribeConsoleCommands();
+	static bool Command_GridJumpPointBenchmark(EventArgs& args);
+
+private:
+	inline bool IsWalkable(int x, int y) const { return !m_walkabilityGrid->IsSolid(x, y); }
+	bool JumpStraight(int fromX, int fromY, int stepX, int stepY, IntVec2 const& goal, IntVec2& outJumpPoint) const;
+	bool JumpDiagonal(int fromX, int fromY, int stepX, int stepY, IntVec2 const& goal, IntVec2& outJumpPoint) const;
+	int GetSearchDirections(IntVec2 const& position, IntVec2 const& parent, IntVec2 const& start, IntVec2* outDirections) const;
+	float GetHeuristic(IntVec2 const& from, IntVec2 const& goal) const;
+
+private:
+	GridWalkabilityGrid const* m_walkabilityGrid = nullptr; // Not owned
+	int m_nodeGridSize = 0; // Scratch node grids are square, big enough for either dimension
+	GridAStar::SearchScratch m_scratch;
+	std::function<int(IntVec2, IntVec2)> m_heuristic = nullptr; // Octile distance when unset
+};
@@ -0,0 +1,167 @@
+#include "Engine/AI/Pathfinding/Grid/GridPathRequestService.hpp"
+#include "Engine/Core/EngineCommon.hpp"
+#include "Engine/Core/DevConsole.hpp"
+#include "Engine/Core/JobSystem.hpp"
+#include "Engine/Core/Time.hpp"
+
+GridPathRequestService::GridPathRequestService(GridAStar const* pathfinder, JobSystem* jobSystem)
+	: m_pathfinder(pathfinder), m_jobSystem(jobSystem)
+{
+	// Workers plus the calling thread, which ParallelFor also puts to work
+	int numSlices = m_jobSystem ? m_jobSystem->GetNumWorkers() + 1 : 1;
+	m_scratches.resize(numSlices);
+}
+
+int GridPathRequestService::EnqueueRequest(IntVec2 start, IntVec2 goal)
+{
+	std::lock_guard<std::mutex> lock(m_pendingMutex);
+
+	GridPathRequest request;
+	request.m_requestID = m_nextRequestID++;
+	request.m_start = start;
+	request.m_goal = goal;
+	m_pendingRequests.emplace_back(request);
+	return request.m_requestID;
+}
+
+void GridPathRequestService::ProcessRequests(int maxRequests)
+{
+	m_batchRequests.clear();
+	{
+		std::lock_guard<std::mutex> lock(m_pendingMutex);
+		int numPending = static_cast<int>(m_pendingRequests.size());
+		int numToTake = (maxRequests < 0 || maxRequests > numPending) ? numPending : maxRequests;
+		m_batchRequests.assign(m_pendingRequests.begin(), m_pendingRequests.begin() + numToTake);
+		m_pendingRequests.erase(m_pendingRequests.begin(), m_pendingRequests.begin() + numToTake);
+	}
+
+	int numRequests = static_cast<int>(m_batchRequests.size());
+	m_lastBatchSize = numRequests;
+	if (numRequests == 0 || !m_pathfinder)
+	{
+		m_lastBatchMilliseconds = 0.0;
+		return;
+	}
+
+	double timeBefore = GetCurrentTimeSeconds();
+
+	int firstResult = static_cast<int>(m_results.size());
+	m_results.resize(firstResult + numRequests);
+
+	// Requests are dealt out to slices round robin so a cluster of long searches doesn't all land on one slice
+	int numSlices = static_cast<int>(m_scratches.size());
+	if (numSlices > numRequests) numSlices = numRequests;
+
+	auto solveSlice = [this, firstResult, numRequests, numSlices](int slice)
+	{
+		GridAStar::SearchScratch& scratch = m_scratches[slice];
+		for (int requestIndex = slice; requestIndex < numRequests; requestIndex += numSlices)
+		{
+			GridPathRequest const& request = m_batchRequests[requestIndex];
+			GridPathResult& result = m_results[firstResult + requestIndex];
+			result.m_requestID = request.m_requestID;
+			result.m_start = request.m_start;
+			result.m_goal = request.m_goal;
+
+			m_pathfinder->ComputeAStar(request.m_start, request.m_goal, result.m_path, scratch);
+			// A capped or blocked search still hands back a partial path, only one that ends on the goal counts
+			result.m_isPathFound = (request.m_start == request.m_goal) || (!result.m_path.empty() && result.m_path.front() == request.m_goal);
+		}
+	};
+
+	ParallelForIfAvailable(m_jobSystem, 0, numSlices, 1, solveSlice, JobType::AI);
+
+	double timeAfter = GetCurrentTimeSeconds();
+	m_lastBatchMilliseconds = 1000.0 * (timeAfter - timeBefore);
+}
+
+void GridPathRequestService::RetrieveResults(std::vector<GridPathResult>& outResults)
+{
+	for (GridPathResult& result : m_results)
+	{
+		outResults.emplace_back(std::move(result));
+	}
+	m_results.clear();
+}
+
+int GridPathRequestService::GetNumPendingRequests() const
+{
+	std::lock_guard<std::mutex> lock(m_pendingMutex);
+	return static_cast<int>(m_pendingRequests.size());
+}
+
+void GridPathRequestService::SubscribeConsoleCommands()
+{
+	if (g_theEventSystem)
+	{
+		g_theEventSystem->SubscribeEventCallbackFunction("GridPathRequestCheck", Command_GridPathRequestCheck);
+	}
+}
+
+void GridPathRequestService::UnsubscribeConsoleCommands()
+{
+	if (g_theEventSystem)
+	{
+		g_theEventSystem->UnsubscribeEventCallbackFunction("GridPathRequestCheck", Command_GridPathRequestCheck);
+	}
+}
+
+bool GridPathRequestService::Command_GridPathRequestCheck(EventArgs& args)
+{
+	UNUSED(args);
+
+	// Open map with the goal boxed in, searched with the default distance limit
+	int const mapSize = 128;
+	GridWalkabilityGrid walkabilityGrid;
+	walkabilityGrid.Initialize(IntVec2(mapSize, mapSize));
+	IntVec2 boxedGoal(20, 20);
+	for (int y = boxedGoal.y - 1; y <= boxedGoal.y + 1; y++)
+	{
+		for (int x = boxedGoal.x - 1; x <= boxedGoal.x + 1; x++)
+		{
+			if (x != boxedGoal.x || y != boxedGoal.y) walkabilityGrid.SetSolid(IntVec2(x, y), true);
+		}
+	}
+
+	GridAStar aStar(IntVec2(mapSize, mapSize));
+	aStar.SetDirectionMode(DirectionMode::Cardinal8);
+	aStar.SetWalkabilityGrid(&walkabilityGrid);
+
+	struct Check
+	{
+		char const* m_name;
+		IntVec2 m_start;
+		IntVec2 m_goal;
+		bool m_isPathExpected;
+	};
+	Check const checks[] =
+	{
+		{ "Reachable", IntVec2(5, 5), IntVec2(12, 9), true },
+		{ "Start is goal", IntVec2(5, 5), IntVec2(5, 5), true },
+		{ "Goal walled in", IntVec2(5, 5), boxedGoal, false },
+		{ "Goal past the distance limit", IntVec2(5, 5), IntVec2(mapSize - 5, mapSize - 5), false },
+	};
+	int const numChecks = static_cast<int>(sizeof(checks) / sizeof(checks[0]));
+
+	GridPathRequestService service(&aStar, g_theJobSystem);
+	for (Check const& check : checks)
+	{
+		service.EnqueueRequest(check.m_start, check.m_goal);
+	}
+	service.ProcessRequests();
+
+	std::vector<GridPathResult> results;
+	service.RetrieveResults(results);
+
+	int numFailed = 0;
+	for (int checkIndex = 0; checkIndex < numChecks; checkIndex++)
+	{
+		Check const& check = checks[checkIndex];
+		bool isPassed = (results[checkIndex].m_isPathFound == check.m_isPathExpected);
+		if (!isPassed) numFailed++;
+		g_theConsole->AddLine(isPassed ? Rgba8::LIGHT_ORANGE : Rgba8::RED, Stringf("%s: path %s, expected %s", check.m_name,
+			results[checkIndex].m_isPathFound ? "found" : "not found", check.m_isPathExpected ? "found" : "not found"));
+	}
+	g_theConsole->AddLine(numFailed == 0 ? Rgba8::LIGHT_ORANGE : Rgba8::RED, Stringf("%i of %i path request checks failed", numFailed, numChecks));
+	return true;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include "Engine/AI/Pathfinding/Grid/GridAStar.hpp"
+#include <mutex>
+
+class JobSystem;
+
+struct GridPathRequest
+{
+	int m_requestID = -1;
+	IntVec2 m_start;
+	IntVec2 m_goal;
+};
+
+struct GridPathResult
+{
+	int m_requestID = -1;
+	IntVec2 m_start;
+	IntVec2 m_goal;
+	bool m_isPathFound = false;
+	std::vector<IntVec2> m_path; // Goal first, same order as GridAStar::ComputeAStar
+};
+
+// Collects path requests from any thread and solves them in batches across the job system.
+// Every batch slice gets its own GridAStar::SearchScratch, the pathfinder itself (grid size and walkability callbacks) is only read
+class GridPathRequestService
+{
+public:
+	GridPathRequestService(GridAStar const* pathfinder, JobSystem* jobSystem);
+	~GridPathRequestService() = default;
+
+	int EnqueueRequest(IntVec2 start, IntVec2 goal); // Returns the ID its result will carry
+	void ProcessRequests(int maxRequests = -1); // Blocks until the batch is solved, negative solves everything pending
+	void RetrieveResults(std::vector<GridPathResult>& outResults); // Moves every finished result onto the end of outResults
+
+	int GetNumPendingRequests() const;
+	double GetLastBatchMilliseconds() const { return m_lastBatchMilliseconds; }
+	int GetLastBatchSize() const { return m_lastBatchSize; }
+
+	static void SubscribeConsoleCommands(); // Once at startup, after the event system exists
+	static void UnsubscribeConsoleCommands();
+	// Solves reachable, walled in and out of range requests on a small map and reports any m_isPathFound that comes back wrong
+	static bool Command_GridPathRequestCheck(EventArgs& args);
+
+private:
+	GridAStar const* m_pathfinder = nullptr;
+	JobSystem* m_jobSystem = nullptr;
+
+	mutable std::mutex m_pendingMutex;
+	std::vector<GridPathRequest> m_pendingRequests;
+	std::vector<GridPathRequest> m_batchRequests;
+	int m_nextRequestID = 0;
+
+	std::vector<GridPathResult> m_results;
+	std::vector<GridAStar::SearchScratch> m_scratches; // One per batch slice
+
+	double m_lastBatchMilliseconds = 0.0;
+	int m_lastBatchSize = 0;
+};
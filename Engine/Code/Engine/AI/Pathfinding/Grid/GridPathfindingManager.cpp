@@ -1,12 +1,248 @@
 #include "Engine/AI/Pathfinding/Grid/GridPathfindingManager.hpp"
+#include "Engine/AI/Pathfinding/Grid/GridAStar.hpp"
+#include "Engine/AI/Pathfinding/Grid/GridDStarLite.hpp"
+#include "Engine/AI/Pathfinding/Grid/GridJumpPointSearch.hpp"
+#include "Engine/AI/Pathfinding/Grid/GridHierarchicalPathfinder.hpp"
+#include "Engine/AI/Pathfinding/Grid/GridFlowField.hpp"
+#include "Engine/Core/EngineCommon.hpp"
+#include "Engine/Core/Time.hpp"
+
+GridPathfindingManager::~GridPathfindingManager()
+{
+	DeletePathfinders();
+}
+
+void GridPathfindingManager::SetWalkabilityGrid(GridWalkabilityGrid const* walkabilityGrid)
+{
+	DeletePathfinders();
+	m_resultCache.clear();
+	m_walkabilityGrid = walkabilityGrid;
+	if (!m_walkabilityGrid) return;
+
+	m_cachedGridVersion = m_walkabilityGrid->GetVersion();
+	IntVec2 dimensions = m_walkabilityGrid->GetDimensions();
+	int gridSize = (dimensions.x > dimensions.y) ? dimensions.x : dimensions.y;
+
+	// Every search gets the whole map, the default A* distance limit would hand back partial paths and skew the comparison.
+	// Both GridAStar types use octile costs like every other type here, so they are timed finding equally short paths
+	GridAStar* aStar = new GridAStar(IntVec2(gridSize, gridSize));
+	aStar->SetDirectionMode(DirectionMode::Cardinal8);
+	aStar->SetCostMetric(GridAStarCostMetric::Octile);
+	aStar->SetWalkabilityGrid(m_walkabilityGrid);
+	aStar->m_maxSearchDistance = dimensions.x + dimensions.y;
+	m_pathAlgorithms[GridPathType::AStar] = aStar;
+
+	GridAStar* dijkstra = new GridAStar(IntVec2(gridSize, gridSize));
+	dijkstra->SetDirectionMode(DirectionMode::Cardinal8);
+	dijkstra->SetCostMetric(GridAStarCostMetric::Octile);
+	dijkstra->SetWalkabilityGrid(m_walkabilityGrid);
+	dijkstra->m_maxSearchDistance = dimensions.x + dimensions.y;
+	dijkstra->SetHeuristic([](IntVec2, IntVec2) { return 0; });
+	m_pathAlgorithms[GridPathType::Dijkstra] = dijkstra;
+
+	GridDStarLite* dStarLite = new GridDStarLite(dimensions);
+	dStarLite->SetDirectionMode(DirectionMode::Cardinal8);
+	dStarLite->SetWalkabilityGrid(m_walkabilityGrid);
+	m_pathAlgorithms[GridPathType::DStarLite] = dStarLite;
+
+	m_pathAlgorithms[GridPathType::JumpPointSearch] = new GridJumpPointSearch(m_walkabilityGrid);
+	m_pathAlgorithms[GridPathType::Hierarchical] = new GridHierarchicalPathfinder(m_walkabilityGrid);
+
+	// The integration field is the distance field, so both types share one cache of fields
+	GridFlowFieldPathfinder* flowField = new GridFlowFieldPathfinder(m_walkabilityGrid, g_theJobSystem);
+	m_pathAlgorithms[GridPathType::FlowField] = flowField;
+	m_pathAlgorithms[GridPathType::DistanceField] = flowField;
+
+	if (m_heuristic)
+	{
+		SetHeuristic(m_heuristic);
+	}
+	m_current = GetPathfinder(m_currentPathType);
+}
 
 void GridPathfindingManager::SetPathType(GridPathType type)
 {
 	m_currentPathType = type;
+	m_current = GetPathfinder(type);
 }
 
 void GridPathfindingManager::SetHeuristic(std::function<int(IntVec2, IntVec2)> heuristic)
 {
 	m_heuristic = heuristic;
+	for (auto& typeAndPathfinder : m_pathAlgorithms)
+	{
+		if (typeAndPathfinder.first == GridPathType::Dijkstra) continue;
+		typeAndPathfinder.second->SetHeuristic(heuristic);
+	}
+	m_resultCache.clear();
+}
+
+void GridPathfindingManager::SetMaxCachedResults(int maxCachedResults)
+{
+	m_maxCachedResults = (maxCachedResults > 0) ? maxCachedResults : 0;
+	while (static_cast<int>(m_resultCache.size()) > m_maxCachedResults)
+	{
+		EvictLeastRecentResult();
+	}
+}
+
+void GridPathfindingManager::ComputePath(IntVec2 start, IntVec2 goal, std::vector<IntVec2>& outPath)
+{
+	ComputePath(m_currentPathType, start, goal, outPath);
+}
+
+void GridPathfindingManager::ComputePath(GridPathType type, IntVec2 start, IntVec2 goal, std::vector<IntVec2>& outPath)
+{
+	outPath.clear();
+	IGridPathfinder* pathfinder = GetPathfinder(type);
+	if (!pathfinder) return;
+	if (!m_walkabilityGrid->IsInBounds(start) || !m_walkabilityGrid->IsInBounds(goal)) return;
+
+	// The grid was edited without OnTileChanged, none of the cached paths can be trusted
+	if (m_walkabilityGrid->GetVersion() != m_cachedGridVersion)
+	{
+		m_resultCache.clear();
+		m_cachedGridVersion = m_walkabilityGrid->GetVersion();
+	}
+
+	m_tick++;
+	GridPathfinderStats& stats = m_stats[static_cast<int>(type)];
+	uint64_t cacheKey = GetCacheKey(type, start, goal);
+	auto found = m_resultCache.find(cacheKey);
+	if (found != m_resultCache.end())
+	{
+		outPath = found->second.m_path;
+		found->second.m_lastUsedTick = m_tick;
+		stats.m_numCacheHits++;
+		return;
+	}
+
+	double timeBefore = GetCurrentTimeSeconds();
+	pathfinder->ComputePath(start, goal, outPath);
+	double timeAfter = GetCurrentTimeSeconds();
+
+	stats.m_numQueries++;
+	stats.m_totalMilliseconds += 1000.0 * (timeAfter - timeBefore);
+	stats.m_totalNodesExpanded += pathfinder->GetNumNodesExpanded();
+	if (start == goal || (!outPath.empty() && outPath.front() == goal))
+	{
+		stats.m_numPathsFound++;
+	}
+
+	if (m_maxCachedResults <= 0) return;
+	if (static_cast<int>(m_resultCache.size()) >= m_maxCachedResults)
+	{
+		EvictLeastRecentResult();
+	}
+	CachedResult& result = m_resultCache[cacheKey];
+	result.m_path = outPath;
+	result.m_lastUsedTick = m_tick;
 }
 
+void GridPathfindingManager::OnTileChanged(IntVec2 tile)
+{
+	for (auto& typeAndPathfinder : m_pathAlgorithms)
+	{
+		if (typeAndPathfinder.first == GridPathType::DistanceField) continue; // Same instance as FlowField
+		typeAndPathfinder.second->OnTileChanged(tile);
+	}
+
+	m_resultCache.clear();
+	if (m_walkabilityGrid)
+	{
+		m_cachedGridVersion = m_walkabilityGrid->GetVersion();
+	}
+}
+
+IGridPathfinder* GridPathfindingManager::GetPathfinder(GridPathType type) const
+{
+	auto found = m_pathAlgorithms.find(type);
+	return (found != m_pathAlgorithms.end()) ? found->second : nullptr;
+}
+
+void GridPathfindingManager::ResetStats()
+{
+	for (GridPathfinderStats& stats : m_stats)
+	{
+		stats = GridPathfinderStats();
+	}
+}
+
+GridPathType GridPathfindingManager::GetFastestPathType() const
+{
+	// A type that gives up early looks fast, so only the ones that found as many paths as the best of them compete on time
+	double bestFoundFraction = 0.0;
+	for (GridPathfinderStats const& stats : m_stats)
+	{
+		if (stats.m_numQueries == 0) continue;
+		double foundFraction = static_cast<double>(stats.m_numPathsFound) / static_cast<double>(stats.m_numQueries);
+		if (foundFraction > bestFoundFraction) bestFoundFraction = foundFraction;
+	}
+
+	GridPathType fastestType = m_currentPathType;
+	double fastestMilliseconds = 0.0;
+	bool isAnyTypeRun = false;
+	for (int typeIndex = 0; typeIndex < static_cast<int>(GridPathType::NUM_GRID_PATH_TYPES); typeIndex++)
+	{
+		GridPathfinderStats const& stats = m_stats[typeIndex];
+		if (stats.m_numQueries == 0) continue;
+		if (static_cast<double>(stats.m_numPathsFound) / static_cast<double>(stats.m_numQueries) < bestFoundFraction) continue;
+
+		double averageMilliseconds = stats.GetAverageMilliseconds();
+		if (!isAnyTypeRun || averageMilliseconds < fastestMilliseconds)
+		{
+			fastestType = static_cast<GridPathType>(typeIndex);
+			fastestMilliseconds = averageMilliseconds;
+			isAnyTypeRun = true;
+		}
+	}
+	return fastestType;
+}
+
+char const* GridPathfindingManager::GetPathTypeName(GridPathType type)
+{
+	switch (type)
+	{
+	case GridPathType::Dijkstra:        return "Dijkstra";
+	case GridPathType::AStar:           return "AStar";
+	case GridPathType::DStarLite:       return "DStarLite";
+	case GridPathType::BFS:             return "BFS";
+	case GridPathType::FlowField:       return "FlowField";
+	case GridPathType::DistanceField:   return "DistanceField";
+	case GridPathType::JumpPointSearch: return "JumpPointSearch";
+	case GridPathType::Hierarchical:    return "Hierarchical";
+	default: return "Unknown";
+	}
+}
+
+uint64_t GridPathfindingManager::GetCacheKey(GridPathType type, IntVec2 const& start, IntVec2 const& goal) const
+{
+	// 28 bits per tile index covers grids up to 16k by 16k
+	int width = m_walkabilityGrid->GetDimensions().x;
+	uint64_t startIndex = static_cast<uint64_t>(start.y * width + start.x);
+	uint64_t goalIndex = static_cast<uint64_t>(goal.y * width + goal.x);
+	return (static_cast<uint64_t>(type) << 56) | (startIndex << 28) | goalIndex;
+}
+
+void GridPathfindingManager::EvictLeastRecentResult()
+{
+	if (m_resultCache.empty()) return;
+
+	auto leastRecent = m_resultCache.begin();
+	for (auto iter = m_resultCache.begin(); iter != m_resultCache.end(); ++iter)
+	{
+		if (iter->second.m_lastUsedTick < leastRecent->second.m_lastUsedTick) leastRecent = iter;
+	}
+	m_resultCache.erase(leastRecent);
+}
+
+void GridPathfindingManager::DeletePathfinders()
+{
+	for (auto& typeAndPathfinder : m_pathAlgorithms)
+	{
+		if (typeAndPathfinder.first == GridPathType::DistanceField) continue; // Same instance as FlowField
+		delete typeAndPathfinder.second;
+	}
+	m_pathAlgorithms.clear();
+	m_current = nullptr;
+}
@@ -1,5 +1,10 @@
 #pragma once
 #include "Engine/AI/Pathfinding/Grid/GridCommon.hpp"
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+
+class GridWalkabilityGrid;
 
 enum class GridPathType
 {
@@ -8,7 +13,10 @@ enum class GridPathType
 	DStarLite,
 	BFS,
 	FlowField,
-	DistanceField
+	DistanceField,
+	JumpPointSearch,
+	Hierarchical,
+	NUM_GRID_PATH_TYPES
 };
 
 class IGridPathfinder
@@ -16,24 +24,75 @@ class IGridPathfinder
 public:
 	virtual void ComputePath(IntVec2 start, IntVec2 goal, std::vector<IntVec2>& outPath) = 0;
 	virtual void SetHeuristic(std::function<int(IntVec2, IntVec2)> heuristic) {}
+	virtual void OnTileChanged(IntVec2 tile) {} // Called after the walkability grid changes, for pathfinders that keep data between queries
+	virtual int GetNumNodesExpanded() const { return 0; } // For the last ComputePath
 	virtual ~IGridPathfinder() = default;
 };
 
+struct GridPathfinderStats
+{
+	int m_numQueries = 0; // Actually searched, cache hits are counted apart
+	int m_numCacheHits = 0;
+	int m_numPathsFound = 0;
+	double m_totalMilliseconds = 0.0;
+	long long m_totalNodesExpanded = 0;
+
+	double GetAverageMilliseconds() const { return (m_numQueries > 0) ? m_totalMilliseconds / static_cast<double>(m_numQueries) : 0.0; }
+	double GetAverageNodesExpanded() const { return (m_numQueries > 0) ? static_cast<double>(m_totalNodesExpanded) / static_cast<double>(m_numQueries) : 0.0; }
+};
+
+constexpr int GRID_PATH_DEFAULT_MAX_CACHED_RESULTS = 256;
+
+// Owns one pathfinder per GridPathType over a shared walkability grid and routes queries to them. Recent results are cached per
+// (type, start, goal) until the map changes, and every type keeps timing and nodes expanded so the fastest one for a map can be picked at runtime.
+// Every path comes back goal first and leaves out the start, same as GridAStar::ComputeAStar
 class GridPathfindingManager
 {
 public:
 	GridPathfindingManager() = default;
-	~GridPathfindingManager() = default;
+	~GridPathfindingManager();
 
+	void SetWalkabilityGrid(GridWalkabilityGrid const* walkabilityGrid); // Recreates every pathfinder for the new grid
 	void SetPathType(GridPathType type);
-	void SetHeuristic(std::function<int(IntVec2, IntVec2)> heuristic);
+	GridPathType GetPathType() const { return m_currentPathType; }
+	void SetHeuristic(std::function<int(IntVec2, IntVec2)> heuristic); // Dijkstra keeps its zero heuristic
+	void SetMaxCachedResults(int maxCachedResults);
+
+	void ComputePath(IntVec2 start, IntVec2 goal, std::vector<IntVec2>& outPath);
+	void ComputePath(GridPathType type, IntVec2 start, IntVec2 goal, std::vector<IntVec2>& outPath); // Empty when the type has no pathfinder
+	void OnTileChanged(IntVec2 tile); // Call once per changed tile, after changing the walkability grid
+	void ClearResultCache() { m_resultCache.clear(); }
 
-	//void ComputePath(IntVec2 start, IntVec2 goal, std::vector<IntVec2>& outPath);
+	IGridPathfinder* GetPathfinder(GridPathType type) const;
+	GridPathfinderStats const& GetStats(GridPathType type) const { return m_stats[static_cast<int>(type)]; }
+	void ResetStats();
+	GridPathType GetFastestPathType() const; // Lowest average time among the types that found the most paths, the current type when none have run
+
+	static char const* GetPathTypeName(GridPathType type);
+
+private:
+	struct CachedResult
+	{
+		std::vector<IntVec2> m_path;
+		unsigned int m_lastUsedTick = 0;
+	};
+
+	uint64_t GetCacheKey(GridPathType type, IntVec2 const& start, IntVec2 const& goal) const;
+	void EvictLeastRecentResult();
+	void DeletePathfinders();
 
 private:
 	GridPathType m_currentPathType = GridPathType::AStar;
 	IGridPathfinder* m_current = nullptr;
-	
-	std::unordered_map<GridPathType, IGridPathfinder*> m_pathAlgorithms;
+	GridWalkabilityGrid const* m_walkabilityGrid = nullptr; // Not owned
+
+	std::unordered_map<GridPathType, IGridPathfinder*> m_pathAlgorithms; // Owned, DistanceField shares the FlowField instance
 	std::function<int(IntVec2, IntVec2)> m_heuristic = nullptr;
+
+	std::unordered_map<uint64_t, CachedResult> m_resultCache;
+	int m_maxCachedResults = GRID_PATH_DEFAULT_MAX_CACHED_RESULTS;
+	unsigned int m_cachedGridVersion = 0;
+	unsigned int m_tick = 0;
+
+	GridPathfinderStats m_stats[static_cast<int>(GridPathType::NUM_GRID_PATH_TYPES)];
 };
@@ -0,0 +1,61 @@
+#include "Engine/AI/Pathfinding/Grid/GridWalkabilityGrid.hpp"
+
+GridWalkabilityGrid::GridWalkabilityGrid(IntVec2 dimensions)
+{
+	Initialize(dimensions);
+}
+
+void GridWalkabilityGrid::Initialize(IntVec2 dimensions)
+{
+	m_dimensions = dimensions;
+	m_paddedWidth = dimensions.x + 2;
+	int paddedHeight = dimensions.y + 2;
+	int numPaddedTiles = m_paddedWidth * paddedHeight;
+
+	m_bits.assign((numPaddedTiles + 63) / 64, 0);
+	for (int paddedX = 0; paddedX < m_paddedWidth; paddedX++)
+	{
+		SetPaddedBit(paddedX, true);
+		SetPaddedBit((paddedHeight - 1) * m_paddedWidth + paddedX, true);
+	}
+	for (int paddedY = 0; paddedY < paddedHeight; paddedY++)
+	{
+		SetPaddedBit(paddedY * m_paddedWidth, true);
+		SetPaddedBit(paddedY * m_paddedWidth + m_paddedWidth - 1, true);
+	}
+	m_version++;
+}
+
+void GridWalkabilityGrid::SetSolid(IntVec2 coords, bool isSolid)
+{
+	if (!IsInBounds(coords)) return;
+
+	int paddedIndex = (coords.y + 1) * m_paddedWidth + (coords.x + 1);
+	SetPaddedBit(paddedIndex, isSolid);
+	m_version++;
+}
+
+void GridWalkabilityGrid::SetFromIsSolidCallback(std::function<bool(IntVec2)> const& isSolidCallback)
+{
+	for (int y = 0; y < m_dimensions.y; y++)
+	{
+		for (int x = 0; x < m_dimensions.x; x++)
+		{
+			SetPaddedBit((y + 1) * m_paddedWidth + (x + 1), isSolidCallback(IntVec2(x, y)));
+		}
+	}
+	m_version++;
+}
+
+void GridWalkabilityGrid::SetPaddedBit(int paddedIndex, bool isSet)
+{
+	uint64_t mask = uint64_t(1) << (paddedIndex & 63);
+	if (isSet)
+	{
+		m_bits[paddedIndex >> 6] |= mask;
+	}
+	else
+	{
+		m_bits[paddedIndex >> 6] &= ~mask;
+	}
+}
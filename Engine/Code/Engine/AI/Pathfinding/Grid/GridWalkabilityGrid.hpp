@@ -0,0 +1,81 @@
+#pragma once
+#include "Engine/AI/Pathfinding/Grid/GridCommon.hpp"
+#include <vector>
+#include <cstdint>
+
+// One bit per tile, set when the tile is solid. The grid is stored with a one tile solid border,
+// so a pathfinder can look one step past any edge tile without a bounds check
+class GridWalkabilityGrid
+{
+public:
+	GridWalkabilityGrid() = default;
+	explicit GridWalkabilityGrid(IntVec2 dimensions);
+
+	void Initialize(IntVec2 dimensions); // Every tile starts walkable
+	void SetSolid(IntVec2 coords, bool isSolid); // Coords outside the grid are ignored
+	void SetFromIsSolidCallback(std::function<bool(IntVec2)> const& isSolidCallback); // One time bake of an existing callback
+
+	IntVec2 GetDimensions() const { return m_dimensions; }
+	unsigned int GetVersion() const { return m_version; } // Bumped by every change, so caches built on this grid can tell they are stale
+	bool IsInBounds(IntVec2 coords) const { return coords.x >= 0 && coords.x < m_dimensions.x && coords.y >= 0 && coords.y < m_dimensions.y; }
+
+	// Coords may be at most one tile outside the grid, those always read as solid
+	inline bool IsSolid(int x, int y) const
+	{
+		int paddedIndex = (y + 1) * m_paddedWidth + (x + 1);
+		return ((m_bits[paddedIndex >> 6] >> (paddedIndex & 63)) & 1u) != 0;
+	}
+	inline bool IsSolid(IntVec2 coords) const { return IsSolid(coords.x, coords.y); }
+
+	// A diagonal step also needs both tiles it squeezes between to be open when corner cutting is blocked
+	inline bool CanStep(int fromX, int fromY, int stepX, int stepY) const
+	{
+		if (IsSolid(fromX + stepX, fromY + stepY)) return false;
+		if (stepX != 0 && stepY != 0 && m_isCornerCuttingBlocked)
+		{
+			return !IsSolid(fromX + stepX, fromY) && !IsSolid(fromX, fromY + stepY);
+		}
+		return true;
+	}
+	inline bool CanStep(IntVec2 from, IntVec2 step) const { return CanStep(from.x, from.y, step.x, step.y); }
+
+	// Calls callback(direction, stepX, stepY) for every GridNeighborSteps<T_Mode> step out of (x, y) that CanStep allows. With T_IsStepInto
+	// it's every step from a neighbor inside the grid into (x, y) instead. The mode and callback are both compile time, so the whole loop inlines
+	template <DirectionMode T_Mode, bool T_IsStepInto = false, typename T_Callback>
+	inline void ForEachOpenStep(int x, int y, T_Callback const& callback) const
+	{
+		typedef GridNeighborSteps<T_Mode> Steps;
+		if (T_IsStepInto && IsSolid(x, y)) return;
+
+		for (int direction = 0; direction < Steps::NUM_STEPS; direction++)
+		{
+			int stepX = Steps::STEP_X[direction];
+			int stepY = Steps::STEP_Y[direction];
+			int neighborX = x + stepX;
+			int neighborY = y + stepY;
+			if (T_IsStepInto)
+			{
+				if (neighborX < 0 || neighborX >= m_dimensions.x || neighborY < 0 || neighborY >= m_dimensions.y) continue;
+			}
+			else if (IsSolid(neighborX, neighborY))
+			{
+				continue;
+			}
+
+			// Same two corner tiles whichever way the diagonal is walked
+			if (stepX != 0 && stepY != 0 && m_isCornerCuttingBlocked && (IsSolid(neighborX, y) || IsSolid(x, neighborY))) continue;
+			callback(direction, stepX, stepY);
+		}
+	}
+
+public:
+	bool m_isCornerCuttingBlocked = true;
+
+private:
+	void SetPaddedBit(int paddedIndex, bool isSet);
+
+	IntVec2 m_dimensions = IntVec2(0, 0);
+	int m_paddedWidth = 0;
+	std::vector<uint64_t> m_bits;
+	unsigned int m_version = 0;
+};
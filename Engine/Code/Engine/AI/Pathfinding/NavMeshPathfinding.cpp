@@ -1,12 +1,17 @@
 #include "Engine/AI/Pathfinding/NavMeshPathfinding.hpp"
 #include "Engine/Core/Time.hpp"
 #include "Engine/Core/DevConsole.hpp"
+#include "Engine/Core/EngineCommon.hpp"
+#include "Engine/Core/JobSystem.hpp"
 #include "Engine/Math/RaycastUtils.hpp"
 #include "Engine/Math/RandomNumberGenerator.hpp"
 #include "Engine/Renderer/DebugRenderer.hpp"
+#include <cfloat>
 
 extern RandomNumberGenerator g_rng;
 
+static NavMeshQueryFilter const s_defaultQueryFilter;
+
 NavMeshPathfinding::NavMeshPathfinding(NavMesh* navMesh)
 	: m_navMesh(navMesh)
 {
@@ -15,32 +20,106 @@ NavMeshPathfinding::NavMeshPathfinding(NavMesh* navMesh)
 
 void NavMeshPathfinding::InitializeNavMeshNodes(NavMesh const& navMesh)
 {
-	if (m_nodes.empty())
+	if (m_scratch.m_nodes.empty())
 	{
-		m_nodes.resize(navMesh.m_triangles.size());
+		m_scratch.Initialize(navMesh.GetNumTriangles());
+	}
+}
+
+void NavMeshPathfinding::SearchScratch::Initialize(int numTriangles)
+{
+	m_openList.Clear(); // Before the nodes it points at move
+	m_pathGen = 0;
+	m_nodes.resize(numTriangles);
+
+	for (int i = 0; i < numTriangles; i++)
+	{
+		m_nodes[i] = Node();
+		m_nodes[i].m_position = Vec3::INVALID_POSITION;
+		m_nodes[i].m_triangleIndex = i;
+		m_nodes[i].m_totalgCost = std::numeric_limits<float>::max();
+		m_nodes[i].m_fCost = std::numeric_limits<float>::max();
+		m_nodes[i].m_parentTriangleIndex = -1;
+		m_nodes[i].m_openPathGen = -1;
+		m_nodes[i].m_closedPathGen = -1;
+		m_nodes[i].m_heapIndex = -1;
+	}
+}
+
+void NavMeshPathfinding::ComputeAStar(Vec3 startPoint, Vec3 goalPoint, std::vector<Vec3>& outPath, float agentRadius /*= 0.f*/, NavMeshQueryFilter const* filter /*= nullptr*/)
+{
+	ComputeAStar(startPoint, goalPoint, outPath, m_scratch, agentRadius, filter);
+}
+
+void NavMeshPathfinding::ComputeAStar(Vec3 startPoint, Vec3 goalPoint, std::vector<Vec3>& outPath, SearchScratch& scratch, float agentRadius /*= 0.f*/, NavMeshQueryFilter const* filter /*= nullptr*/) const
+{
+	outPath.clear();
+	if (!ComputeCorridor(startPoint, goalPoint, scratch, filter)) return;
+
+	BuildPortals(scratch.m_corridor, startPoint, goalPoint, agentRadius, scratch.m_portals);
+	Funnel(scratch.m_portals, outPath);
+
+	// The funnel runs start to goal, callers get the goal first and no start
+	std::reverse(outPath.begin(), outPath.end());
+	outPath.pop_back();
+}
+
+void NavMeshPathfinding::ComputeAStars(std::vector<Vec3> const& startPoints, std::vector<Vec3> const& goalPoints, std::vector<std::vector<Vec3>>& outPaths, std::vector<SearchScratch>& scratches, float agentRadius /*= 0.f*/, NavMeshQueryFilter const* filter /*= nullptr*/) const
+{
+	int numQueries = static_cast<int>(startPoints.size() < goalPoints.size() ? startPoints.size() : goalPoints.size());
+	outPaths.resize(numQueries);
+	if (numQueries == 0) return;
+
+	// Workers plus the calling thread, which ParallelFor also puts to work
+	int numSlices = g_theJobSystem ? g_theJobSystem->GetNumWorkers() + 1 : 1;
+	if (numSlices > numQueries) numSlices = numQueries;
+	if (static_cast<int>(scratches.size()) < numSlices) scratches.resize(numSlices);
 
-		for (size_t i = 0; i < m_nodes.size(); i++)
+	// Queries are dealt out to slices round robin so a cluster of long searches doesn't all land on one slice
+	auto solveSlice = [&](int slice)
+	{
+		SearchScratch& scratch = scratches[slice];
+		for (int queryIndex = slice; queryIndex < numQueries; queryIndex += numSlices)
 		{
-			m_nodes[i] = Node();
-			m_nodes[i].m_position = Vec3::INVALID_POSITION;
-			m_nodes[i].m_triangleIndex = static_cast<int>(i);
-			m_nodes[i].m_totalgCost = std::numeric_limits<float>::max();
-			m_nodes[i].m_fCost = std::numeric_limits<float>::max();
-			m_nodes[i].m_parentTriangleIndex = -1;
-			m_nodes[i].m_openPathGen = -1;
-			m_nodes[i].m_closedPathGen = -1;
+			ComputeAStar(startPoints[queryIndex], goalPoints[queryIndex], outPaths[queryIndex], scratch, agentRadius, filter);
 		}
-	}
+	};
+
+	ParallelForIfAvailable(g_theJobSystem, 0, numSlices, 1, solveSlice, JobType::AI);
 }
 
-void NavMeshPathfinding::ComputeAStar(Vec3 startPoint, Vec3 goalPoint, std::vector<Vec3>& outPath)
+bool NavMeshPathfinding::ComputeCorridor(Vec3& startPoint, Vec3 const& goalPoint, SearchScratch& scratch, NavMeshQueryFilter const* filter /*= nullptr*/) const
 {
-	m_pathGen++;
+	std::vector<int>& outCorridor = scratch.m_corridor;
+	outCorridor.clear();
+	scratch.m_numNodesExpanded = 0;
 
-	std::priority_queue<Node*, std::vector<Node*>, CompareNode> openList;
+	int numTriangles = m_navMesh->GetNumTriangles();
+	if (static_cast<int>(scratch.m_nodes.size()) != numTriangles)
+	{
+		scratch.Initialize(numTriangles);
+	}
+	scratch.m_pathGen++;
+	int pathGen = scratch.m_pathGen;
+	std::vector<Node>& nodes = scratch.m_nodes;
+	CustomHeap& openList = scratch.m_openList;
+	openList.Clear();
+
+	// The filter turns into one cost per area here, so expanding a neighbor only costs a byte load and a table lookup.
+	// Every cost is at least 1, so scaling the heuristic by the cheapest one keeps it admissible
+	uint8_t const* triangleAreas = m_navMesh->m_triangleAreas.data();
+	ASSERT_OR_DIE(static_cast<int>(m_navMesh->m_triangleAreas.size()) == numTriangles, "NavMesh triangle areas out of sync with its triangles");
+	float areaCosts[NAVMESH_MAX_AREAS];
+	(filter ? filter : &s_defaultQueryFilter)->ResolveAreaCosts(areaCosts);
+	float heuristicScale = FLT_MAX;
+	for (float areaCost : areaCosts)
+	{
+		if (areaCost > 0.f && areaCost < heuristicScale) heuristicScale = areaCost;
+	}
+	if (heuristicScale == FLT_MAX) return false; // Nothing can be entered
 
-	int startNodeIndex = GetTriangleIndexFromPoint(startPoint);
-	int goalNodeIndex = GetTriangleIndexFromPoint(goalPoint);
+	int startNodeIndex = m_navMesh->GetTriangleIndexUnderPoint(startPoint);
+	int goalNodeIndex = m_navMesh->GetTriangleIndexUnderPoint(goalPoint);
 
 	if (startNodeIndex == -1) 
 	{
@@ -51,82 +130,82 @@ void NavMeshPathfinding::ComputeAStar(Vec3 startPoint, Vec3 goalPoint, std::vect
 		}
 		else
 		{
-			return;
+			return false;
 		}
 	}
-	else if (startNodeIndex >= m_navMesh->m_triangles.size())
+	else if (startNodeIndex >= numTriangles)
 	{
-		return;
+		return false;
 	}
 
 	if (goalNodeIndex == -1)
 	{
-		return;
+		return false;
 	}
-	else if (goalNodeIndex >= m_navMesh->m_triangles.size())
+	else if (goalNodeIndex >= numTriangles || m_navMesh->IsTriangleBlocked(goalNodeIndex) || areaCosts[triangleAreas[goalNodeIndex]] < 0.f)
 	{
-		return;
+		return false;
 	}
 
-	Node* startNode = &m_nodes[startNodeIndex];
+	Node* startNode = &nodes[startNodeIndex];
 	startNode->m_position = startPoint;
 	startNode->m_triangleIndex = startNodeIndex;
 	startNode->m_totalgCost = 0.f;
-	startNode->m_fCost = GetDistanceBetweenPointsExact(startPoint, goalPoint);
-	startNode->m_openPathGen = m_pathGen;
+	startNode->m_fCost = heuristicScale * GetDistanceBetweenPointsExact(startPoint, goalPoint);
+	startNode->m_parentTriangleIndex = -1;
+	startNode->m_openPathGen = pathGen;
 	startNode->m_closedPathGen = -1;
 
-	openList.emplace(startNode);
+	openList.Push(startNode);
 
-	while (!openList.empty())
+	while (!openList.Empty())
 	{
-		Node* currentNode = openList.top(); //  Get the node with the lowest fcost (highest priority/the best node to explore)
-		openList.pop(); // // Remove it from the queue because it's about to explore it
-		
-		if (currentNode->m_closedPathGen == m_pathGen) continue; // if node has already been explored then no need to check it again 
-		currentNode->m_closedPathGen = m_pathGen; // Once explored, we close that node so we don't revisit it again
+		Node* currentNode = openList.Pop(); // The node with the lowest fcost, every node is in the heap at most once
+		currentNode->m_closedPathGen = pathGen; // Once explored, we close that node so we don't revisit it again
+		scratch.m_numNodesExpanded++;
 
-		// If we found goal then compute path
+		// If we found goal then walk the parents back to the start for the corridor
 		if (currentNode->m_triangleIndex == goalNodeIndex)
 		{
-			if (!outPath.empty()) outPath.clear();
-
 			while (currentNode->m_triangleIndex != startNodeIndex)
 			{
-				outPath.emplace_back(currentNode->m_position);
+				outCorridor.emplace_back(currentNode->m_triangleIndex);
 				int parentIndex = currentNode->m_parentTriangleIndex;
-				if (parentIndex < 0 || parentIndex >= m_nodes.size()) break;
-				currentNode = &m_nodes[parentIndex];
+				if (parentIndex < 0 || parentIndex >= numTriangles)
+				{
+					outCorridor.clear();
+					return false;
+				}
+				currentNode = &nodes[parentIndex];
 			}
-			outPath.insert(outPath.begin(), goalPoint);
-
-			Prune(outPath);
-
-			// Clear the open list once path is found by swapping the current open list with an empty one
-			std::priority_queue<Node*, std::vector<Node*>, CompareNode> emptyList;
-			std::swap(openList, emptyList);
-			return;
+			outCorridor.emplace_back(startNodeIndex);
+			std::reverse(outCorridor.begin(), outCorridor.end());
+			return true;
 		}
 
-		// Global polygon lookup of current triangle index
-		// Get triangleID based on current pointindex and pass the id into here
-		const NavMeshTri& currentTriangle = m_navMesh->m_triangles[currentNode->m_triangleIndex]; 
-
-		for (int neighborID : currentTriangle.m_neighborTriIndexes)
+		// The step to a neighbor runs across the current triangle, so it's paid at the current triangle's cost.
+		// A start on a blocked or filtered out triangle can still walk off it, nothing else steps onto one
+		float currentAreaCost = areaCosts[triangleAreas[currentNode->m_triangleIndex]];
+		if (currentAreaCost < 0.f) currentAreaCost = heuristicScale;
+		for (int edge = 0; edge < 3; edge++)
 		{
-			if (neighborID >= m_nodes.size() || neighborID < 0) continue; // Skip invalid neighbors
-			Node* neighborNode = &m_nodes[neighborID];
-			if (neighborNode->m_closedPathGen == m_pathGen) continue;
+			int neighborID = m_navMesh->GetWalkableNeighbor(currentNode->m_triangleIndex, edge);
+			if (neighborID >= numTriangles || neighborID < 0) continue; // Skip invalid neighbors
+			if (areaCosts[triangleAreas[neighborID]] < 0.f) continue;
+			Node* neighborNode = &nodes[neighborID];
+			if (neighborNode->m_closedPathGen == pathGen) continue;
 
 			Vec3 neighborPoint = GetEdgeIntersectionPoint(neighborID, currentNode->m_position, goalPoint);
 
 			// Calculate costs
-			float localgCost = GetDistanceBetweenPointsExact(neighborPoint, currentNode->m_position);
+			float localgCost = currentAreaCost * GetDistanceBetweenPointsExact(neighborPoint, currentNode->m_position);
 			float totalgCost = currentNode->m_totalgCost + localgCost;
-			float hCost = GetDistanceBetweenPointsExact(neighborPoint, goalPoint);
+			float hCost = heuristicScale * GetDistanceBetweenPointsExact(neighborPoint, goalPoint);
 			float fCost = totalgCost + hCost;
 
-			if (fCost < neighborNode->m_fCost)
+			// Costs left over from an earlier search don't count
+			bool isOpen = neighborNode->m_openPathGen == pathGen;
+			if (!isOpen || fCost < neighborNode->m_fCost)
 			{
 				neighborNode->m_position = neighborPoint;
 				neighborNode->m_triangleIndex = neighborID;
@@ -134,80 +213,167 @@ void NavMeshPathfinding::ComputeAStar(Vec3 startPoint, Vec3 goalPoint, std::vect
 				neighborNode->m_fCost = fCost;
 				neighborNode->m_parentTriangleIndex = currentNode->m_triangleIndex;
 
-				if (neighborNode->m_openPathGen != m_pathGen)
+				if (isOpen)
 				{
-					neighborNode->m_openPathGen = m_pathGen;
-					openList.emplace(neighborNode);
+					openList.DecreaseKey(neighborNode);
+				}
+				else
+				{
+					neighborNode->m_openPathGen = pathGen;
+					openList.Push(neighborNode);
 				}
 			}
 		}
 	}
 
-	outPath.clear();
+	return false;
 }
 
-void NavMeshPathfinding::Funnel(Vec3 startPoint, std::vector<Vec3>& constructedPath)
+void NavMeshPathfinding::BuildPortals(std::vector<int> const& corridor, Vec3 const& startPoint, Vec3 const& goalPoint, float agentRadius, std::vector<NavMeshPortal>& outPortals) const
 {
-	if (constructedPath.empty()) return;
+	outPortals.clear();
+	outPortals.push_back(NavMeshPortal{ startPoint, startPoint });
 
-	std::vector<Vec3> smoothedPath;
-	smoothedPath.emplace_back(startPoint);
+	for (size_t i = 0; i + 1 < corridor.size(); i++)
+	{
+		const NavMeshTri& triangle = m_navMesh->m_triangles[corridor[i]];
+		int edge = -1;
+		for (int slot = 0; slot < 3; slot++)
+		{
+			if (triangle.m_neighborTriIndexes[slot] == corridor[i + 1]) edge = slot;
+		}
+		if (edge == -1) continue;
+
+		// Looking out through the edge, a counter clockwise triangle has the end of the edge on the left
+		Vec3 const& v0 = m_navMesh->m_vertexes[triangle.m_vertIndexes[0]];
+		Vec3 const& v1 = m_navMesh->m_vertexes[triangle.m_vertIndexes[1]];
+		Vec3 const& v2 = m_navMesh->m_vertexes[triangle.m_vertIndexes[2]];
+		int edgeStartIndex = triangle.m_vertIndexes[edge];
+		int edgeEndIndex = triangle.m_vertIndexes[(edge + 1) % 3];
+		bool isCounterClockwise = CrossProduct2D(Vec2(v1.x - v0.x, v1.y - v0.y), Vec2(v2.x - v0.x, v2.y - v0.y)) >= 0.f;
+		int leftIndex = isCounterClockwise ? edgeEndIndex : edgeStartIndex;
+		int rightIndex = isCounterClockwise ? edgeStartIndex : edgeEndIndex;
+		NavMeshPortal portal{ m_navMesh->m_vertexes[leftIndex], m_navMesh->m_vertexes[rightIndex] };
+
+		// Pulling an end in keeps the path the radius off that corner, never past the middle of the portal.
+		// Ends in the middle of open ground stay put, there is nothing there to keep clear of
+		if (agentRadius > 0.f)
+		{
+			Vec3 leftToRight = portal.m_right - portal.m_left;
+			float portalLength = leftToRight.GetLength();
+			if (portalLength > 0.f)
+			{
+				float shrinkDistance = std::min(agentRadius, portalLength * 0.5f);
+				Vec3 shrinkDisplacement = leftToRight * (shrinkDistance / portalLength);
+				if (IsBoundaryVertex(corridor[i], leftIndex)) portal.m_left += shrinkDisplacement;
+				if (IsBoundaryVertex(corridor[i], rightIndex)) portal.m_right -= shrinkDisplacement;
+			}
+		}
+
+		outPortals.push_back(portal);
+	}
 
-	Vec3 apex = startPoint;
-	Vec3 leftEdge, rightEdge;
+	outPortals.push_back(NavMeshPortal{ goalPoint, goalPoint });
+}
 
-	// Step through all edges in the constructed path
-	for (size_t i = 0; i < constructedPath.size() - 1; i++)
+bool NavMeshPathfinding::IsBoundaryVertex(int triangleIndex, int vertIndex) const
+{
+	int fanTriangleIndexes[NAVMESH_MAX_VERTEX_FAN];
+	int numFanTriangles = m_navMesh->GetTrianglesAroundVertex(triangleIndex, vertIndex, fanTriangleIndexes, NAVMESH_MAX_VERTEX_FAN);
+	for (int fanIndex = 0; fanIndex < numFanTriangles; fanIndex++)
 	{
-		Vec3 left = constructedPath[i];
-		Vec3 right = constructedPath[i + 1];
+		int fanTriangleIndex = fanTriangleIndexes[fanIndex];
+		int corner = m_navMesh->GetTriangleCornerOfVertex(fanTriangleIndex, vertIndex);
 
-		// First edge is always the funnel opening 
-		if (i == 0)
-		{
-			leftEdge = left;
-			rightEdge = right;
-			continue;
-		}
+		// The two edges touching the corner, an edge onto a blocked triangle counts as open
+		if (m_navMesh->GetWalkableNeighbor(fanTriangleIndex, corner) == -1 || m_navMesh->GetWalkableNeighbor(fanTriangleIndex, (corner + 2) % 3) == -1) return true;
+	}
+
+	return false;
+}
 
-		// Use CrossProduct to check if the left edge is valid 
-		Vec3 aLeft = rightEdge - apex;
-		Vec3 bLeft = left - apex;
-		if (CrossProduct3D(aLeft, bLeft).z <= 0.f)
+void NavMeshPathfinding::Funnel(std::vector<NavMeshPortal> const& portals, std::vector<Vec3>& outPath) const
+{
+	outPath.clear();
+	if (portals.empty()) return;
+
+	// Positive when point is left of the line from apex through side
+	auto getSide = [](Vec3 const& apex, Vec3 const& side, Vec3 const& point)
+	{
+		return CrossProduct2D(Vec2(side.x - apex.x, side.y - apex.y), Vec2(point.x - apex.x, point.y - apex.y));
+	};
+	auto isSamePoint = [](Vec3 const& a, Vec3 const& b)
+	{
+		return (a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y) < FUNNEL_SAME_POINT_DISTANCE_SQUARED;
+	};
+
+	// Simple stupid funnel: both sides narrow portal by portal, and when one side crosses the other
+	// its far corner goes in the path and the scan starts over from that corner
+	Vec3 apex = portals[0].m_left;
+	Vec3 left = portals[0].m_left;
+	Vec3 right = portals[0].m_right;
+	int apexIndex = 0;
+	int leftIndex = 0;
+	int rightIndex = 0;
+	outPath.emplace_back(apex);
+
+	for (int i = 1; i < static_cast<int>(portals.size()); i++)
+	{
+		Vec3 const& portalLeft = portals[i].m_left;
+		Vec3 const& portalRight = portals[i].m_right;
+
+		if (getSide(apex, right, portalRight) >= 0.f)
 		{
-			if (apex != rightEdge)
+			if (isSamePoint(apex, right) || getSide(apex, left, portalRight) < 0.f)
 			{
-				smoothedPath.emplace_back(rightEdge);
-				apex = rightEdge;
-				leftEdge = left;
-				rightEdge = left;
+				right = portalRight;
+				rightIndex = i;
+			}
+			else
+			{
+				apex = left;
+				apexIndex = leftIndex;
+				if (!isSamePoint(outPath.back(), apex)) outPath.emplace_back(apex); // A portal touching the apex can hand it back as the corner
+				left = apex;
+				right = apex;
+				leftIndex = apexIndex;
+				rightIndex = apexIndex;
+				i = apexIndex;
 				continue;
 			}
 		}
 
-		// Use CrossProduct to check if the right edge is valid
-		Vec3 aRight = leftEdge - apex;
-		Vec3 bRight = right - apex;
-		if (CrossProduct3D(aRight, bRight).z <= 0.f)
+		if (getSide(apex, left, portalLeft) <= 0.f)
 		{
-			if (apex != leftEdge)
+			if (isSamePoint(apex, left) || getSide(apex, right, portalLeft) > 0.f)
 			{
-				smoothedPath.emplace_back(leftEdge);
-				apex = leftEdge;
-				rightEdge = right;
-				leftEdge = right;
+				left = portalLeft;
+				leftIndex = i;
+			}
+			else
+			{
+				apex = right;
+				apexIndex = rightIndex;
+				if (!isSamePoint(outPath.back(), apex)) outPath.emplace_back(apex);
+				left = apex;
+				right = apex;
+				leftIndex = apexIndex;
+				rightIndex = apexIndex;
+				i = apexIndex;
 				continue;
 			}
 		}
-
-		// Update the edges and then repeat the process until we reach the end of the path
-		leftEdge = left;
-		rightEdge = right;
 	}
 
-	// Add the last waypoint to the smoothedPath
-	smoothedPath.emplace_back(constructedPath.back());
-	constructedPath = smoothedPath;
+	Vec3 const& goalPoint = portals.back().m_left;
+	if (outPath.size() > 1 && isSamePoint(outPath.back(), goalPoint))
+	{
+		outPath.back() = goalPoint;
+	}
+	else
+	{
+		outPath.emplace_back(goalPoint);
+	}
 }
 
 void NavMeshPathfinding::Prune(std::vector<Vec3>& prunedPath)
@@ -223,20 +389,24 @@ void NavMeshPathfinding::Prune(std::vector<Vec3>& prunedPath)
 	{
 		int nextIndex = currentIndex + 1;
 
-		// Find the farthest valid point that maintains line-of-sight
-		for (int i = nextIndex + 1; i < prunedPath.size(); i++)
+		// Find the farthest valid point that maintains line-of-sight, every check starts from the same triangle
+		int currentTriangleIndex = m_navMesh->GetTriangleIndexUnderPoint(prunedPath[currentIndex]);
+		if (currentTriangleIndex != -1)
 		{
-			if (!HasLineOfSight(prunedPath[currentIndex], prunedPath[i])) break;
-			nextIndex = i;
+			for (int i = nextIndex + 1; i < prunedPath.size(); i++)
+			{
+				if (!m_navMesh->HasLineOfSight(currentTriangleIndex, prunedPath[currentIndex], prunedPath[i])) break;
+				nextIndex = i;
+			}
 		}
 
 		path.emplace_back(prunedPath[nextIndex]);
 		currentIndex = nextIndex;
 	}
 
-	for (Vec3& point : prunedPath)
+	for (Vec3& point : path)
 	{
-		int triangleIndex = GetTriangleIndexFromPoint(point);
+		int triangleIndex = m_navMesh->GetTriangleIndexUnderPoint(point);
 		if (triangleIndex != -1)
 		{
 			point.z = GetHeightOnTriangle(triangleIndex, point.x, point.y);
@@ -307,32 +477,7 @@ void NavMeshPathfinding::GroundCheck(Vec3 startPosition, float endZHeight)
 
 bool NavMeshPathfinding::HasLineOfSight(const Vec3& startPoint, const Vec3& endPoint) const
 {
-	Vec3 direction = (endPoint - startPoint).GetNormalized();
-	float distance = GetDistanceBetweenPointsExact(startPoint, endPoint);
-	float stepSize = GetAverageTriangleEdgeLength() /** 0.1f*/; // multiply by 0.1 for small step size 
-
-	for (float t = 0; t <= distance; t += stepSize)
-	{
-		Vec3 pointToCheck = startPoint + (direction * t);
-
-		bool insideNavMesh = false;
-		for (size_t i = 0; i < m_navMesh->m_triangles.size(); i++)
-		{
-			const NavMeshTri& triangle = m_navMesh->m_triangles[i];
-			const Vec3& p0 = m_navMesh->m_vertexes[triangle.m_vertIndexes[0]];
-			const Vec3& p1 = m_navMesh->m_vertexes[triangle.m_vertIndexes[1]];
-			const Vec3& p2 = m_navMesh->m_vertexes[triangle.m_vertIndexes[2]];
-			if (IsPointInsideTriangle3D(pointToCheck, p0, p1, p2))
-			{
-				insideNavMesh = true;
-				break;
-			}
-		}
-
-		if (!insideNavMesh) return false;
-	}
-
-	return true;
+	return m_navMesh->HasLineOfSight(startPoint, endPoint);
 }
 
 float NavMeshPathfinding::GetAverageTriangleEdgeLength() const
@@ -360,19 +505,19 @@ float NavMeshPathfinding::GetAverageTriangleEdgeLength() const
 	return 0.f;
 }
 
-float NavMeshPathfinding::GetHeightOnTriangle(int triangleID, float x, float y)
+float NavMeshPathfinding::GetHeightOnTriangle(int triangleID, float x, float y) const
 {
-	NavMeshTri* triangleMesh = m_navMesh->GetNavMeshTriangle(triangleID);
-	if (!triangleMesh) return 0.f; // Default ground level if something goes wrong
+	if (triangleID < 0 || triangleID >= m_navMesh->GetNumTriangles()) return 0.f; // Default ground level if something goes wrong
+	const NavMeshTri& triangle = m_navMesh->m_triangles[triangleID];
 
-	Vec3 v0 = m_navMesh->m_vertexes[triangleMesh->m_vertIndexes[0]];
-	Vec3 v1 = m_navMesh->m_vertexes[triangleMesh->m_vertIndexes[1]];
-	Vec3 v2 = m_navMesh->m_vertexes[triangleMesh->m_vertIndexes[2]];
+	Vec3 v0 = m_navMesh->m_vertexes[triangle.m_vertIndexes[0]];
+	Vec3 v1 = m_navMesh->m_vertexes[triangle.m_vertIndexes[1]];
+	Vec3 v2 = m_navMesh->m_vertexes[triangle.m_vertIndexes[2]];
 
 	return ComputeBarycentricHeight(x, y, v0, v1, v2);
 }
 
-float NavMeshPathfinding::GetHeightOnTriangle(const NavMeshTri& triangle, float x, float y)
+float NavMeshPathfinding::GetHeightOnTriangle(const NavMeshTri& triangle, float x, float y) const
 {
 	Vec3 v0 = m_navMesh->m_vertexes[triangle.m_vertIndexes[0]];
 	Vec3 v1 = m_navMesh->m_vertexes[triangle.m_vertIndexes[1]];
@@ -381,7 +526,7 @@ float NavMeshPathfinding::GetHeightOnTriangle(const NavMeshTri& triangle, float
 	return ComputeBarycentricHeight(x, y, v0, v1, v2);
 }
 
-float NavMeshPathfinding::GetHeightOnTriangle(Vec3 point)
+float NavMeshPathfinding::GetHeightOnTriangle(Vec3 point) const
 {
 	int triangleIndex = GetTriangleIndexFromPoint(point);
 	if (triangleIndex == -1) return point.z;
@@ -389,7 +534,7 @@ float NavMeshPathfinding::GetHeightOnTriangle(Vec3 point)
 	return GetHeightOnTriangle(triangleIndex, point.x, point.y);
 }
 
-float NavMeshPathfinding::ComputeBarycentricHeight(float x, float y, Vec3 v0, Vec3 v1, Vec3 v2)
+float NavMeshPathfinding::ComputeBarycentricHeight(float x, float y, Vec3 v0, Vec3 v1, Vec3 v2) const
 {
 	// Compute edge vectors
 	Vec3 edge0 = v1 - v0;
@@ -433,16 +578,16 @@ int NavMeshPathfinding::GetTriangleIndexFromPoint(Vec3 point) const
 	return -1;
 }
 
-Vec3 NavMeshPathfinding::GetEdgeIntersectionPoint(int neighborTriangleID, Vec3 currentPoint, Vec3 goalPoint)
+Vec3 NavMeshPathfinding::GetEdgeIntersectionPoint(int neighborTriangleID, Vec3 currentPoint, Vec3 goalPoint) const
 {
-	NavMeshTri* triangleMesh = m_navMesh->GetNavMeshTriangle(neighborTriangleID);
-	if (!triangleMesh) return Vec3::ZERO;
+	if (neighborTriangleID < 0 || neighborTriangleID >= m_navMesh->GetNumTriangles()) return Vec3::ZERO;
+	const NavMeshTri& triangleMesh = m_navMesh->m_triangles[neighborTriangleID];
 
-	Vec3 v0 = m_navMesh->m_vertexes[triangleMesh->m_vertIndexes[0]];
-	Vec3 v1 = m_navMesh->m_vertexes[triangleMesh->m_vertIndexes[1]];
-	Vec3 v2 = m_navMesh->m_vertexes[triangleMesh->m_vertIndexes[2]];
+	Vec3 v0 = m_navMesh->m_vertexes[triangleMesh.m_vertIndexes[0]];
+	Vec3 v1 = m_navMesh->m_vertexes[triangleMesh.m_vertIndexes[1]];
+	Vec3 v2 = m_navMesh->m_vertexes[triangleMesh.m_vertIndexes[2]];
 
-	std::vector<std::pair<Vec3, Vec3>> edges = { {v0, v1}, {v1, v2}, {v2, v0} };
+	std::pair<Vec3, Vec3> const edges[3] = { {v0, v1}, {v1, v2}, {v2, v0} }; // Called for every A* neighbor, so kept off the heap
 
 	Vec3 bestIntersectionPoint = Vec3::ZERO;
 	float closestDist = std::numeric_limits<float>::max();
@@ -543,61 +688,7 @@ Vec3 NavMeshPathfinding::GetImpactPointOnTriangle(Vec3& point, int triangleID)
 
 RaycastVsGroundResult NavMeshPathfinding::RaycastVsNavNesh(const Vec3& start, const Vec3& direction, float maxDistance)
 {
-	RaycastVsGroundResult result;
-	result.m_impactDist = maxDistance;
-
-	Vec3 rayDir = direction.GetNormalized();
-
-	// Loop through the triangles
-	for (size_t i = 0; i < m_navMesh->m_triangles.size(); i++)
-	{
-		NavMeshTri& triangle = m_navMesh->m_triangles[i];
-		Vec3& v0 = m_navMesh->m_vertexes[triangle.m_vertIndexes[0]];
-		Vec3& v1 = m_navMesh->m_vertexes[triangle.m_vertIndexes[1]];
-		Vec3& v2 = m_navMesh->m_vertexes[triangle.m_vertIndexes[2]];
-
-		// Create bounding volume via sphere around each triangle
-		Vec3 centroid = CalculateCentroid(triangle);
-
-		// Set the sphere radius (rough estimate using the distance from centroid to a vertex)
-		float sphereRadius = GetDistance3D(centroid, v0);
-
-		// Raycast against the sphere first to filter out potential hits
-		RaycastResult3D sphereHit;
-		sphereHit = RaycastVsSphere(start, rayDir, maxDistance, centroid, sphereRadius);
-		if (!sphereHit.m_didImpact) continue;
-
-		// Raycast vs triangle's plane
-		Vec3 edge0 = v1 - v0;
-		Vec3 edge2 = v2 - v0;
-		Vec3 normal = CrossProduct3D(edge0, edge2).GetNormalized();
-
-		// Ensure the normal is pointing upwards (if applicable)
-		if (DotProduct3D(normal, Vec3(0.f, 0.f, 1.f)) < 0.f)
-		{
-			normal = -normal; // Flip the normal
-		}
-
-		// Calculate the distance from the plane using a vertex
-		float planeDistance = DotProduct3D(normal, v0);
-		Plane3D trianglePlane = Plane3D(normal, planeDistance);
-
-		// Cast ray against the triangle's plane
-		RaycastResult3D planeHit = RaycastVsPlane3D(start, direction.GetNormalized(), maxDistance, trianglePlane);
-
-		if (IsPointInsideTriangle3D(planeHit.m_impactPos, v0, v1, v2))
-		{
-			// Front of plane
-			if (DotProduct3D(rayDir, normal) >= 0.f) continue; // skip the backside 
-
-			// If the point is within the sphere (due to prior sphere check), we treat it as a hit
-			result.m_didImpact = true;
-			result.m_impactPos = planeHit.m_impactPos;
-			result.m_impactNormal = planeHit.m_impactNormal;
-			result.m_impactDist = planeHit.m_impactDist;
-			break; // Exit the loop once we've found an impact
-		}
-	}
+	RaycastVsGroundResult result = m_navMesh->RaycastVsNavMesh(start, direction, maxDistance);
 
 	DebugAddWorldArrow(start, start + (direction * maxDistance), 0.8f, 0.015f, 0.01f, 0.f, Rgba8::DARK_GRAY, Rgba8::DARK_GRAY, DebugRenderMode::ALWAYS);
 	DebugAddWorldArrow(start, start + (direction * result.m_impactDist), 0.8f, 0.015f, 0.01f, 0.f, Rgba8::RED, Rgba8::RED, DebugRenderMode::ALWAYS);
@@ -620,4 +711,97 @@ void NavMeshPathfinding::TestAStarPathFinding(Vec3 startPoint, Vec3 goalPoint, s
 
 	size_t pathSizeInBytes = path.size() * sizeof(size_t); // Approximate size of one path
 	g_theConsole->AddLine(Rgba8::DARK_ORANGE, Stringf("The approximate size of one path is %zu bytes", pathSizeInBytes));
-}
\ No newline at end of file
+}
+
+void NavMeshPathfinding::CustomHeap::Push(Node* node)
+{
+	m_elements.emplace_back(node);
+	node->m_heapIndex = static_cast<int>(m_elements.size()) - 1;
+	PercolateUp(node->m_heapIndex);
+}
+
+void NavMeshPathfinding::CustomHeap::DecreaseKey(Node* node)
+{
+	if (node->m_heapIndex >= 0 && node->m_heapIndex < static_cast<int>(m_elements.size()))
+	{
+		PercolateUp(static_cast<size_t>(node->m_heapIndex));
+	}
+}
+
+void NavMeshPathfinding::CustomHeap::Clear()
+{
+	// Nodes left over from a search that stopped at the goal must not look like they are still in the heap
+	for (Node* node : m_elements)
+	{
+		node->m_heapIndex = -1;
+	}
+	m_elements.clear();
+}
+
+Node* NavMeshPathfinding::CustomHeap::Pop()
+{
+	if (m_elements.empty()) return nullptr;
+
+	Node* minNode = m_elements.front();
+	m_elements[0] = m_elements.back();
+	m_elements[0]->m_heapIndex = 0;
+	m_elements.pop_back();
+	if (!m_elements.empty())
+	{
+		PercolateDown(0);
+	}
+	minNode->m_heapIndex = -1;
+
+	return minNode;
+}
+
+void NavMeshPathfinding::CustomHeap::PercolateUp(size_t index)
+{
+	while (index > 0)
+	{
+		size_t parent = (index - 1) / 2;
+		if (m_elements[index]->m_fCost < m_elements[parent]->m_fCost)
+		{
+			std::swap(m_elements[index], m_elements[parent]);
+			std::swap(m_elements[index]->m_heapIndex, m_elements[parent]->m_heapIndex);
+			index = parent;
+		}
+		else
+		{
+			break;
+		}
+	}
+}
+
+void NavMeshPathfinding::CustomHeap::PercolateDown(size_t index)
+{
+	size_t leftChild, rightChild, smallest;
+
+	while (true)
+	{
+		leftChild = index * 2 + 1;
+		rightChild = index * 2 + 2;
+		smallest = index;
+
+		if (leftChild < m_elements.size() && m_elements[leftChild]->m_fCost < m_elements[smallest]->m_fCost)
+		{
+			smallest = leftChild;
+		}
+
+		if (rightChild < m_elements.size() && m_elements[rightChild]->m_fCost < m_elements[smallest]->m_fCost)
+		{
+			smallest = rightChild;
+		}
+
+		if (smallest != index)
+		{
+			std::swap(m_elements[index], m_elements[smallest]);
+			std::swap(m_elements[index]->m_heapIndex, m_elements[smallest]->m_heapIndex);
+			index = smallest;
+		}
+		else
+		{
+			break;
+		}
+	}
+}
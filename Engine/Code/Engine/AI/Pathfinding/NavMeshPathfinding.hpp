@@ -10,13 +10,13 @@
 #include <algorithm>
 
 constexpr float ALLOWED_HEIGHT_DEVIATION = 0.125f;
+constexpr float FUNNEL_SAME_POINT_DISTANCE_SQUARED = 0.000001f;
 
-struct RaycastVsGroundResult
+// Shared edge between two triangles of an A* corridor, sides as seen walking from the start toward the goal
+struct NavMeshPortal
 {
-	bool	m_didImpact = false;
-	float	m_impactDist = 0.f;
-	Vec3	m_impactPos;
-	Vec3	m_impactNormal;
+	Vec3 m_left;
+	Vec3 m_right;
 };
 
 struct Node
@@ -28,12 +28,13 @@ struct Node
 	int m_parentTriangleIndex;
 	int m_openPathGen = -1; // Better for medium to large maps
 	int m_closedPathGen = -1; // Better for medium to large maps
+	int m_heapIndex = -1; // Slot in NavMeshPathfinding::CustomHeap, -1 when not in it
 // 	bool m_isOpen; // Better for small maps
 // 	bool m_isClosed; // Better for small maps
 
-	Node() : m_position(std::numeric_limits<Vec3>::max()), m_triangleIndex(std::numeric_limits<int>::max()), m_totalgCost(0), m_fCost(0), m_parentTriangleIndex(std::numeric_limits<int>::max()), m_openPathGen(-1), m_closedPathGen(-1) {}
+	Node() : m_position(std::numeric_limits<Vec3>::max()), m_triangleIndex(std::numeric_limits<int>::max()), m_totalgCost(0), m_fCost(0), m_parentTriangleIndex(std::numeric_limits<int>::max()), m_openPathGen(-1), m_closedPathGen(-1), m_heapIndex(-1) {}
 	Node(Vec3 position, Vec3 parentPosition, int pointIndex, float gCost, float fCost, int parentIndex, int nodeOpen, int nodeClosed)
-		:m_position(position), m_triangleIndex(pointIndex), m_totalgCost(gCost), m_fCost(fCost), m_parentTriangleIndex(parentIndex), m_openPathGen(nodeOpen), m_closedPathGen(nodeClosed) {}
+		:m_position(position), m_triangleIndex(pointIndex), m_totalgCost(gCost), m_fCost(fCost), m_parentTriangleIndex(parentIndex), m_openPathGen(nodeOpen), m_closedPathGen(nodeClosed), m_heapIndex(-1) {}
 };
 
 struct CompareNode
@@ -52,25 +53,63 @@ public:
 	// Initializing Nodes
 	void InitializeNavMeshNodes(NavMesh const& navMesh);
 
-	// A-Star
-	void ComputeAStar(Vec3 startPoint, Vec3 goalPoint, std::vector<Vec3>& outPath);
-	void Funnel(Vec3 startPoint, std::vector<Vec3>& constructedPath);
+	class CustomHeap
+	{
+	public:
+		void Reserve(size_t amount) { m_elements.reserve(amount); }
+		void Push(Node* node);
+		void DecreaseKey(Node* node);
+		void Clear();
+		Node* Pop();
+		bool Empty() const { return m_elements.empty(); }
+		size_t Size() const { return m_elements.size(); }
+
+	private:
+		std::vector<Node*> m_elements;
+
+		void PercolateUp(size_t index);
+		void PercolateDown(size_t index);
+	};
+
+	// Everything one search writes to. Give each thread its own and they can all search the same NavMesh at once,
+	// after the first search every vector has its capacity and a search allocates nothing
+	struct SearchScratch
+	{
+		void Initialize(int numTriangles);
+
+		int m_pathGen = 0;
+		int m_numNodesExpanded = 0; // For the last search
+		std::vector<Node> m_nodes; // One per triangle, sized on first use
+		CustomHeap m_openList;
+		std::vector<int> m_corridor; // Last corridor, start to goal
+		std::vector<NavMeshPortal> m_portals; // Last portals, kept for debug drawing
+	};
+
+	// A-Star, the path comes back goal first and leaves out the start. Corners keep agentRadius of clearance where the portals allow it.
+	// The filter picks which areas can be entered and what they cost, null uses the default NavMeshQueryFilter
+	void ComputeAStar(Vec3 startPoint, Vec3 goalPoint, std::vector<Vec3>& outPath, float agentRadius = 0.f, NavMeshQueryFilter const* filter = nullptr);
+	void ComputeAStar(Vec3 startPoint, Vec3 goalPoint, std::vector<Vec3>& outPath, SearchScratch& scratch, float agentRadius = 0.f, NavMeshQueryFilter const* filter = nullptr) const; // Only reads the NavMesh
+	void ComputeAStars(std::vector<Vec3> const& startPoints, std::vector<Vec3> const& goalPoints, std::vector<std::vector<Vec3>>& outPaths, std::vector<SearchScratch>& scratches, float agentRadius = 0.f, NavMeshQueryFilter const* filter = nullptr) const; // Spread over the job system, keep scratches between calls
+	bool ComputeCorridor(Vec3& startPoint, Vec3 const& goalPoint, SearchScratch& scratch, NavMeshQueryFilter const* filter = nullptr) const; // Triangles start to goal into scratch.m_corridor, moves an off mesh start onto the mesh
+	void BuildPortals(std::vector<int> const& corridor, Vec3 const& startPoint, Vec3 const& goalPoint, float agentRadius, std::vector<NavMeshPortal>& outPortals) const; // Start and goal go in as zero width portals
+	void Funnel(std::vector<NavMeshPortal> const& portals, std::vector<Vec3>& outPath) const; // Shortest path through the portals, start to goal
 	void Prune(std::vector<Vec3>& prunedPath);
 	void ResamplePathToFollowNavMesh(std::vector<Vec3>& path);
 
 	// Utility functions
 	void GroundCheck(Vec3 startPosition, float endZHeight);
 	bool HasLineOfSight(const Vec3& startPoint, const Vec3& endPoint) const;
+	bool IsBoundaryVertex(int triangleIndex, int vertIndex) const; // Touches an open edge of the mesh
 	float GetAverageTriangleEdgeLength() const;
-	float GetHeightOnTriangle(int triangleID, float x, float y);
-	float GetHeightOnTriangle(const NavMeshTri& triangle, float x, float y);
-	float GetHeightOnTriangle(Vec3 point);
-	float ComputeBarycentricHeight(float x, float y, Vec3 v0, Vec3 v1, Vec3 v2);
+	float GetHeightOnTriangle(int triangleID, float x, float y) const;
+	float GetHeightOnTriangle(const NavMeshTri& triangle, float x, float y) const;
+	float GetHeightOnTriangle(Vec3 point) const;
+	float ComputeBarycentricHeight(float x, float y, Vec3 v0, Vec3 v1, Vec3 v2) const;
 	int GetTriangleIndexFromPoint(Vec3 point) const;
 	inline float GetDistanceSquaredBetweenPoints(const Vec3& pointA, const Vec3& pointB) const { return (pointB - pointA).GetLengthSquared(); };
 	inline float GetDistanceBetweenPointsExact(const Vec3& pointA, const Vec3& pointB) const { return (pointB - pointA).GetLength(); };
 
-	Vec3 GetEdgeIntersectionPoint(int neighborTriangleID, Vec3 currentPoint, Vec3 goalPoint);
+	Vec3 GetEdgeIntersectionPoint(int neighborTriangleID, Vec3 currentPoint, Vec3 goalPoint) const;
 	Vec3 CalculateCentroid(NavMeshTri& triangleMesh);
 	Vec3 CalculateCentroid(int triangleID);
 	Vec3 GetRandomPointWithinTriangleIndex(int triangleID);
@@ -82,7 +121,6 @@ public:
 	void TestAStarPathFinding(Vec3 startPoint, Vec3 goalPoint, std::vector<Vec3>& path);
 
 public:
-	NavMesh* m_navMesh = nullptr;
-	std::vector<Node> m_nodes;
-	int m_pathGen = 0;
+	NavMesh* m_navMesh = nullptr; // Searches only read it
+	SearchScratch m_scratch; // Used by the single threaded ComputeAStar
 };
\ No newline at end of file
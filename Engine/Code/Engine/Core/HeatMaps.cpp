@@ -1,7 +1,9 @@
 #include "Engine/Core/HeatMaps.hpp"
 #include "Engine/Core/VertexUtils.hpp"
+#include "Engine/Core/ErrorWarningAssert.hpp"
 #include "Engine/Math/MathUtils.hpp"
 #include "Engine/Renderer/NavMesh.hpp"
+#include <algorithm>
 
 TileHeatMap::TileHeatMap(const IntVec2& dimensions)
 	: m_dimensions(dimensions)
@@ -100,51 +102,42 @@ void TileHeatMap::AddVertsForDebugDraw(std::vector<Vertex_PCU>& verts, AABB2 bou
 NavMeshHeatMap::NavMeshHeatMap(NavMesh* navMesh)
 	: m_navMesh(navMesh)
 {
-	for (int triangleID = 0; triangleID < static_cast<int>(m_navMesh->m_triangles.size()); triangleID++)
-	{
-		m_values[triangleID] = 0.f;
-	}
+	m_values.resize(m_navMesh->m_triangles.size(), 0.f);
 }
 
 float NavMeshHeatMap::GetHighestHeat() const
 {
 	float highestHeat = 0.f; // Initial Value. heat values are never negative
 
-	for (const auto& pair : m_values)
+	for (float value : m_values)
 	{
-		if (pair.second > highestHeat)
+		if (value > highestHeat)
 		{
-			highestHeat = pair.second;
+			highestHeat = value;
 		}
 	}
 	return highestHeat;
 }
 
-float NavMeshHeatMap::GetValue(int triangleID)
+void NavMeshHeatMap::SetNumValues(int numValues)
 {
-	auto it = m_values.find(triangleID);
-	if (it != m_values.end())
-	{
-		return it->second;
-	}
-	return 0.f;
+	m_values.resize(numValues, 0.f);
 }
 
 void NavMeshHeatMap::SetAllValues(float value)
 {
-	for (auto& pair : m_values)
-	{
-		pair.second = value;
-	}
+	std::fill(m_values.begin(), m_values.end(), value);
 }
 
 void NavMeshHeatMap::SetValue(int triangleID, float value)
 {
+	ASSERT_OR_DIE(triangleID >= 0 && triangleID < static_cast<int>(m_values.size()), "NavMeshHeatMap triangle ID out of range");
 	m_values[triangleID] = value;
 }
 
 void NavMeshHeatMap::AddValue(int triangleID, float value)
 {
+	ASSERT_OR_DIE(triangleID >= 0 && triangleID < static_cast<int>(m_values.size()), "NavMeshHeatMap triangle ID out of range");
 	m_values[triangleID] += value;
 }
 
@@ -39,8 +39,12 @@ public:
 	~NavMeshHeatMap() = default;
 
 	float GetHighestHeat() const;
-	float GetValue(int triangleID);
+	inline float GetValue(int triangleID) const { return (triangleID >= 0 && triangleID < static_cast<int>(m_values.size())) ? m_values[triangleID] : 0.f; }
+	inline int GetNumValues() const { return static_cast<int>(m_values.size()); }
+	inline float* GetValueData() { return m_values.data(); } // One float per triangle ID, for bulk reads and writes
+	inline float const* GetValueData() const { return m_values.data(); }
 
+	void SetNumValues(int numValues); // New values start at 0
 	void SetAllValues(float value);
 	void SetValue(int triangleID, float value);
 	void AddValue(int triangleID, float value);
@@ -49,5 +53,5 @@ public:
 
 private:
 	NavMesh* m_navMesh = nullptr;
-	std::unordered_map<int, float> m_values; // Triangle ID to Distance
+	std::vector<float> m_values; // Indexed by triangle ID
 };
@@ -1,12 +1,59 @@
 #include "Engine/Core/JobSystem.hpp"
 #include "Engine/Core/EngineCommon.hpp"
 #include "Engine/Core/ErrorWarningAssert.hpp"
+#include "Engine/Core/DevConsole.hpp"
+#include "Engine/Core/Time.hpp"
+#include <algorithm>
 
 JobSystem* g_theJobSystem = nullptr;
 
+static thread_local JobWorker* s_currentJobWorker = nullptr; // Set on worker threads so nested jobs go to the worker's own queue
+
+static void UpdateAtomicMax(std::atomic<int>& value, int candidate)
+{
+	int current = value.load();
+	while (candidate > current && !value.compare_exchange_weak(current, candidate)) {}
+}
+
+static void UpdateAtomicMax(std::atomic<unsigned long long>& value, unsigned long long candidate)
+{
+	unsigned long long current = value.load();
+	while (candidate > current && !value.compare_exchange_weak(current, candidate)) {}
+}
+
+char const* GetJobTypeName(JobType type)
+{
+	switch (type)
+	{
+		case JobType::GENERIC:		return "Generic";
+		case JobType::PHYSICS:		return "Physics";
+		case JobType::AI:			return "AI";
+		case JobType::RENDERING:	return "Rendering";
+		case JobType::AUDIO:		return "Audio";
+		case JobType::NETWORKING:	return "Networking";
+		case JobType::IO:			return "IO";
+		default:					return "Unknown";
+	}
+}
+
 JobSystem::JobSystem(JobSystemConfig config)
 	: m_config(config)
 {
+	for (JobWorkerPoolConfig const& pool : m_config.m_workerPools)
+	{
+		if (pool.m_numWorkers > 0)
+		{
+			m_generalJobTypeMask &= ~pool.m_jobTypeMask;
+		}
+	}
+
+	int poolCapacity = (m_config.m_jobPoolCapacity > 0) ? m_config.m_jobPoolCapacity : 0;
+	m_jobPoolSlots.resize(poolCapacity);
+	m_freeJobPoolSlots.reserve(poolCapacity);
+	for (int slotIndex = poolCapacity - 1; slotIndex >= 0; slotIndex--)
+	{
+		m_freeJobPoolSlots.emplace_back(slotIndex);
+	}
 }
 
 JobSystem::~JobSystem()
@@ -22,6 +69,12 @@ void JobSystem::Startup()
 		numWorkers = std::thread::hardware_concurrency() - 1;
 	}
 	CreateWorkers(numWorkers);
+
+	if (g_theEventSystem)
+	{
+		g_theEventSystem->SubscribeEventCallbackFunction("JobSystemBenchmark", Command_JobSystemBenchmark);
+		g_theEventSystem->SubscribeEventCallbackFunction("JobSystemLaneStats", Command_JobSystemLaneStats);
+	}
 }
 
 void JobSystem::ShutDown()
@@ -39,179 +92,750 @@ void JobSystem::EndFrame()
 
 void JobSystem::QueueJob(Job* jobToQueue)
 {
+	m_numUnfinishedJobs++;
+	jobToQueue->m_state.store(JobStatus::QUEUE);
+	{
+		std::lock_guard<std::mutex> dependentsLock(jobToQueue->m_dependentsMutex);
+		jobToQueue->m_areDependentsReleased = false; // A job queued again after completing takes new dependents
+	}
+
+	// Release the hold every job is born with. Whoever drops the count to zero (here or the last prerequisite) schedules the job
+	if (--jobToQueue->m_numUnmetDependencies == 0)
+	{
+		EnqueueReadyJob(jobToQueue);
+	}
+}
+
+void JobSystem::QueueJob(Job* jobToQueue, std::vector<Job*> const& prerequisites)
+{
+	for (Job* prerequisite : prerequisites)
+	{
+		jobToQueue->AddDependency(prerequisite);
+	}
+	QueueJob(jobToQueue);
+}
+
+void JobSystem::EnqueueReadyJob(Job* jobToQueue)
+{
+	JobType type = jobToQueue->GetJobType();
+	int lane = static_cast<int>(type);
+	JobLaneCounters& counters = m_laneCounters[lane];
+	jobToQueue->m_readyTime = GetCurrentTimeSeconds();
+
+	if (m_config.m_schedulerMode == JobSchedulerMode::WORK_STEALING && !m_workers.empty())
+	{
+		JobWorker* worker = GetWorkerForNewJob(type);
+		worker->PushLocalJob(jobToQueue);
+		m_numQueuedJobs++;
+		counters.m_numEnqueued++;
+		UpdateAtomicMax(counters.m_peakQueued, ++counters.m_numQueued);
+
+		// Only parked workers need a signal. A worker on its way to parking re-checks the queued count after flagging itself parked
+		if (worker->IsParked())
+		{
+			worker->Wake();
+		}
+		WakeWorkerToSteal(type, worker);
+		return;
+	}
+
 	{
 		std::lock_guard<std::mutex> lock(m_queueMutex);
-		jobToQueue->m_state.store(JobStatus::QUEUE);
-		m_queueJobs.emplace_back(jobToQueue);
-		m_allJobs.emplace_back(jobToQueue);
+		m_laneJobs[lane].PushBack(jobToQueue);
+		m_numQueuedJobs++;
+		counters.m_numEnqueued++;
+		UpdateAtomicMax(counters.m_peakQueued, ++counters.m_numQueued);
+	}
+
+	// With pools, the one thread notify_one picks may not be allowed to run this type
+	if (m_config.m_workerPools.empty())
+	{
+		m_condition.notify_one();
+	}
+	else
+	{
+		m_condition.notify_all();
 	}
-	m_condition.notify_one(); // Notify only one waiting thread
 }
 
 void JobSystem::WaitForAllJobsToFinish()
 {
-	std::unique_lock<std::mutex> lock(m_queueMutex);
-	m_condition.wait(lock, [this] { std::lock_guard<std::mutex> execLock(m_executingMutex); return m_queueJobs.empty() && m_executingJobs.empty(); });
+	std::unique_lock<std::mutex> lock(m_finishedMutex);
+	m_finishedCondition.wait(lock, [this] { return m_numUnfinishedJobs.load() == 0; });
+}
+
+void JobSystem::WaitForCounter(JobCounter const& counter)
+{
+	while (!counter.IsDone())
+	{
+		// Help out instead of blocking, so a wait on a worker thread (or with zero workers) can't deadlock
+		Job* job = TryClaimJob();
+		if (job)
+		{
+			job->Execute();
+			SubmitCompleteJob(job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(m_finishedMutex);
+		unsigned int jobTypeMask = s_currentJobWorker ? s_currentJobWorker->m_jobTypeMask : m_generalJobTypeMask;
+		m_finishedCondition.wait(lock, [this, &counter, jobTypeMask] { return counter.IsDone() || GetNumQueuedJobs(jobTypeMask) > 0 || m_isShuttingDown; });
+		if (m_isShuttingDown) return;
+	}
 }
 
-Job* JobSystem::ClaimJob()
+Job* JobSystem::ClaimJob(unsigned int jobTypeMask)
 {
 	std::unique_lock<std::mutex> lock(m_queueMutex);
-	m_condition.wait(lock, [this] {return !m_queueJobs.empty() || m_isShuttingDown; });
+	Job* job = nullptr;
+	m_condition.wait(lock, [this, &job, jobTypeMask]
+	{
+		job = PopHighestPriorityJob(m_laneJobs, jobTypeMask, false);
+		return job != nullptr || m_isShuttingDown;
+	});
+	lock.unlock();
+
+	if (job)
+	{
+		OnJobClaimed(job);
+	}
+	return job;
+}
 
-	if (m_isShuttingDown && m_queueJobs.empty())
+Job* JobSystem::ClaimJobForWorker(JobWorker& worker)
+{
+	// Own queue first (most recently pushed job is the most likely to still be in cache)
+	Job* job = worker.PopLocalJob();
+
+	// Then try to steal the oldest job of every other worker, starting with the next one over so thieves spread out
+	int numWorkers = static_cast<int>(m_workers.size());
+	for (int offset = 1; job == nullptr && offset < numWorkers; offset++)
 	{
-		return nullptr;
+		JobWorker* victim = m_workers[(worker.m_jobWorkerID + offset) % numWorkers];
+		job = victim->StealLocalJob(worker.m_jobTypeMask);
 	}
 
-	if (!m_queueJobs.empty())
+	if (job)
 	{
-		Job* job = m_queueJobs.front();
-		m_queueJobs.pop_front();
-		job->m_state.store(JobStatus::EXECUTING);
+		OnJobClaimed(job);
+	}
+	return job;
+}
+
+Job* JobSystem::TryClaimJob()
+{
+	// Threads outside the job system only help with general work, never with a type a pool was reserved for
+	unsigned int jobTypeMask = s_currentJobWorker ? s_currentJobWorker->m_jobTypeMask : m_generalJobTypeMask;
+
+	Job* job = nullptr;
+	if (m_config.m_schedulerMode == JobSchedulerMode::WORK_STEALING && !m_workers.empty())
+	{
+		for (int workerIndex = 0; job == nullptr && workerIndex < static_cast<int>(m_workers.size()); workerIndex++)
 		{
-			std::lock_guard<std::mutex> executeLock(m_executingMutex);
-			m_executingJobs.emplace_back(job);
+			job = m_workers[workerIndex]->StealLocalJob(jobTypeMask);
 		}
-		return job;
 	}
-	return nullptr; // No Job found
+	else
+	{
+		std::lock_guard<std::mutex> lock(m_queueMutex);
+		job = PopHighestPriorityJob(m_laneJobs, jobTypeMask, false);
+	}
+
+	if (job)
+	{
+		OnJobClaimed(job);
+	}
+	return job;
 }
 
-Job* JobSystem::ClaimJobForWorker(JobWorker& worker)
+Job* JobSystem::PopHighestPriorityJob(JobQueue* lanes, unsigned int jobTypeMask, bool popNewest) const
 {
-	UNUSED(worker);
-	std::lock_guard<std::mutex> lock(m_queueMutex);
-	if (m_queueJobs.empty())
+	for (JobType type : m_config.m_lanePriority)
 	{
-		return nullptr;
+		JobQueue& lane = lanes[static_cast<int>(type)];
+		if (lane.IsEmpty() || (jobTypeMask & GetJobTypeBit(type)) == 0) continue;
+
+		return popNewest ? lane.PopBack() : lane.PopFront();
 	}
+	return nullptr;
+}
+
+void JobSystem::OnJobClaimed(Job* job)
+{
+	JobLaneCounters& counters = m_laneCounters[static_cast<int>(job->GetJobType())];
+	unsigned long long waitMicroseconds = static_cast<unsigned long long>(1000000.0 * (GetCurrentTimeSeconds() - job->m_readyTime));
+
+	m_numQueuedJobs--;
+	counters.m_numQueued--;
+	counters.m_numClaimed++;
+	counters.m_totalWaitMicroseconds += waitMicroseconds;
+	UpdateAtomicMax(counters.m_maxWaitMicroseconds, waitMicroseconds);
 
-	Job* job = m_queueJobs.front();
-	m_queueJobs.pop_front();
 	job->m_state.store(JobStatus::EXECUTING);
-	return job;
 }
 
 void JobSystem::RetrieveCompletedJob(Job* job)
 {
 	std::lock_guard<std::mutex> lock(m_completedMutex);
-	auto it = std::find(m_completedJobs.begin(), m_completedJobs.end(), job);
-	if (it != m_completedJobs.end())
+
+	// Only jobs linked into the completed list have a neighbour or are the head
+	if (job->m_prevCompletedJob == nullptr && m_firstCompletedJob != job) return;
+
+	if (job->m_prevCompletedJob)
 	{
-		job->m_state.store(JobStatus::RETRIEVED);
-		m_completedJobs.erase(it);
+		job->m_prevCompletedJob->m_nextCompletedJob = job->m_nextCompletedJob;
+	}
+	else
+	{
+		m_firstCompletedJob = job->m_nextCompletedJob;
+	}
+
+	if (job->m_nextCompletedJob)
+	{
+		job->m_nextCompletedJob->m_prevCompletedJob = job->m_prevCompletedJob;
+	}
+	else
+	{
+		m_lastCompletedJob = job->m_prevCompletedJob;
 	}
+
+	job->m_prevCompletedJob = nullptr;
+	job->m_nextCompletedJob = nullptr;
+	job->m_state.store(JobStatus::RETRIEVED);
 }
 
 Job* JobSystem::RetrieveCompletedJob()
 {
 	std::lock_guard<std::mutex> lock(m_completedMutex);
-	
-	while (!m_completedJobs.empty())
-	{
-		Job* job = m_completedJobs.front();
-		if (!job)
-		{
-			m_completedJobs.pop_front();
-			continue;
-		}
 
-		JobStatus jobState = job->m_state.load(); // load reads value in a thread-safe way 
+	Job* job = m_firstCompletedJob;
+	if (!job) return nullptr;
 
-		if (job->m_state == JobStatus::NEW || static_cast<int>(jobState) < 0)
-		{
-			m_completedJobs.pop_front();
-			continue;
-		}
-
-		m_completedJobs.pop_front();
-		job->m_state.store(JobStatus::RETRIEVED);
-		return job;
+	m_firstCompletedJob = job->m_nextCompletedJob;
+	if (m_firstCompletedJob)
+	{
+		m_firstCompletedJob->m_prevCompletedJob = nullptr;
+	}
+	else
+	{
+		m_lastCompletedJob = nullptr;
 	}
 
-	return nullptr;
+	job->m_nextCompletedJob = nullptr;
+	job->m_state.store(JobStatus::RETRIEVED);
+	return job;
 }
 
 void JobSystem::RetrieveCompletedJobs(std::vector<Job*>& outJobs, int maxJobs)
 {
 	std::lock_guard<std::mutex> lock(m_completedMutex);
 
-	for (int i = 0; i < maxJobs && !m_completedJobs.empty(); i++)
+	for (int i = 0; i < maxJobs && m_firstCompletedJob; i++)
+	{
+		Job* job = m_firstCompletedJob;
+		m_firstCompletedJob = job->m_nextCompletedJob;
+		job->m_nextCompletedJob = nullptr;
+		job->m_state.store(JobStatus::RETRIEVED);
+		outJobs.emplace_back(job);
+	}
+
+	if (m_firstCompletedJob)
+	{
+		m_firstCompletedJob->m_prevCompletedJob = nullptr;
+	}
+	else
 	{
-		outJobs.emplace_back(m_completedJobs.front());
-		m_completedJobs.pop_front();
+		m_lastCompletedJob = nullptr;
 	}
 }
 
 void JobSystem::SubmitCompleteJob(Job* job)
 {
+	// Read everything we need up front. Once the job is in the completed list (or its counter hits zero) its owner may delete it
+	JobCounter* counter = job->m_counter;
+	bool isRetrievable = job->m_isRetrievable;
+
+	std::vector<Job*> readyDependents;
 	{
-		std::lock_guard<std::mutex> executeLock(m_executingMutex);
-		auto it = std::find(m_executingJobs.begin(), m_executingJobs.end(), job);
-		if (it != m_executingJobs.end())
+		std::lock_guard<std::mutex> dependentsLock(job->m_dependentsMutex);
+		job->m_areDependentsReleased = true;
+		job->m_numUnmetDependencies.store(1); // Restore the queue hold so the job can be queued again
+		readyDependents.swap(job->m_dependents);
+	}
+
+	for (Job* dependent : readyDependents)
+	{
+		if (--dependent->m_numUnmetDependencies == 0)
 		{
-			m_executingJobs.erase(it);
+			EnqueueReadyJob(dependent);
 		}
 	}
+
+	if (isRetrievable)
 	{
+		// COMPLETED goes out together with the link, an owner polling the state must find the job in the list when it retrieves it
 		std::lock_guard<std::mutex> completedLock(m_completedMutex);
 		job->m_state.store(JobStatus::COMPLETED);
-		m_completedJobs.emplace_back(job);
+		job->m_prevCompletedJob = m_lastCompletedJob;
+		job->m_nextCompletedJob = nullptr;
+		if (m_lastCompletedJob)
+		{
+			m_lastCompletedJob->m_nextCompletedJob = job;
+		}
+		else
+		{
+			m_firstCompletedJob = job;
+		}
+		m_lastCompletedJob = job;
+	}
+	else
+	{
+		job->m_state.store(JobStatus::COMPLETED);
+		if (job->m_isCreatedByJobSystem)
+		{
+			// Nobody will retrieve it, so hand the slot back now (before the counter releases a waiter that might tear the system down)
+			ReleaseJob(job);
+		}
+	}
+
+	bool counterFinished = counter && (--counter->m_count == 0);
+	bool allFinished = (--m_numUnfinishedJobs == 0);
+	if (counterFinished || allFinished)
+	{
+		// Lock so a waiter can't check the count and then miss this notify
+		std::lock_guard<std::mutex> finishedLock(m_finishedMutex);
+		m_finishedCondition.notify_all();
 	}
 }
 
+void JobSystem::ReleaseJob(Job* job)
+{
+	if (!job) return;
+
+	if (!job->m_isCreatedByJobSystem || !IsInJobPool(job))
+	{
+		delete job;
+		return;
+	}
+
+	int slotIndex = static_cast<int>(reinterpret_cast<JobPoolSlot*>(job) - m_jobPoolSlots.data());
+	job->m_state.store(JobStatus::RELEASED); // std::atomic destructs trivially, so this stays readable until CreateJob reuses the slot
+	job->~Job();
+
+	std::lock_guard<std::mutex> lock(m_jobPoolMutex);
+	m_freeJobPoolSlots.emplace_back(slotIndex);
+}
+
+JobPoolStats JobSystem::GetJobPoolStats() const
+{
+	std::lock_guard<std::mutex> lock(m_jobPoolMutex);
+
+	JobPoolStats stats;
+	stats.m_capacity = static_cast<int>(m_jobPoolSlots.size());
+	stats.m_numInUse = stats.m_capacity - static_cast<int>(m_freeJobPoolSlots.size());
+	stats.m_peakInUse = m_peakJobPoolSlotsInUse;
+	stats.m_numOverflowAllocations = m_numJobPoolOverflows.load();
+	return stats;
+}
+
+void* JobSystem::AllocateJobPoolSlot()
+{
+	std::lock_guard<std::mutex> lock(m_jobPoolMutex);
+	if (m_freeJobPoolSlots.empty()) return nullptr;
+
+	int slotIndex = m_freeJobPoolSlots.back();
+	m_freeJobPoolSlots.pop_back();
+
+	int numInUse = static_cast<int>(m_jobPoolSlots.size() - m_freeJobPoolSlots.size());
+	if (numInUse > m_peakJobPoolSlotsInUse)
+	{
+		m_peakJobPoolSlotsInUse = numInUse;
+	}
+	return &m_jobPoolSlots[slotIndex];
+}
+
+bool JobSystem::IsInJobPool(Job const* job) const
+{
+	if (m_jobPoolSlots.empty()) return false;
+
+	unsigned char const* address = reinterpret_cast<unsigned char const*>(job);
+	unsigned char const* poolBegin = reinterpret_cast<unsigned char const*>(m_jobPoolSlots.data());
+	unsigned char const* poolEnd = poolBegin + m_jobPoolSlots.size() * sizeof(JobPoolSlot);
+	return address >= poolBegin && address < poolEnd;
+}
+
 void JobSystem::CreateWorkers(int numWorkers)
 {
+	int firstNewWorker = static_cast<int>(m_workers.size());
 	for (int i = 0; i < numWorkers; i++)
 	{
-		JobWorker* newWorker = new JobWorker(i, this);
+		JobWorker* newWorker = new JobWorker(static_cast<int>(m_workers.size()), this, m_generalJobTypeMask);
 		m_workers.emplace_back(newWorker);
 	}
+
+	for (JobWorkerPoolConfig const& pool : m_config.m_workerPools)
+	{
+		for (int i = 0; i < pool.m_numWorkers; i++)
+		{
+			JobWorker* newWorker = new JobWorker(static_cast<int>(m_workers.size()), this, pool.m_jobTypeMask);
+			m_workers.emplace_back(newWorker);
+		}
+	}
+
+	for (int lane = 0; lane < NUM_JOB_TYPES; lane++)
+	{
+		std::vector<JobWorker*>& laneWorkers = m_workersByJobType[lane];
+		laneWorkers.clear();
+		for (JobWorker* worker : m_workers)
+		{
+			if (worker->CanRunJobType(static_cast<JobType>(lane)))
+			{
+				laneWorkers.emplace_back(worker);
+			}
+		}
+
+		// A type nobody may run would sit in its lane forever, so let every worker take it instead
+		if (laneWorkers.empty())
+		{
+			for (JobWorker* worker : m_workers)
+			{
+				worker->m_jobTypeMask |= GetJobTypeBit(static_cast<JobType>(lane));
+			}
+			laneWorkers = m_workers;
+		}
+	}
+
+	// Threads only start once every worker exists, so stealing never reads a half built worker list
+	for (int i = firstNewWorker; i < static_cast<int>(m_workers.size()); i++)
+	{
+		m_workers[i]->m_thread = new std::thread(&JobWorker::ThreadMain, m_workers[i]);
+	}
 }
 
 void JobSystem::DeleteWorkers()
 {
 	m_isShuttingDown = true;
+	{
+		std::lock_guard<std::mutex> lock(m_queueMutex);
+	}
 	m_condition.notify_all(); // Notify all waiting threads
 
+	for (JobWorker* worker : m_workers)
+	{
+		worker->Wake();
+	}
+
+	{
+		std::lock_guard<std::mutex> finishedLock(m_finishedMutex);
+	}
+	m_finishedCondition.notify_all(); // Release anyone blocked in WaitForCounter
+
 	for (JobWorker* worker : m_workers)
 	{
 		if (worker->m_thread->joinable())
 		{
 			worker->m_thread->join();
 		}
+		delete worker->m_thread;
 		delete worker;
 		worker = nullptr;
 	}
 	m_workers.clear();
+	for (std::vector<JobWorker*>& laneWorkers : m_workersByJobType)
+	{
+		laneWorkers.clear();
+	}
 }
 
 int JobSystem::GetNumQueuedJobs() const
 {
-	std::lock_guard<std::mutex> lock(m_queueMutex);
-	return static_cast<int>(m_queueJobs.size());
+	return m_numQueuedJobs.load();
+}
+
+int JobSystem::GetNumQueuedJobs(unsigned int jobTypeMask) const
+{
+	int numQueued = 0;
+	for (int lane = 0; lane < NUM_JOB_TYPES; lane++)
+	{
+		if (jobTypeMask & GetJobTypeBit(static_cast<JobType>(lane)))
+		{
+			numQueued += m_laneCounters[lane].m_numQueued.load();
+		}
+	}
+	return numQueued;
+}
+
+JobLaneStats JobSystem::GetLaneStats(JobType type) const
+{
+	JobLaneCounters const& counters = m_laneCounters[static_cast<int>(type)];
+
+	JobLaneStats stats;
+	stats.m_type = type;
+	stats.m_numQueued = counters.m_numQueued.load();
+	stats.m_peakQueued = counters.m_peakQueued.load();
+	stats.m_numEnqueued = counters.m_numEnqueued.load();
+	stats.m_numClaimed = counters.m_numClaimed.load();
+	stats.m_averageWaitMs = (stats.m_numClaimed > 0) ? 0.001 * static_cast<double>(counters.m_totalWaitMicroseconds.load()) / static_cast<double>(stats.m_numClaimed) : 0.0;
+	stats.m_maxWaitMs = 0.001 * static_cast<double>(counters.m_maxWaitMicroseconds.load());
+	return stats;
+}
+
+void JobSystem::ResetLaneStats()
+{
+	for (JobLaneCounters& counters : m_laneCounters)
+	{
+		counters.m_peakQueued.store(counters.m_numQueued.load());
+		counters.m_numEnqueued.store(0);
+		counters.m_numClaimed.store(0);
+		counters.m_totalWaitMicroseconds.store(0);
+		counters.m_maxWaitMicroseconds.store(0);
+	}
+}
+
+JobWorker* JobSystem::GetWorkerForNewJob(JobType type)
+{
+	// Jobs queued from inside a job stay on that worker's queue, everything else is dealt out round robin to the workers allowed to run it
+	if (s_currentJobWorker && s_currentJobWorker->m_jobSystem == this && s_currentJobWorker->CanRunJobType(type))
+	{
+		return s_currentJobWorker;
+	}
+
+	std::vector<JobWorker*> const& laneWorkers = m_workersByJobType[static_cast<int>(type)];
+	unsigned int workerIndex = m_nextWorkerIndex++ % static_cast<unsigned int>(laneWorkers.size());
+	return laneWorkers[workerIndex];
 }
 
-JobWorker::JobWorker(int id, JobSystem* jobSystem)
-	: m_jobWorkerID(id), m_jobSystem(jobSystem)
+void JobSystem::WakeWorkerToSteal(JobType type, JobWorker const* alreadyWoken)
+{
+	if (m_numParkedWorkers.load() == 0) return;
+
+	for (JobWorker* worker : m_workersByJobType[static_cast<int>(type)])
+	{
+		if (worker != alreadyWoken && worker->IsParked())
+		{
+			worker->Wake();
+			return;
+		}
+	}
+}
+
+JobSystemBenchmarkResult JobSystem::RunThroughputBenchmark(JobSchedulerMode mode, int numWorkers, int numJobs, int workPerJob)
+{
+	class BenchmarkJob : public Job
+	{
+	public:
+		BenchmarkJob(int workPerJob) : Job(JobType::GENERIC), m_workPerJob(workPerJob) {}
+
+		void Execute() override
+		{
+			unsigned int value = 0;
+			for (int i = 0; i < m_workPerJob; i++)
+			{
+				value = value * 1664525u + 1013904223u;
+			}
+			m_result = value;
+		}
+
+		int m_workPerJob = 0;
+		unsigned int m_result = 0;
+	};
+
+	JobSystemConfig config;
+	config.m_numWorkers = numWorkers;
+	config.m_schedulerMode = mode;
+	config.m_jobPoolCapacity = numJobs;
+	JobSystem jobSystem(config);
+	jobSystem.CreateWorkers(numWorkers);
+
+	// Pool jobs that release themselves on completion, so the timed part is the same path a steady state frame takes
+	std::vector<BenchmarkJob*> jobs;
+	jobs.reserve(numJobs);
+	for (int i = 0; i < numJobs; i++)
+	{
+		BenchmarkJob* job = jobSystem.CreateJob<BenchmarkJob>(workPerJob);
+		job->m_isRetrievable = false;
+		jobs.emplace_back(job);
+	}
+
+	double timeBefore = GetCurrentTimeSeconds();
+	for (BenchmarkJob* job : jobs)
+	{
+		jobSystem.QueueJob(job);
+	}
+	jobSystem.WaitForAllJobsToFinish();
+	double timeAfter = GetCurrentTimeSeconds();
+
+	JobSystemBenchmarkResult result;
+	result.m_schedulerMode = mode;
+	result.m_numWorkers = jobSystem.GetNumWorkers();
+	result.m_numJobs = numJobs;
+	result.m_secondsElapsed = timeAfter - timeBefore;
+	result.m_jobsPerSecond = (result.m_secondsElapsed > 0.0) ? static_cast<double>(numJobs) / result.m_secondsElapsed : 0.0;
+	return result;
+}
+
+bool JobSystem::Command_JobSystemBenchmark(EventArgs& args)
+{
+	int numWorkers = std::max(1, args.GetValue("workers", static_cast<int>(std::thread::hardware_concurrency()) - 1));
+	int numJobs = std::max(1, args.GetValue("jobs", 2000));
+	int workPerJob = std::max(0, args.GetValue("work", 1000));
+
+	JobSchedulerMode modes[] = { JobSchedulerMode::GLOBAL_QUEUE, JobSchedulerMode::WORK_STEALING };
+	for (JobSchedulerMode mode : modes)
+	{
+		JobSystemBenchmarkResult result = RunThroughputBenchmark(mode, numWorkers, numJobs, workPerJob);
+		char const* modeName = (mode == JobSchedulerMode::GLOBAL_QUEUE) ? "Global queue" : "Work stealing";
+		g_theConsole->AddLine(Rgba8::LIGHT_ORANGE, Stringf("%s: %i jobs on %i workers in %.02f ms (%.0f jobs/sec)", modeName, result.m_numJobs, result.m_numWorkers, 1000.0 * result.m_secondsElapsed, result.m_jobsPerSecond));
+	}
+	return true;
+}
+
+bool JobSystem::Command_JobSystemLaneStats(EventArgs& args)
+{
+	if (!g_theJobSystem) return false;
+
+	for (JobType type : g_theJobSystem->m_config.m_lanePriority)
+	{
+		JobLaneStats stats = g_theJobSystem->GetLaneStats(type);
+		g_theConsole->AddLine(Rgba8::LIGHT_ORANGE, Stringf("%-10s queued %i (peak %i), claimed %llu of %llu, wait avg %.03f ms max %.03f ms", GetJobTypeName(type), stats.m_numQueued, stats.m_peakQueued, stats.m_numClaimed, stats.m_numEnqueued, stats.m_averageWaitMs, stats.m_maxWaitMs));
+	}
+
+	if (args.GetValue<std::string>("reset", "false") == "true")
+	{
+		g_theJobSystem->ResetLaneStats();
+	}
+	return true;
+}
+
+void Job::AddDependency(Job* prerequisite)
+{
+	GUARANTEE_OR_DIE(prerequisite->m_state.load() != JobStatus::RELEASED, "Job::AddDependency on a prerequisite that was already released back to the job pool");
+
+	std::lock_guard<std::mutex> lock(prerequisite->m_dependentsMutex);
+	if (prerequisite->m_areDependentsReleased) return; // Already done, nothing to wait for
+
+	prerequisite->m_dependents.emplace_back(this);
+	m_numUnmetDependencies++;
+}
+
+void Job::SetCounter(JobCounter* counter)
+{
+	m_counter = counter;
+	if (m_counter)
+	{
+		m_counter->m_count++;
+	}
+}
+
+JobWorker::JobWorker(int id, JobSystem* jobSystem, unsigned int jobTypeMask)
+	: m_jobWorkerID(id), m_jobTypeMask(jobTypeMask), m_jobSystem(jobSystem)
 {
-	m_thread = new std::thread(&JobWorker::ThreadMain, this);
 }
 
 void JobWorker::ThreadMain()
 {
+	s_currentJobWorker = this;
+	bool isWorkStealing = (m_jobSystem->m_config.m_schedulerMode == JobSchedulerMode::WORK_STEALING);
+
 	while (!m_jobSystem->m_isShuttingDown)
 	{
-		Job* jobToExecute = m_jobSystem->ClaimJob();
+		Job* jobToExecute = isWorkStealing ? m_jobSystem->ClaimJobForWorker(*this) : m_jobSystem->ClaimJob(m_jobTypeMask);
 		if (jobToExecute)
 		{
 			jobToExecute->Execute();
 			m_jobSystem->SubmitCompleteJob(jobToExecute);
 		}
+		else if (isWorkStealing)
+		{
+			Park();
+		}
 		else
 		{
 			std::this_thread::yield();
 		}
 	}
-}
\ No newline at end of file
+}
+
+void JobWorker::PushLocalJob(Job* job)
+{
+	std::lock_guard<std::mutex> lock(m_localMutex);
+	m_localJobs[static_cast<int>(job->GetJobType())].PushBack(job);
+}
+
+Job* JobWorker::PopLocalJob()
+{
+	std::lock_guard<std::mutex> lock(m_localMutex);
+	return m_jobSystem->PopHighestPriorityJob(m_localJobs, m_jobTypeMask, true);
+}
+
+Job* JobWorker::StealLocalJob(unsigned int jobTypeMask)
+{
+	std::lock_guard<std::mutex> lock(m_localMutex);
+	return m_jobSystem->PopHighestPriorityJob(m_localJobs, jobTypeMask, false);
+}
+
+void JobWorker::Park()
+{
+	std::unique_lock<std::mutex> lock(m_parkMutex);
+	m_isParked.store(true);
+	m_jobSystem->m_numParkedWorkers++;
+
+	// Re-check after announcing we are parked. A job queued before this point is seen here, a job queued after it will see us parked
+	if (m_jobSystem->GetNumQueuedJobs(m_jobTypeMask) == 0)
+	{
+		m_parkCondition.wait(lock, [this] { return m_hasWakeSignal || m_jobSystem->m_isShuttingDown; });
+	}
+
+	m_hasWakeSignal = false;
+	m_jobSystem->m_numParkedWorkers--;
+	m_isParked.store(false);
+}
+
+void JobWorker::Wake()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_parkMutex);
+		m_hasWakeSignal = true;
+	}
+	m_parkCondition.notify_one();
+}
+
+void JobQueue::PushBack(Job* job)
+{
+	if (m_count == static_cast<int>(m_jobs.size()))
+	{
+		Grow();
+	}
+	m_jobs[(m_head + m_count) % m_jobs.size()] = job;
+	m_count++;
+}
+
+Job* JobQueue::PopFront()
+{
+	if (m_count == 0) return nullptr;
+
+	Job* job = m_jobs[m_head];
+	m_head = (m_head + 1) % static_cast<int>(m_jobs.size());
+	m_count--;
+	return job;
+}
+
+Job* JobQueue::PopBack()
+{
+	if (m_count == 0) return nullptr;
+
+	m_count--;
+	return m_jobs[(m_head + m_count) % m_jobs.size()];
+}
+
+void JobQueue::Grow()
+{
+	// Unwrap into the new buffer so the oldest job sits at index 0 again
+	std::vector<Job*> grownJobs(m_jobs.empty() ? 64 : m_jobs.size() * 2, nullptr);
+	for (int i = 0; i < m_count; i++)
+	{
+		grownJobs[i] = m_jobs[(m_head + i) % m_jobs.size()];
+	}
+	m_jobs.swap(grownJobs);
+	m_head = 0;
+}
@@ -1,10 +1,15 @@
 #pragma once
+#include "Engine/Core/EventSystem.hpp"
 #include <condition_variable>
 #include <atomic>
 #include <mutex>
 #include <deque>
 #include <vector>
 #include <thread>
+#include <new>
+#include <utility>
+#include <type_traits>
+#include <cstddef>
 
 class Job;
 class JobWorker;
@@ -18,20 +23,121 @@ enum class JobType
 	AUDIO,        // Audio processing jobs
 	NETWORKING,   // Network-related tasks (e.g., sending/receiving data)
 	IO,           // File reading/writing jobs
+	COUNT
 };
 
+constexpr int NUM_JOB_TYPES = static_cast<int>(JobType::COUNT);
+constexpr size_t JOB_POOL_SLOT_SIZE = 256; // Bytes per pooled job, Job itself plus whatever the subclass or lambda captures
+constexpr unsigned int ALL_JOB_TYPES_MASK = (1u << NUM_JOB_TYPES) - 1u;
+
+inline unsigned int GetJobTypeBit(JobType type) { return 1u << static_cast<unsigned int>(type); }
+char const* GetJobTypeName(JobType type);
+
 enum class JobStatus
 {
 	NEW, // Constructed by the main thread
 	QUEUE, // Owned by the Job System, waiting to be claimed by a worker
 	EXECUTING, // Claimed & owned by worker who is executing it
 	COMPLETED, // Completed & placed in list for main thread to retrieve
-	RETRIEVED // Only the main thread controls everything. The main thread retrieves the jobs retired from the Job System
+	RETRIEVED, // Only the main thread controls everything. The main thread retrieves the jobs retired from the Job System
+	RELEASED // Pooled job handed back by ReleaseJob, its slot may be reused at any time
+};
+
+enum class JobSchedulerMode
+{
+	GLOBAL_QUEUE, // Every job goes through one shared queue guarded by a single mutex
+	WORK_STEALING // Every worker owns a queue and steals from the other workers when its own queue runs dry
+};
+
+// A group of workers reserved for some job types, e.g. two IO workers so a slow file load never holds up AI jobs
+struct JobWorkerPoolConfig
+{
+	int m_numWorkers = 0;
+	unsigned int m_jobTypeMask = 0; // OR of GetJobTypeBit() for every type this pool runs
 };
 
 struct JobSystemConfig
 {
-	int m_numWorkers = -1; // If negative, automatically creates 1 worker 
+	int m_numWorkers = -1; // If negative, automatically creates 1 worker
+	JobSchedulerMode m_schedulerMode = JobSchedulerMode::GLOBAL_QUEUE;
+	int m_jobPoolCapacity = 1024; // Jobs made with CreateJob beyond this many alive at once fall back to the heap
+
+	// Job types owned by a pool are only run by that pool's workers, the general workers take everything else
+	std::vector<JobWorkerPoolConfig> m_workerPools;
+
+	// Order workers check the lanes in, highest priority first
+	JobType m_lanePriority[NUM_JOB_TYPES] = { JobType::PHYSICS, JobType::AI, JobType::RENDERING, JobType::AUDIO, JobType::NETWORKING, JobType::GENERIC, JobType::IO };
+};
+
+// Snapshot of one lane, see JobSystem::GetLaneStats. Wait time is measured from a job becoming ready to a worker claiming it
+struct JobLaneStats
+{
+	JobType m_type = JobType::GENERIC;
+	int m_numQueued = 0;
+	int m_peakQueued = 0;
+	unsigned long long m_numEnqueued = 0;
+	unsigned long long m_numClaimed = 0;
+	double m_averageWaitMs = 0.0;
+	double m_maxWaitMs = 0.0;
+};
+
+struct JobLaneCounters
+{
+	std::atomic<int> m_numQueued = 0;
+	std::atomic<int> m_peakQueued = 0;
+	std::atomic<unsigned long long> m_numEnqueued = 0;
+	std::atomic<unsigned long long> m_numClaimed = 0;
+	std::atomic<unsigned long long> m_totalWaitMicroseconds = 0;
+	std::atomic<unsigned long long> m_maxWaitMicroseconds = 0;
+};
+
+// Counts outstanding jobs so a thread can wait on just that group instead of on the whole job system
+class JobCounter
+{
+public:
+	JobCounter() = default;
+	JobCounter(JobCounter const& copy) = delete;
+
+	bool IsDone() const { return m_count.load() == 0; }
+	int GetCount() const { return m_count.load(); }
+
+	std::atomic<int> m_count = 0;
+};
+
+struct JobPoolStats
+{
+	int m_capacity = 0;
+	int m_numInUse = 0;
+	int m_peakInUse = 0;
+	int m_numOverflowAllocations = 0; // Jobs that didn't fit in a slot or found the pool full and went to the heap
+};
+
+// Growable ring buffer of jobs. Unlike std::deque it keeps its memory once warmed up, so steady state pushes never allocate
+class JobQueue
+{
+public:
+	bool IsEmpty() const { return m_count == 0; }
+	int GetSize() const { return m_count; }
+
+	void PushBack(Job* job);
+	Job* PopFront();
+	Job* PopBack();
+
+private:
+	void Grow();
+
+	std::vector<Job*> m_jobs;
+	int m_head = 0;
+	int m_count = 0;
+};
+
+struct JobSystemBenchmarkResult
+{
+	JobSchedulerMode m_schedulerMode = JobSchedulerMode::GLOBAL_QUEUE;
+	int m_numWorkers = 0;
+	int m_numJobs = 0;
+	double m_secondsElapsed = 0.0;
+	double m_jobsPerSecond = 0.0;
 };
 
 class JobSystem
@@ -46,33 +152,89 @@ public:
 	void EndFrame();
 
 	void QueueJob(Job* jobToQueue);
+	void QueueJob(Job* jobToQueue, std::vector<Job*> const& prerequisites); // Runs once every prerequisite has completed
 	void WaitForAllJobsToFinish();
-	Job* ClaimJob();
+	void WaitForCounter(JobCounter const& counter); // Executes queued jobs on the calling thread while it waits
+	Job* ClaimJob(unsigned int jobTypeMask = ALL_JOB_TYPES_MASK); // Blocks until a job of one of the masked types is queued
 	Job* ClaimJobForWorker(JobWorker& worker);
+	Job* TryClaimJob(); // Never blocks, returns nullptr if nothing the calling thread may run is queued
 	void RetrieveCompletedJob(Job* job);
 	Job* RetrieveCompletedJob();
 	void RetrieveCompletedJobs(std::vector<Job*>& outJobs, int maxJobs);
 	void SubmitCompleteJob(Job* job);
 
-	void CreateWorkers(int numWorkers);
-	void DeleteWorkers(); // Deconstructor calls this 
+	// Jobs made here live in the job pool. Retrievable ones must be handed back with ReleaseJob once retrieved, non-retrievable ones are released as soon as they complete
+	template <typename T_Job, typename... T_Args>
+	T_Job* CreateJob(T_Args&&... args);
+	template <typename T_Function>
+	Job* CreateLambdaJob(T_Function function, JobType type = JobType::GENERIC);
+	void ReleaseJob(Job* job);
+	JobPoolStats GetJobPoolStats() const;
+
+	void CreateWorkers(int numWorkers); // Also creates the workers of every pool in the config
+	void DeleteWorkers(); // Deconstructor calls this
 
 	int GetNumQueuedJobs() const;
+	int GetNumQueuedJobs(unsigned int jobTypeMask) const;
+	int GetNumWorkers() const { return static_cast<int>(m_workers.size()); }
+
+	JobLaneStats GetLaneStats(JobType type) const;
+	void ResetLaneStats();
+
+	// Splits [begin, end) into chunks of grainSize indexes, runs function(index) for each index across the workers and returns once all are done
+	template <typename T_Function>
+	void ParallelFor(int begin, int end, int grainSize, T_Function const& function, JobType type = JobType::GENERIC);
+
+	// Queues numJobs tiny jobs on a throw away job system using the given scheduler and times how long it takes to drain them
+	static JobSystemBenchmarkResult RunThroughputBenchmark(JobSchedulerMode mode, int numWorkers, int numJobs, int workPerJob);
+	static bool Command_JobSystemBenchmark(EventArgs& args);
+	static bool Command_JobSystemLaneStats(EventArgs& args);
+
+private:
+	friend class JobWorker;
+
+	void EnqueueReadyJob(Job* jobToQueue);
+	void OnJobClaimed(Job* job);
+	JobWorker* GetWorkerForNewJob(JobType type);
+	void WakeWorkerToSteal(JobType type, JobWorker const* alreadyWoken);
+	Job* PopHighestPriorityJob(JobQueue* lanes, unsigned int jobTypeMask, bool popNewest) const;
+	void* AllocateJobPoolSlot();
+	bool IsInJobPool(Job const* job) const;
 
 public:
 	std::atomic<bool> m_isShuttingDown = false;
 	std::condition_variable m_condition;
 
 	mutable std::mutex m_queueMutex;
-	mutable std::mutex m_executingMutex;
 	mutable std::mutex m_completedMutex;
 
-	std::vector<Job*> m_allJobs;
-	std::deque<Job*> m_queueJobs;
-	std::deque<Job*> m_executingJobs;
-	std::deque<Job*> m_completedJobs;
+	JobQueue m_laneJobs[NUM_JOB_TYPES]; // Global queue, one lane per job type
+
+	// Intrusive list through Job::m_prevCompletedJob / m_nextCompletedJob so retrieving a specific job is O(1)
+	Job* m_firstCompletedJob = nullptr;
+	Job* m_lastCompletedJob = nullptr;
+
+	struct alignas(alignof(std::max_align_t)) JobPoolSlot
+	{
+		unsigned char m_bytes[JOB_POOL_SLOT_SIZE];
+	};
+	std::vector<JobPoolSlot> m_jobPoolSlots;
+	std::vector<int> m_freeJobPoolSlots; // Stack of free slot indexes, reserved up front so it never reallocates
+	mutable std::mutex m_jobPoolMutex;
+	int m_peakJobPoolSlotsInUse = 0;
+	std::atomic<int> m_numJobPoolOverflows = 0;
+
+	std::atomic<int> m_numQueuedJobs = 0; // Jobs sitting in the global queue or in a worker queue
+	JobLaneCounters m_laneCounters[NUM_JOB_TYPES];
+	std::atomic<int> m_numUnfinishedJobs = 0; // Jobs queued or executing that have not been submitted as complete
+	std::atomic<int> m_numParkedWorkers = 0;
+	std::atomic<unsigned int> m_nextWorkerIndex = 0;
+	std::mutex m_finishedMutex;
+	std::condition_variable m_finishedCondition;
 
 	std::vector<JobWorker*> m_workers;
+	std::vector<JobWorker*> m_workersByJobType[NUM_JOB_TYPES]; // Workers allowed to run each type
+	unsigned int m_generalJobTypeMask = ALL_JOB_TYPES_MASK; // Types not owned by a pool
 	JobSystemConfig m_config;
 };
 
@@ -82,27 +244,188 @@ public:
 	Job(JobType type) : m_type(type) {}
 	Job() = default;
 	virtual ~Job() = default;
-	
+
 	virtual void Execute() = 0;
 
 	JobType GetJobType() const { return m_type; }
 
+	// Both must be called before this job is queued. The prerequisite may already be queued, executing or done, but the caller has to keep
+	// it alive until AddDependency returns: a completed prerequisite that was already retrieved and released or deleted can't be depended on
+	void AddDependency(Job* prerequisite);
+	void SetCounter(JobCounter* counter);
+
 	std::atomic<JobStatus> m_state = JobStatus::NEW;
+	bool m_isRetrievable = true; // False for jobs whose owner waits on a counter instead of retrieving them from the completed list
+
+private:
+	friend class JobSystem;
+
+	bool m_isCreatedByJobSystem = false; // Made by CreateJob, so it goes back through ReleaseJob rather than delete
+	Job* m_prevCompletedJob = nullptr;
+	Job* m_nextCompletedJob = nullptr;
+
+	JobType m_type = JobType::GENERIC;
+	JobCounter* m_counter = nullptr;
+	double m_readyTime = 0.0; // When the job entered a lane, for the lane wait time stats
+
+	std::atomic<int> m_numUnmetDependencies = 1; // Starts at 1 as a hold that QueueJob releases, so a job never runs before it is queued
+	std::mutex m_dependentsMutex;
+	std::vector<Job*> m_dependents; // Jobs waiting on this one to complete
+	bool m_areDependentsReleased = false; // Under m_dependentsMutex. Set once completion hands m_dependents off, so later AddDependency calls don't wait
+};
+
+// Runs a callable stored inside the job itself, so with CreateLambdaJob the captures live in the job pool slot
+template <typename T_Function>
+class LambdaJob : public Job
+{
+public:
+	LambdaJob(JobType type, T_Function&& function)
+		: Job(type), m_function(std::move(function))
+	{
+	}
+
+	void Execute() override { m_function(); }
 
 private:
-	JobType m_type;
+	T_Function m_function;
+};
+
+template <typename T_Function>
+class ParallelForJob : public Job
+{
+public:
+	ParallelForJob(JobType type, T_Function const* function, int begin, int end)
+		: Job(type), m_function(function), m_begin(begin), m_end(end)
+	{
+		m_isRetrievable = false;
+	}
+
+	void Execute() override
+	{
+		for (int index = m_begin; index < m_end; index++)
+		{
+			(*m_function)(index);
+		}
+	}
+
+private:
+	T_Function const* m_function = nullptr;
+	int m_begin = 0;
+	int m_end = 0;
 };
 
 class JobWorker
 {
 public:
-	JobWorker(int id, JobSystem* jobSystem);
+	JobWorker(int id, JobSystem* jobSystem, unsigned int jobTypeMask = ALL_JOB_TYPES_MASK);
 	void ThreadMain();
 
+	bool CanRunJobType(JobType type) const { return (m_jobTypeMask & GetJobTypeBit(type)) != 0; }
+
+	// Work stealing queue with one lane per job type. The owning worker pops from the back, other workers steal from the front
+	void PushLocalJob(Job* job);
+	Job* PopLocalJob();
+	Job* StealLocalJob(unsigned int jobTypeMask);
+
+	// Parking puts an idle worker to sleep until a job is queued for it or the system shuts down
+	void Park();
+	void Wake();
+	bool IsParked() const { return m_isParked.load(); }
+
 	friend class JobSystem;
 
 private:
 	int m_jobWorkerID;
+	unsigned int m_jobTypeMask = ALL_JOB_TYPES_MASK;
 	std::thread* m_thread = nullptr;
 	JobSystem* m_jobSystem = nullptr;
-};
\ No newline at end of file
+
+	std::mutex m_localMutex;
+	JobQueue m_localJobs[NUM_JOB_TYPES];
+
+	std::mutex m_parkMutex;
+	std::condition_variable m_parkCondition;
+	bool m_hasWakeSignal = false;
+	std::atomic<bool> m_isParked = false;
+};
+
+template <typename T_Function>
+void JobSystem::ParallelFor(int begin, int end, int grainSize, T_Function const& function, JobType type)
+{
+	if (end <= begin) return;
+	if (grainSize < 1) grainSize = 1;
+
+	int numChunks = (end - begin + grainSize - 1) / grainSize;
+	if (numChunks == 1 || m_workers.empty())
+	{
+		for (int index = begin; index < end; index++)
+		{
+			function(index);
+		}
+		return;
+	}
+
+	// Chunk jobs point at function on this stack frame, which is safe because we don't return until the counter reaches zero.
+	// They are non-retrievable pool jobs, so each one goes back to the pool the moment it completes
+	JobCounter counter;
+	for (int chunk = 1; chunk < numChunks; chunk++)
+	{
+		int chunkBegin = begin + chunk * grainSize;
+		int chunkEnd = (chunkBegin + grainSize < end) ? chunkBegin + grainSize : end;
+		ParallelForJob<T_Function>* chunkJob = CreateJob<ParallelForJob<T_Function>>(type, &function, chunkBegin, chunkEnd);
+		chunkJob->SetCounter(&counter);
+		QueueJob(chunkJob);
+	}
+
+	// The calling thread takes the first chunk itself rather than sitting idle
+	for (int index = begin; index < begin + grainSize; index++)
+	{
+		function(index);
+	}
+
+	WaitForCounter(counter);
+}
+
+// Runs on jobSystem when there is one, otherwise on the calling thread, for code that has to work before the job system starts up or without one
+template <typename T_Function>
+void ParallelForIfAvailable(JobSystem* jobSystem, int begin, int end, int grainSize, T_Function const& function, JobType type = JobType::GENERIC)
+{
+	if (jobSystem)
+	{
+		jobSystem->ParallelFor(begin, end, grainSize, function, type);
+		return;
+	}
+
+	for (int index = begin; index < end; index++)
+	{
+		function(index);
+	}
+}
+
+template <typename T_Job, typename... T_Args>
+T_Job* JobSystem::CreateJob(T_Args&&... args)
+{
+	static_assert(std::is_base_of<Job, T_Job>::value, "CreateJob can only make Job subclasses");
+	static_assert(alignof(T_Job) <= alignof(JobPoolSlot), "Job subclass is over aligned for the job pool");
+
+	void* slot = (sizeof(T_Job) <= JOB_POOL_SLOT_SIZE) ? AllocateJobPoolSlot() : nullptr;
+	T_Job* job = nullptr;
+	if (slot)
+	{
+		job = new (slot) T_Job(std::forward<T_Args>(args)...);
+	}
+	else
+	{
+		job = new T_Job(std::forward<T_Args>(args)...);
+		m_numJobPoolOverflows++;
+	}
+	job->m_isCreatedByJobSystem = true;
+	return job;
+}
+
+template <typename T_Function>
+Job* JobSystem::CreateLambdaJob(T_Function function, JobType type)
+{
+	static_assert(sizeof(LambdaJob<T_Function>) <= JOB_POOL_SLOT_SIZE, "Lambda captures too much to fit in a job pool slot, capture by reference or pointer instead");
+	return CreateJob<LambdaJob<T_Function>>(type, std::move(function));
+}
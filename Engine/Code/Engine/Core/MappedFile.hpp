@@ -0,0 +1,28 @@
+#pragma once
+#include <string>
+#include <cstdint>
+
+// Read only view of a whole file mapped into memory. Pages are read in by the OS the first time they are touched,
+// so opening costs the same for any file size and nothing is copied until the caller reads from GetData
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(MappedFile const&) = delete;
+	MappedFile& operator=(MappedFile const&) = delete;
+
+	bool Open(std::string const& filePath); // False when the file is missing or empty
+	void Close();
+
+	bool IsOpen() const { return m_data != nullptr; }
+	uint8_t const* GetData() const { return m_data; }
+	size_t GetSize() const { return m_size; }
+
+private:
+	void* m_fileHandle = nullptr;
+	void* m_mappingHandle = nullptr;
+	uint8_t const* m_data = nullptr;
+	size_t m_size = 0;
+};
@@ -1,6 +1,7 @@
 #pragma once
 #include "Engine/Core/XmlUtils.hpp"
 #include "Engine/Core/ErrorWarningAssert.hpp"
+#include <cstdlib>
 #include <map>
 #include <string>
 #include <typeinfo>
@@ -108,6 +109,27 @@ public:
 		return defaultValue;
 	}
 
+	// Console arguments are stored as strings, so an int is also read out of a string value. Anything that isn't a whole number gives defaultValue
+	int GetValue(const std::string& keyName, int defaultValue) const
+	{
+		auto found = m_keyValuePairs.find(keyName);
+		if (found == m_keyValuePairs.end() || !found->second) return defaultValue;
+
+		size_t type = found->second->GetTypeID();
+		if (type == TypeID<int>::Get())
+		{
+			return static_cast<TypeProperty<int>*>(found->second)->Get();
+		}
+		if (type == TypeID<std::string>::Get())
+		{
+			std::string text = static_cast<TypeProperty<std::string>*>(found->second)->Get();
+			char* textEnd = nullptr;
+			long value = strtol(text.c_str(), &textEnd, 10);
+			if (!text.empty() && *textEnd == '\0') return static_cast<int>(value);
+		}
+		return defaultValue;
+	}
+
 	bool HasArgument(const std::string& keyName) const { return m_keyValuePairs.find(keyName) != m_keyValuePairs.end(); }
 
 public:
@@ -7,10 +7,18 @@
 #include "Engine/Core/DevConsole.hpp"
 #include "Engine/Core/Time.hpp"
 #include "Engine/Core/ErrorWarningAssert.hpp"
+#include "Engine/Core/JobSystem.hpp"
+#include "Engine/Core/BufferWriter.hpp"
+#include "Engine/Core/BufferParser.hpp"
+#include "Engine/Core/FileUtils.hpp"
+#include "Engine/Core/MappedFile.hpp"
 #include "Engine/Math/MathUtils.hpp"
 #include "Engine/Math/RandomNumberGenerator.hpp"
 #include "Engine/Utilities/Prop.hpp"
 #include <algorithm>
+#include <cfloat>
+#include <cstring>
+#include <functional>
 #include <queue>
 
 extern Renderer* g_theRenderer;
@@ -20,26 +28,72 @@ NavMesh::~NavMesh()
 {
 	SafeDelete(m_solidVertexBuffer);
 	SafeDelete(m_wireVertexBuffer);
+	SafeDelete(m_navMeshIndexBuffer);
 	SafeDelete(m_bvhVertexBuffer);
 	SafeDelete(m_bvhIndexBuffer);
 	SafeDelete(m_heatmapVertexBuffer);
+	SafeDelete(m_bvhRoot);
 
 	m_heatmapVertexes.clear();
 	m_bvhIndexes.clear();
 	m_bvhVertexes.clear();
 	m_solidVerts.clear();
 	m_wireVerts.clear();
+	m_navMeshIndexes.clear();
 	m_triangles.clear();
+	m_triangleAreas.clear();
+}
+
+NavMeshQueryFilter::NavMeshQueryFilter()
+{
+	for (int area = 0; area < NAVMESH_MAX_AREAS; area++)
+	{
+		m_areaCosts[area] = 1.f;
+	}
+	m_areaCosts[static_cast<int>(NavMeshArea::Mud)] = 2.f;
+	m_areaCosts[static_cast<int>(NavMeshArea::Water)] = 4.f;
+	m_areaCosts[static_cast<int>(NavMeshArea::Danger)] = 8.f;
+}
+
+void NavMeshQueryFilter::SetAreaCost(uint8_t area, float cost)
+{
+	ASSERT_OR_DIE(area < NAVMESH_MAX_AREAS, "NavMesh area out of range");
+	m_areaCosts[area] = (cost < 1.f) ? 1.f : cost;
+}
+
+void NavMeshQueryFilter::IncludeArea(uint8_t area, bool isIncluded /*= true*/)
+{
+	ASSERT_OR_DIE(area < NAVMESH_MAX_AREAS, "NavMesh area out of range");
+	if (isIncluded) m_includeAreaMask |= (1u << area);
+	else m_includeAreaMask &= ~(1u << area);
+}
+
+void NavMeshQueryFilter::ExcludeArea(uint8_t area, bool isExcluded /*= true*/)
+{
+	ASSERT_OR_DIE(area < NAVMESH_MAX_AREAS, "NavMesh area out of range");
+	if (isExcluded) m_excludeAreaMask |= (1u << area);
+	else m_excludeAreaMask &= ~(1u << area);
+}
+
+void NavMeshQueryFilter::ResolveAreaCosts(float* outAreaCosts) const
+{
+	for (int area = 0; area < NAVMESH_MAX_AREAS; area++)
+	{
+		outAreaCosts[area] = PassesFilter(static_cast<uint8_t>(area)) ? m_areaCosts[area] : -1.f;
+	}
 }
 
 void NavMesh::CreateBuffers()
 {
-	m_solidVertexBuffer = g_theRenderer->CreateVertexBuffer(m_vertexes.size());
+	m_solidVertexBuffer = g_theRenderer->CreateVertexBuffer(m_solidVerts.size());
 	g_theRenderer->CopyCPUToGPU(m_solidVerts.data(), m_solidVerts.size() * sizeof(Vertex_PCU), m_solidVertexBuffer);
 	
-	m_wireVertexBuffer = g_theRenderer->CreateVertexBuffer(m_vertexes.size());
+	m_wireVertexBuffer = g_theRenderer->CreateVertexBuffer(m_wireVerts.size());
 	g_theRenderer->CopyCPUToGPU(m_wireVerts.data(), m_wireVerts.size() * sizeof(Vertex_PCU), m_wireVertexBuffer);
 
+	m_navMeshIndexBuffer = g_theRenderer->CreateIndexBuffer(m_navMeshIndexes.size());
+	g_theRenderer->CopyCPUToGPU(m_navMeshIndexes.data(), m_navMeshIndexes.size() * sizeof(unsigned int), m_navMeshIndexBuffer);
+
 	m_bvhVertexBuffer = g_theRenderer->CreateVertexBuffer(m_bvhVertexes.size());
 	g_theRenderer->CopyCPUToGPU(m_bvhVertexes.data(), m_bvhVertexes.size() * sizeof(Vertex_PCU), m_bvhVertexBuffer);
 
@@ -54,9 +108,23 @@ void NavMesh::CreateNavMesh(std::vector<Vec3>& vertexPoints, int mapWidth, int m
 {
 	double timeBefore = GetCurrentTimeSeconds();
 
+	// Areas go too, ComputeNeighbors only pads them out and would hand the old tags to the new triangle IDs
 	m_triangles.clear();
+	m_triangleAreas.clear();
 	m_vertexes.clear();
 
+	// Neighboring cells share their corner points, so each point is copied in once and every triangle touching it uses the same index
+	std::vector<int> weldedIndexes(vertexPoints.size(), -1);
+	auto getWeldedIndex = [&](int pointIndex)
+	{
+		if (weldedIndexes[pointIndex] == -1)
+		{
+			weldedIndexes[pointIndex] = static_cast<int>(m_vertexes.size());
+			m_vertexes.emplace_back(vertexPoints[pointIndex]);
+		}
+		return weldedIndexes[pointIndex];
+	};
+
 	for (int y = 0; y < mapHeight - 1; y++)
 	{
 		for (int x = 0; x < mapWidth - 1; x++)
@@ -73,169 +141,385 @@ void NavMesh::CreateNavMesh(std::vector<Vec3>& vertexPoints, int mapWidth, int m
 				continue;
 			}
 
-			// Map to valid vertex indices
-			int validBL = vertexMapping[BL];
-			int validBR = vertexMapping[BR];
-			int validTR = vertexMapping[TR];
-			int validTL = vertexMapping[TL];
-
-			// Add vertexes to store 
-			m_vertexes.emplace_back(vertexPoints[validBL]);
-			m_vertexes.emplace_back(vertexPoints[validBR]);
-			m_vertexes.emplace_back(vertexPoints[validTR]);
-
-			m_vertexes.emplace_back(vertexPoints[validTR]);
-			m_vertexes.emplace_back(vertexPoints[validTL]);
-			m_vertexes.emplace_back(vertexPoints[validBL]);
+			// Map to welded vertex indices
+			int weldedBL = getWeldedIndex(vertexMapping[BL]);
+			int weldedBR = getWeldedIndex(vertexMapping[BR]);
+			int weldedTR = getWeldedIndex(vertexMapping[TR]);
+			int weldedTL = getWeldedIndex(vertexMapping[TL]);
 
 			NavMeshTri triangleOne;
-			triangleOne.m_vertIndexes[0] = static_cast<int>(m_vertexes.size()) - 6;
-			triangleOne.m_vertIndexes[1] = static_cast<int>(m_vertexes.size()) - 5;
-			triangleOne.m_vertIndexes[2] = static_cast<int>(m_vertexes.size()) - 4;
+			triangleOne.m_vertIndexes[0] = weldedBL;
+			triangleOne.m_vertIndexes[1] = weldedBR;
+			triangleOne.m_vertIndexes[2] = weldedTR;
 
 			triangleOne.m_neighborTriIndexes[0] = -1;
 			triangleOne.m_neighborTriIndexes[1] = -1;
 			triangleOne.m_neighborTriIndexes[2] = -1;
 
 			m_triangles.emplace_back(triangleOne);
-			AddVertsFor3DTriangle(m_solidVerts, vertexPoints[validBL], vertexPoints[validBR], vertexPoints[validTR], Rgba8::ELECTRIC_BLUE_LIGHT);
-			AddVertsFor3DTriangle(m_wireVerts, vertexPoints[validBL], vertexPoints[validBR], vertexPoints[validTR], Rgba8::ELECTRIC_BLUE);
 
 			NavMeshTri triangleTwo;
-			triangleTwo.m_vertIndexes[0] = static_cast<int>(m_vertexes.size()) - 3;
-			triangleTwo.m_vertIndexes[1] = static_cast<int>(m_vertexes.size()) - 2;
-			triangleTwo.m_vertIndexes[2] = static_cast<int>(m_vertexes.size()) - 1;
+			triangleTwo.m_vertIndexes[0] = weldedTR;
+			triangleTwo.m_vertIndexes[1] = weldedTL;
+			triangleTwo.m_vertIndexes[2] = weldedBL;
 
 			triangleTwo.m_neighborTriIndexes[0] = -1;
 			triangleTwo.m_neighborTriIndexes[1] = -1;
 			triangleTwo.m_neighborTriIndexes[2] = -1;
 
 			m_triangles.emplace_back(triangleTwo);
-			AddVertsFor3DTriangle(m_solidVerts, vertexPoints[validTR], vertexPoints[validTL], vertexPoints[validBL], Rgba8::ELECTRIC_BLUE_LIGHT);
-			AddVertsFor3DTriangle(m_wireVerts, vertexPoints[validTR], vertexPoints[validTL], vertexPoints[validBL], Rgba8::ELECTRIC_BLUE);
 		}
 	}
+	BuildRenderVerts(Rgba8::ELECTRIC_BLUE_LIGHT, Rgba8::ELECTRIC_BLUE);
 
 	double timeAfter = GetCurrentTimeSeconds();
 	float msElapsed = 1000.f * float(timeAfter - timeBefore);
-	g_theConsole->AddLine(Rgba8::DARK_RED, Stringf("NavMesh generated with %i triangles in %.02f ms", static_cast<int>(m_triangles.size()), msElapsed));
+	g_theConsole->AddLine(Rgba8::DARK_RED, Stringf("NavMesh generated with %i triangles and %i vertexes in %.02f ms", static_cast<int>(m_triangles.size()), static_cast<int>(m_vertexes.size()), msElapsed));
 
 	double timeBeforeNeighbors = GetCurrentTimeSeconds();
-	ComputeNeighborsHashed();
+	ComputeNeighbors();
 	double timeAfterNeighbors = GetCurrentTimeSeconds();
 	float msElapsedNeighbors = 1000.f * float(timeAfterNeighbors - timeBeforeNeighbors);
 	g_theConsole->AddLine(Rgba8::DARK_GREEN, Stringf("ComputeNeighbors took %.02f ms", msElapsedNeighbors));
 
+	double timeBeforeBVH = GetCurrentTimeSeconds();
 	BuildBVH();
+	double timeAfterBVH = GetCurrentTimeSeconds();
+	float msElapsedBVH = 1000.f * float(timeAfterBVH - timeBeforeBVH);
+	g_theConsole->AddLine(Rgba8::DARK_GREEN, Stringf("Tree BVH built with %i nodes (%.02f KB) in %.02f ms", static_cast<int>(m_debugBVHBoxes.size()), static_cast<float>(GetBVHMemoryBytes()) / 1024.f, msElapsedBVH));
 	DrawAllBVH(m_bvhRoot, 0);
 
+	BuildFlatBVH();
+	RecarveDynamicObstacles();
+
 	ConstructHeatmap();
 }
 
-void NavMesh::ComputeNeighborsHashed()
+// Baked arrays are copied straight into the vectors, so the file layout has to be the in memory layout
+static_assert(sizeof(Vec3) == 3 * sizeof(float), "Baked NavMesh vertexes are three packed floats");
+static_assert(sizeof(NavMeshTri) == 6 * sizeof(int), "Baked NavMesh triangles are six packed ints");
+static_assert(sizeof(FlatBVHNode) == 2 * sizeof(Vec3) + 2 * sizeof(int), "Baked flat BVH nodes are two Vec3 and two ints");
+
+enum NavMeshBakedSection
 {
-	std::unordered_map<Vec3, std::vector<int>> vertexPosToTriangles;
+	NAVMESH_BAKED_VERTEXES,
+	NAVMESH_BAKED_TRIANGLES,
+	NAVMESH_BAKED_TRIANGLE_AREAS,
+	NAVMESH_BAKED_FLAT_BVH_NODES,
+	NAVMESH_BAKED_FLAT_BVH_TRIANGLE_INDEXES,
+	NAVMESH_BAKED_DISTANCE_FIELD,
+	NUM_NAVMESH_BAKED_SECTIONS
+};
+
+static constexpr uint32_t NAVMESH_BAKED_ELEMENT_SIZES[NUM_NAVMESH_BAKED_SECTIONS] = { sizeof(Vec3), sizeof(NavMeshTri), sizeof(uint8_t), sizeof(FlatBVHNode), sizeof(int), sizeof(float) };
+
+bool NavMesh::SaveBakedNavMesh(std::string const& filePath) const
+{
+	double timeBefore = GetCurrentTimeSeconds();
 
-	for (int triangleIndex = 0; triangleIndex < static_cast<int>(m_triangles.size()); triangleIndex++)
+	// Header: magic, version, element sizes, then a count and offset per section. Offsets are filled in once each section is written
+	std::vector<uint8_t> buffer;
+	BufferWriter writer(buffer);
+	for (int charIndex = 0; charIndex < 4; charIndex++)
 	{
-		for (int corner = 0; corner < 3; corner++)
+		writer.AppendChar(NAVMESH_BAKED_FILE_MAGIC[charIndex]);
+	}
+	writer.AppendUInt32(NAVMESH_BAKED_FILE_VERSION);
+	for (int section = 0; section < NUM_NAVMESH_BAKED_SECTIONS; section++)
+	{
+		writer.AppendUInt32(NAVMESH_BAKED_ELEMENT_SIZES[section]);
+	}
+	writer.AppendFloat(m_maxDistanceFieldCost);
+
+	uint32_t const counts[NUM_NAVMESH_BAKED_SECTIONS] =
+	{
+		static_cast<uint32_t>(m_vertexes.size()),
+		static_cast<uint32_t>(m_triangles.size()),
+		static_cast<uint32_t>(m_triangleAreas.size()),
+		static_cast<uint32_t>(m_flatBVHNodes.size()),
+		static_cast<uint32_t>(m_flatBVHTriangleIndexes.size()),
+		static_cast<uint32_t>(m_heatMap ? m_triangles.size() : 0)
+	};
+	size_t offsetPositions[NUM_NAVMESH_BAKED_SECTIONS];
+	for (int section = 0; section < NUM_NAVMESH_BAKED_SECTIONS; section++)
+	{
+		writer.AppendUInt32(counts[section]);
+		offsetPositions[section] = buffer.size();
+		writer.AppendUInt32(0);
+	}
+
+	auto beginSection = [&](int section)
+	{
+		while (buffer.size() % NAVMESH_BAKED_SECTION_ALIGNMENT != 0)
 		{
-			Vec3 const& vert = m_vertexes[m_triangles[triangleIndex].m_vertIndexes[corner]];
-			vertexPosToTriangles[vert].emplace_back(triangleIndex);
+			writer.AppendByte(0);
 		}
+		writer.OverwriteUInt32At(static_cast<uint32_t>(buffer.size()), offsetPositions[section]);
+	};
+
+	beginSection(NAVMESH_BAKED_VERTEXES);
+	for (Vec3 const& vertex : m_vertexes)
+	{
+		writer.AppendVec3(vertex);
 	}
 
-	for (int triangleIndex = 0; triangleIndex < static_cast<int>(m_triangles.size()); triangleIndex++)
+	beginSection(NAVMESH_BAKED_TRIANGLES);
+	for (NavMeshTri const& triangle : m_triangles)
+	{
+		for (int corner = 0; corner < 3; corner++) writer.AppendInt(triangle.m_vertIndexes[corner]);
+		for (int edge = 0; edge < 3; edge++) writer.AppendInt(triangle.m_neighborTriIndexes[edge]);
+	}
+
+	beginSection(NAVMESH_BAKED_TRIANGLE_AREAS);
+	for (uint8_t area : m_triangleAreas)
+	{
+		writer.AppendByte(area);
+	}
+
+	beginSection(NAVMESH_BAKED_FLAT_BVH_NODES);
+	for (FlatBVHNode const& node : m_flatBVHNodes)
+	{
+		writer.AppendVec3(node.m_mins);
+		writer.AppendVec3(node.m_maxs);
+		writer.AppendInt(node.m_firstIndex);
+		writer.AppendInt(node.m_numTriangles);
+	}
+
+	beginSection(NAVMESH_BAKED_FLAT_BVH_TRIANGLE_INDEXES);
+	for (int triangleIndex : m_flatBVHTriangleIndexes)
+	{
+		writer.AppendInt(triangleIndex);
+	}
+
+	beginSection(NAVMESH_BAKED_DISTANCE_FIELD);
+	for (int triangleIndex = 0; triangleIndex < static_cast<int>(counts[NAVMESH_BAKED_DISTANCE_FIELD]); triangleIndex++)
 	{
-		std::unordered_set<int> possibleNeighbors;
+		writer.AppendFloat(m_heatMap->GetValue(triangleIndex));
+	}
+
+	if (!FileUtils::FileWriteFromBuffer(buffer, filePath))
+	{
+		g_theConsole->AddLine(Rgba8::RED, Stringf("Could not write baked NavMesh to %s", filePath.c_str()));
+		return false;
+	}
+
+	double timeAfter = GetCurrentTimeSeconds();
+	float msElapsed = 1000.f * float(timeAfter - timeBefore);
+	g_theConsole->AddLine(Rgba8::DARK_GREEN, Stringf("Baked NavMesh written to %s (%.02f KB) in %.02f ms", filePath.c_str(), static_cast<float>(buffer.size()) / 1024.f, msElapsed));
+	return true;
+}
 
-		// Collect possible neighbors that share at least one vertex
-		for (int edgeVert = 0; edgeVert < 3; edgeVert++)
+// Every index in the baked arrays is checked against the array it points into, so a damaged file is rejected here instead of read out of bounds by every query
+static bool AreBakedNavMeshIndexesValid(int numVertexes, std::vector<NavMeshTri> const& triangles, std::vector<uint8_t> const& triangleAreas,
+	std::vector<FlatBVHNode> const& flatBVHNodes, std::vector<int> const& flatBVHTriangleIndexes)
+{
+	int numTriangles = static_cast<int>(triangles.size());
+	int numNodes = static_cast<int>(flatBVHNodes.size());
+	int numIndexes = static_cast<int>(flatBVHTriangleIndexes.size());
+	if (!triangleAreas.empty() && static_cast<int>(triangleAreas.size()) != numTriangles) return false;
+	if (numIndexes != ((numNodes > 0) ? numTriangles : 0)) return false;
+	if (numNodes == 0 && numTriangles > 0) return false;
+
+	for (NavMeshTri const& triangle : triangles)
+	{
+		for (int corner = 0; corner < 3; corner++)
 		{
-			const Vec3& vert = m_vertexes[m_triangles[triangleIndex].m_vertIndexes[edgeVert]];
-			auto found = vertexPosToTriangles.find(vert);
-			if (found != vertexPosToTriangles.end())
-			{
-				for (int neighborTri : found->second)
-				{
-					if (neighborTri != triangleIndex)
-					{
-						possibleNeighbors.insert(neighborTri);
-					}
-				}
-			}
+			if (triangle.m_vertIndexes[corner] < 0 || triangle.m_vertIndexes[corner] >= numVertexes) return false;
+			if (triangle.m_neighborTriIndexes[corner] < -1 || triangle.m_neighborTriIndexes[corner] >= numTriangles) return false;
 		}
+	}
+	for (uint8_t area : triangleAreas)
+	{
+		if (area >= NAVMESH_MAX_AREAS) return false;
+	}
+	for (int triangleIndex : flatBVHTriangleIndexes)
+	{
+		if (triangleIndex < 0 || triangleIndex >= numTriangles) return false;
+	}
+
+	// Children always come after their parent, so depths fill in front to back and a node can't lead back to itself.
+	// Nodes the root never reaches are never read
+	std::vector<int> nodeDepths(numNodes, -1);
+	if (numNodes > 0) nodeDepths[0] = 0;
+	for (int nodeIndex = 0; nodeIndex < numNodes; nodeIndex++)
+	{
+		if (nodeDepths[nodeIndex] < 0) continue;
 
-		// Check if exactly 2 vertices match (meaning they share an edge)
-		for (int neighborTri : possibleNeighbors)
+		FlatBVHNode const& node = flatBVHNodes[nodeIndex];
+		if (node.IsLeafNode())
 		{
-			int sharedVerts = 0;
-			for (int iVert = 0; iVert < 3; iVert++)
-			{
-				const Vec3& vertexA = m_vertexes[m_triangles[triangleIndex].m_vertIndexes[iVert]];
-				for (int jVert = 0; jVert < 3; jVert++)
-				{
-					const Vec3& vertexB = m_vertexes[m_triangles[neighborTri].m_vertIndexes[jVert]];
-					if (vertexA == vertexB)
-					{
-						sharedVerts++;
-					}
-				}
-			}
+			if (node.m_firstIndex < 0 || static_cast<int64_t>(node.m_firstIndex) + node.m_numTriangles > numIndexes) return false;
+			continue;
+		}
 
-			if (sharedVerts == 2)
-			{
-				// Find empty edge slot (-1) and store neighbor
-				for (int edge = 0; edge < 3; ++edge)
-				{
-					if (m_triangles[triangleIndex].m_neighborTriIndexes[edge] == -1)
-					{
-						m_triangles[triangleIndex].m_neighborTriIndexes[edge] = neighborTri;
-						break;
-					}
-				}
-			}
+		int childDepth = nodeDepths[nodeIndex] + 1;
+		if (node.m_firstIndex <= nodeIndex || node.m_firstIndex >= numNodes - 1 || childDepth > FLAT_BVH_MAX_DEPTH) return false; // Deeper would overflow the traversal stacks
+		for (int childIndex = node.m_firstIndex; childIndex <= node.m_firstIndex + 1; childIndex++)
+		{
+			if (nodeDepths[childIndex] < childDepth) nodeDepths[childIndex] = childDepth;
 		}
 	}
+	return true;
 }
 
-void NavMesh::ComputeNeighborsBruteForce()
+bool NavMesh::LoadBakedNavMesh(std::string const& filePath)
 {
-	for (size_t i = 0; i < m_triangles.size(); i++)
+	double timeBefore = GetCurrentTimeSeconds();
+
+	MappedFile file;
+	if (!file.Open(filePath)) return false;
+
+	// Magic, version, element sizes, distance field cost, then a count and offset per section
+	size_t const headerSize = 4 + sizeof(uint32_t) + NUM_NAVMESH_BAKED_SECTIONS * sizeof(uint32_t) + sizeof(float) + NUM_NAVMESH_BAKED_SECTIONS * 2 * sizeof(uint32_t);
+	if (file.GetSize() < headerSize) return false;
+
+	BufferParser parser(file.GetData(), file.GetSize());
+	for (int charIndex = 0; charIndex < 4; charIndex++)
+	{
+		if (parser.ParsePrimitive<char>() != NAVMESH_BAKED_FILE_MAGIC[charIndex]) return false;
+	}
+
+	uint32_t version = parser.ParsePrimitive<uint32_t>();
+	if (version != NAVMESH_BAKED_FILE_VERSION)
+	{
+		g_theConsole->AddLine(Rgba8::DARK_ORANGE, Stringf("Baked NavMesh %s is version %u, expected %u", filePath.c_str(), version, NAVMESH_BAKED_FILE_VERSION));
+		return false;
+	}
+
+	for (int section = 0; section < NUM_NAVMESH_BAKED_SECTIONS; section++)
+	{
+		if (parser.ParsePrimitive<uint32_t>() != NAVMESH_BAKED_ELEMENT_SIZES[section]) return false; // Baked by a build with a different layout
+	}
+	float maxDistanceFieldCost = parser.ParsePrimitive<float>();
+
+	uint32_t counts[NUM_NAVMESH_BAKED_SECTIONS];
+	uint8_t const* sectionData[NUM_NAVMESH_BAKED_SECTIONS];
+	for (int section = 0; section < NUM_NAVMESH_BAKED_SECTIONS; section++)
+	{
+		counts[section] = parser.ParsePrimitive<uint32_t>();
+		uint32_t offset = parser.ParsePrimitive<uint32_t>();
+		if (static_cast<uint64_t>(offset) + static_cast<uint64_t>(counts[section]) * NAVMESH_BAKED_ELEMENT_SIZES[section] > file.GetSize()) return false;
+		sectionData[section] = file.GetData() + offset;
+	}
+
+	// One copy per array straight out of the mapped pages, nothing is parsed element by element
+	auto copySection = [&](auto& outVector, int section)
 	{
-		for (size_t j = 0; j < m_triangles.size(); j++)
+		outVector.resize(counts[section]);
+		if (counts[section] > 0)
 		{
-			if (i == j) continue; // Skip self-comparison
+			std::memcpy(outVector.data(), sectionData[section], static_cast<size_t>(counts[section]) * NAVMESH_BAKED_ELEMENT_SIZES[section]);
+		}
+	};
+	// Into temporaries first, a rejected file leaves the current mesh as it was
+	std::vector<Vec3> vertexes;
+	std::vector<NavMeshTri> triangles;
+	std::vector<uint8_t> triangleAreas;
+	std::vector<FlatBVHNode> flatBVHNodes;
+	std::vector<int> flatBVHTriangleIndexes;
+	copySection(vertexes, NAVMESH_BAKED_VERTEXES);
+	copySection(triangles, NAVMESH_BAKED_TRIANGLES);
+	copySection(triangleAreas, NAVMESH_BAKED_TRIANGLE_AREAS);
+	copySection(flatBVHNodes, NAVMESH_BAKED_FLAT_BVH_NODES);
+	copySection(flatBVHTriangleIndexes, NAVMESH_BAKED_FLAT_BVH_TRIANGLE_INDEXES);
+	if (!AreBakedNavMeshIndexesValid(static_cast<int>(vertexes.size()), triangles, triangleAreas, flatBVHNodes, flatBVHTriangleIndexes))
+	{
+		g_theConsole->AddLine(Rgba8::DARK_ORANGE, Stringf("Baked NavMesh %s has section counts or indexes that don't line up, ignoring it", filePath.c_str()));
+		return false;
+	}
 
-			int sharedVerts = 0;
+	m_vertexes.swap(vertexes);
+	m_triangles.swap(triangles);
+	m_triangleAreas.swap(triangleAreas);
+	m_triangleAreas.resize(m_triangles.size(), static_cast<uint8_t>(NavMeshArea::Ground));
+	m_flatBVHNodes.swap(flatBVHNodes);
+	m_flatBVHTriangleIndexes.swap(flatBVHTriangleIndexes);
 
-			// Count how many vertices are shared between triangle i and triangle j
-			for (int triangleIVerts = 0; triangleIVerts < 3; triangleIVerts++)
-			{
-				for (int triangleJVerts = 0; triangleJVerts < 3; triangleJVerts++)
-				{
-					const Vec3& vertexI = m_vertexes[m_triangles[i].m_vertIndexes[triangleIVerts]];
-					const Vec3& vertexJ = m_vertexes[m_triangles[j].m_vertIndexes[triangleJVerts]];
+	// The tree BVH is only kept for debug drawing, a baked mesh goes without it
+	SafeDelete(m_bvhRoot);
+	m_debugBVHBoxes.clear();
+	m_bvhVertexes.clear();
+	m_bvhIndexes.clear();
+	m_currentBVHBoxIndex = 0;
 
-					if (vertexI == vertexJ)
-					{
-						sharedVerts++;
-					}
-				}
-			}
+	BuildRenderVerts(Rgba8::ELECTRIC_BLUE_LIGHT, Rgba8::ELECTRIC_BLUE);
+	RecarveDynamicObstacles();
 
-			// If two vertices are shared, they are neighbors
-			if (sharedVerts == 2)
-			{
-				for (int edgeA = 0; edgeA < 3; edgeA++)
-				{
-					if (m_triangles[i].m_neighborTriIndexes[edgeA] == -1)
-					{
-						m_triangles[i].m_neighborTriIndexes[edgeA] = static_cast<int>(j);
-						break; // Assign only one neighbor per edge
-					}
-				}
-			}
+	// An existing heat map is refilled rather than replaced, agents may be holding on to it
+	m_maxDistanceFieldCost = maxDistanceFieldCost;
+	if (!m_heatMap) m_heatMap = new NavMeshHeatMap(this);
+	if (counts[NAVMESH_BAKED_DISTANCE_FIELD] == counts[NAVMESH_BAKED_TRIANGLES])
+	{
+		m_heatMap->SetNumValues(static_cast<int>(counts[NAVMESH_BAKED_DISTANCE_FIELD]));
+		std::memcpy(m_heatMap->GetValueData(), sectionData[NAVMESH_BAKED_DISTANCE_FIELD], static_cast<size_t>(counts[NAVMESH_BAKED_DISTANCE_FIELD]) * sizeof(float));
+	}
+	else
+	{
+		PopulateDistanceField(*m_heatMap, m_maxDistanceFieldCost);
+	}
+	m_heatmapVertexes.clear(); // AddVertsForDebugDraw appends
+	m_heatmapVertexes.reserve(m_triangles.size() * 3);
+	m_heatMap->AddVertsForDebugDraw(m_heatmapVertexes, FloatRange(0.f, m_heatMap->GetHighestHeat()), Rgba8::RED, Rgba8::BANANA_YELLOW, -2.f, Rgba8::PURPLE);
+
+	double timeAfter = GetCurrentTimeSeconds();
+	float msElapsed = 1000.f * float(timeAfter - timeBefore);
+	g_theConsole->AddLine(Rgba8::DARK_GREEN, Stringf("Baked NavMesh loaded from %s with %i triangles and %i vertexes in %.02f ms", filePath.c_str(), GetNumTriangles(), static_cast<int>(m_vertexes.size()), msElapsed));
+	return true;
+}
+
+struct NavMeshEdge
+{
+	uint64_t m_vertPairKey = 0; // Smaller welded vertex index in the high half, larger in the low half
+	int m_triangleIndex = -1;
+	int m_edge = -1;
+};
+
+void NavMesh::ComputeNeighbors()
+{
+	m_triangleAreas.resize(m_triangles.size(), static_cast<uint8_t>(NavMeshArea::Ground));
+
+	// Every edge keyed by its two welded vertex indexes. Once sorted, the two sides of a shared edge sit next to each other
+	std::vector<NavMeshEdge> edges;
+	edges.reserve(m_triangles.size() * 3);
+	for (int triangleIndex = 0; triangleIndex < static_cast<int>(m_triangles.size()); triangleIndex++)
+	{
+		NavMeshTri& triangle = m_triangles[triangleIndex];
+		for (int edge = 0; edge < 3; edge++)
+		{
+			triangle.m_neighborTriIndexes[edge] = -1;
+
+			uint32_t vertA = static_cast<uint32_t>(triangle.m_vertIndexes[edge]);
+			uint32_t vertB = static_cast<uint32_t>(triangle.m_vertIndexes[(edge + 1) % 3]);
+			uint32_t minVert = (vertA < vertB) ? vertA : vertB;
+			uint32_t maxVert = (vertA < vertB) ? vertB : vertA;
+
+			NavMeshEdge navMeshEdge;
+			navMeshEdge.m_vertPairKey = (static_cast<uint64_t>(minVert) << 32) | maxVert;
+			navMeshEdge.m_triangleIndex = triangleIndex;
+			navMeshEdge.m_edge = edge;
+			edges.emplace_back(navMeshEdge);
+		}
+	}
+
+	std::sort(edges.begin(), edges.end(), [](NavMeshEdge const& a, NavMeshEdge const& b) { return a.m_vertPairKey < b.m_vertPairKey; });
+
+	int numEdges = static_cast<int>(edges.size());
+	int edgeIndex = 0;
+	while (edgeIndex < numEdges)
+	{
+		uint64_t vertPairKey = edges[edgeIndex].m_vertPairKey;
+		if (edgeIndex + 1 < numEdges && edges[edgeIndex + 1].m_vertPairKey == vertPairKey)
+		{
+			NavMeshEdge const& sideA = edges[edgeIndex];
+			NavMeshEdge const& sideB = edges[edgeIndex + 1];
+			m_triangles[sideA.m_triangleIndex].m_neighborTriIndexes[sideA.m_edge] = sideB.m_triangleIndex;
+			m_triangles[sideB.m_triangleIndex].m_neighborTriIndexes[sideB.m_edge] = sideA.m_triangleIndex;
+		}
+
+		// An edge shared by more than two triangles isn't walkable surface, only the first pair gets linked
+		while (edgeIndex < numEdges && edges[edgeIndex].m_vertPairKey == vertPairKey)
+		{
+			edgeIndex++;
 		}
 	}
 }
@@ -298,6 +582,7 @@ void NavMesh::RemoveRandomTriangleCluster()
 			{
 				// Copy the last triangle's data to the position of the removed triangle
 				m_triangles[triangleID] = m_triangles[lastIndex];
+				m_triangleAreas[triangleID] = m_triangleAreas[lastIndex];
 
 				// Update the neighbors of the last triangle to point to its new index
 				NavMeshTri& movedTriangle = m_triangles[triangleID];
@@ -320,207 +605,404 @@ void NavMesh::RemoveRandomTriangleCluster()
 
 			// Remove the last triangle from the array
 			m_triangles.pop_back();
+			m_triangleAreas.pop_back();
 		}
 	}
+
+	BuildFlatBVH(); // Triangle indexes moved
+	RecarveDynamicObstacles();
 }
 
 void NavMesh::RemoveTrianglesAffectedByProps(std::vector<Prop*>& props)
 {
 	if (props.empty()) return;
 
-	std::vector<size_t> trianglesToRemove;
 	float maxAgentRadius = 0.5f; // #ToDo change value if i change the maximum radius size of agents in the xml
 
-	// Iterate through all triangle in the NavMesh
-	for (size_t i = 0; i < m_triangles.size(); i++) 
+	// Props are carved as dynamic obstacles, so triangle indexes don't move and the props can be moved or removed later
+	for (Prop const* prop : props)
 	{
-		NavMeshTri& triangle = m_triangles[i];
+		AddDynamicObstacle(prop, maxAgentRadius);
+	}
+
+	RebuildNavMeshVerts();
+}
 
-		Vec3 v0 = m_vertexes[triangle.m_vertIndexes[0]];
-		Vec3 v1 = m_vertexes[triangle.m_vertIndexes[1]];
-		Vec3 v2 = m_vertexes[triangle.m_vertIndexes[2]];
+int NavMesh::AddDynamicObstacle(Prop const* prop, float agentRadius)
+{
+	if (!prop) return -1;
 
-		// Check if the triangle is blocked by any prop
-		bool isBlocked = false;
-		for (const Prop* prop : props) 
+	int obstacleID = -1;
+	for (int slot = 0; slot < static_cast<int>(m_obstacles.size()); slot++)
+	{
+		if (m_obstacles[slot].m_prop == nullptr)
 		{
-			if (prop->IsTriangleBlockedByAABB3D(v0, v1, v2, maxAgentRadius) || 
-				prop->IsTriangleBlockedByCylinder3D(v0, v1, v2, maxAgentRadius)) 
-			{
-				isBlocked = true;
-				break;
-			}
+			obstacleID = slot;
+			break;
 		}
+	}
+	if (obstacleID == -1)
+	{
+		obstacleID = static_cast<int>(m_obstacles.size());
+		m_obstacles.emplace_back();
+	}
 
-		if (isBlocked)
-		{
-			for (int edge = 0; edge < 3; edge++)
-			{
-				int neighborID = triangle.m_neighborTriIndexes[edge];
-				if (neighborID == -1) continue;
+	NavMeshObstacle& obstacle = m_obstacles[obstacleID];
+	obstacle.m_prop = prop;
+	obstacle.m_agentRadius = agentRadius;
+	CarveObstacle(obstacle);
+	return obstacleID;
+}
 
-				NavMeshTri& neighborTriangle = m_triangles[neighborID];
+void NavMesh::UpdateDynamicObstacle(int obstacleID)
+{
+	if (obstacleID < 0 || obstacleID >= static_cast<int>(m_obstacles.size())) return;
 
-				for (int neighborEdge = 0; neighborEdge < 3; neighborEdge++)
-				{
-					if (neighborTriangle.m_neighborTriIndexes[neighborEdge] == static_cast<int>(i))
-					{
-						neighborTriangle.m_neighborTriIndexes[neighborEdge] = -1;
-					}
-				}
-			}
-			trianglesToRemove.emplace_back(i);
-		}
+	NavMeshObstacle& obstacle = m_obstacles[obstacleID];
+	if (!obstacle.m_prop) return;
+
+	UncarveObstacle(obstacle);
+	CarveObstacle(obstacle);
+}
+
+void NavMesh::RemoveDynamicObstacle(int obstacleID)
+{
+	if (obstacleID < 0 || obstacleID >= static_cast<int>(m_obstacles.size())) return;
+
+	NavMeshObstacle& obstacle = m_obstacles[obstacleID];
+	if (!obstacle.m_prop) return;
+
+	UncarveObstacle(obstacle);
+	obstacle.m_prop = nullptr; // Slot is reused by the next AddDynamicObstacle
+}
+
+void NavMesh::RecarveDynamicObstacles()
+{
+	m_triangleBlockerCounts.assign(m_triangles.size(), 0);
+	for (NavMeshObstacle& obstacle : m_obstacles)
+	{
+		obstacle.m_blockedTriangleIndexes.clear();
+		if (obstacle.m_prop) CarveObstacle(obstacle);
 	}
+	m_carveVersion++;
+}
 
-	// Remove triangles in reverse order to avoid messing up the indexing
-	for (size_t i = trianglesToRemove.size(); i > 0; i--)
+void NavMesh::CarveObstacle(NavMeshObstacle& obstacle)
+{
+	if (m_triangleBlockerCounts.size() != m_triangles.size())
 	{
-		size_t indexToRemove = trianglesToRemove[i - 1];
-		int lastIndex = static_cast<int>(m_triangles.size()) - 1;
+		m_triangleBlockerCounts.resize(m_triangles.size(), 0);
+	}
 
-		if (indexToRemove != lastIndex)
-		{
-			m_triangles[indexToRemove] = m_triangles[lastIndex];
+	// Each shape is looked up on its own through the BVH, within its bounds grown by the radius. A prop only uses the shape it was
+	// created with, the other one is left empty at the origin and blocks nothing
+	Prop const* prop = obstacle.m_prop;
+	float radius = obstacle.m_agentRadius;
+	Vec3 const radiusExpansion = Vec3(radius, radius, radius);
 
-			NavMeshTri& movedTriangle = m_triangles[indexToRemove];
-			for (int edge = 0; edge < 3; edge++)
+	bool hasBox = prop->m_box.m_maxs.x > prop->m_box.m_mins.x || prop->m_box.m_maxs.y > prop->m_box.m_mins.y || prop->m_box.m_maxs.z > prop->m_box.m_mins.z;
+	if (hasBox)
+	{
+		GetTrianglesOverlappingBox(prop->m_box.m_mins - radiusExpansion, prop->m_box.m_maxs + radiusExpansion, m_obstacleCandidateIndexes);
+		for (int triangleIndex : m_obstacleCandidateIndexes)
+		{
+			NavMeshTri const& triangle = m_triangles[triangleIndex];
+			if (prop->IsTriangleBlockedByAABB3D(m_vertexes[triangle.m_vertIndexes[0]], m_vertexes[triangle.m_vertIndexes[1]], m_vertexes[triangle.m_vertIndexes[2]], radius))
 			{
-				int neighborID = movedTriangle.m_neighborTriIndexes[edge];
-				if (neighborID == -1) continue;
-
-				NavMeshTri& neighborTriangle = m_triangles[neighborID];
-				for (int neighborEdge = 0; neighborEdge < 3; neighborEdge++)
-				{
-					if (neighborTriangle.m_neighborTriIndexes[neighborEdge] == lastIndex)
-					{
-						neighborTriangle.m_neighborTriIndexes[neighborEdge] = static_cast<int>(indexToRemove);
-					}
-				}
+				obstacle.m_blockedTriangleIndexes.emplace_back(triangleIndex);
+				m_triangleBlockerCounts[triangleIndex]++;
 			}
 		}
-
-		// Remove the last triangle
-		m_triangles.pop_back();
 	}
 
-	// Ensure neighbors are fully validated
-	for (NavMeshTri& triangle : m_triangles)
+	if (prop->m_cylinderRadius > 0.f)
 	{
-		for (int& neighborIndex : triangle.m_neighborTriIndexes)
+		int numBlockedByBox = static_cast<int>(obstacle.m_blockedTriangleIndexes.size());
+		float cylinderRadius = prop->m_cylinderRadius + radius;
+		Vec3 cylinderMins = Vec3(prop->m_cylinderCenter.x - cylinderRadius, prop->m_cylinderCenter.y - cylinderRadius, std::min(prop->m_cylinderStartPos.z, prop->m_cylinderEndPos.z) - radius);
+		Vec3 cylinderMaxs = Vec3(prop->m_cylinderCenter.x + cylinderRadius, prop->m_cylinderCenter.y + cylinderRadius, std::max(prop->m_cylinderStartPos.z, prop->m_cylinderEndPos.z) + radius);
+		GetTrianglesOverlappingBox(cylinderMins, cylinderMaxs, m_obstacleCandidateIndexes);
+		for (int triangleIndex : m_obstacleCandidateIndexes)
 		{
-			if (neighborIndex >= static_cast<int>(m_triangles.size()))
-			{
-				neighborIndex = -1; // Ensure no out-of-bounds neighbor reference
-			}
+			NavMeshTri const& triangle = m_triangles[triangleIndex];
+			if (!prop->IsTriangleBlockedByCylinder3D(m_vertexes[triangle.m_vertIndexes[0]], m_vertexes[triangle.m_vertIndexes[1]], m_vertexes[triangle.m_vertIndexes[2]], radius)) continue;
+
+			// Already blocked by the box
+			auto blockedByBoxEnd = obstacle.m_blockedTriangleIndexes.begin() + numBlockedByBox;
+			if (std::find(obstacle.m_blockedTriangleIndexes.begin(), blockedByBoxEnd, triangleIndex) != blockedByBoxEnd) continue;
+
+			obstacle.m_blockedTriangleIndexes.emplace_back(triangleIndex);
+			m_triangleBlockerCounts[triangleIndex]++;
 		}
 	}
 
-	// #ToDo i don't think i need to do this
-	// Rather i could just valid the nav mesh 
-	RebuildNavMeshVerts();
+	if (!obstacle.m_blockedTriangleIndexes.empty()) m_carveVersion++;
 }
 
-void NavMesh::PopulateDistanceField(NavMeshHeatMap& outDistanceField, float maxCost) const
+void NavMesh::UncarveObstacle(NavMeshObstacle& obstacle)
 {
-	outDistanceField.SetAllValues(maxCost); // Set all triangle indexes to max value of 9999.f
-
-	std::queue<int> openSet;
-
-	for (int i = 0; i < static_cast<int>(m_triangles.size()); i++)
+	for (int triangleIndex : obstacle.m_blockedTriangleIndexes)
 	{
-		const NavMeshTri& tri = m_triangles[i];
-		for (int neighbor : tri.m_neighborTriIndexes)
+		if (triangleIndex < static_cast<int>(m_triangleBlockerCounts.size()) && m_triangleBlockerCounts[triangleIndex] > 0)
 		{
-			if (neighbor == -1)
-			{
-				outDistanceField.SetValue(i, 0.f);   // Seed with 0 (danger zone)
-				openSet.emplace(i);
-			}
+			m_triangleBlockerCounts[triangleIndex]--;
 		}
 	}
 
-	while (!openSet.empty())
-	{
-		int currentIndex = openSet.front();
-		openSet.pop();
+	if (!obstacle.m_blockedTriangleIndexes.empty()) m_carveVersion++;
+	obstacle.m_blockedTriangleIndexes.clear();
+}
 
-		float currentValue = outDistanceField.GetValue(currentIndex);
-		const NavMeshTri& currentTri = m_triangles[currentIndex];
+void NavMesh::GetTrianglesOverlappingBox(Vec3 const& mins, Vec3 const& maxs, std::vector<int>& outTriangleIndexes) const
+{
+	outTriangleIndexes.clear();
+	if (m_flatBVHNodes.empty()) return;
 
-		for (int neighborIndex : currentTri.m_neighborTriIndexes)
+	int nodeStack[FLAT_BVH_MAX_DEPTH + 2];
+	int stackSize = 0;
+	nodeStack[stackSize++] = 0;
+	while (stackSize > 0)
+	{
+		FlatBVHNode const& node = m_flatBVHNodes[nodeStack[--stackSize]];
+		if (node.m_maxs.x < mins.x || node.m_mins.x > maxs.x ||
+			node.m_maxs.y < mins.y || node.m_mins.y > maxs.y ||
+			node.m_maxs.z < mins.z || node.m_mins.z > maxs.z)
 		{
-			if (neighborIndex == -1) continue;
-
-			float neighborValue = outDistanceField.GetValue(neighborIndex);
-			float newValue = currentValue + 1.f; 
+			continue;
+		}
 
-			if (newValue < neighborValue)
+		if (node.IsLeafNode())
+		{
+			for (int slot = node.m_firstIndex; slot < node.m_firstIndex + node.m_numTriangles; slot++)
 			{
-				outDistanceField.SetValue(neighborIndex, newValue);
-				openSet.emplace(neighborIndex);
+				outTriangleIndexes.emplace_back(m_flatBVHTriangleIndexes[slot]);
 			}
+			continue;
 		}
-	}
 
-	// Mark unreachable triangles
-	for (size_t i = 0; i < m_triangles.size(); i++)
-	{
-		if (outDistanceField.GetValue(static_cast<int>(i)) == maxCost)
-		{
-			outDistanceField.SetValue(static_cast<int>(i), m_specialValue);
-		}
+		nodeStack[stackSize++] = node.m_firstIndex + 1;
+		nodeStack[stackSize++] = node.m_firstIndex;
 	}
 }
 
-Vec3 NavMesh::ClampPositionToNavMesh(Vec3 const& position)
+void NavMesh::SetAreaInBox(Vec3 const& mins, Vec3 const& maxs, uint8_t area)
 {
-	int closestTriangleIndex = GetClosestTriangleIndex(position);
-	if (closestTriangleIndex == -1) { return position; }
+	ASSERT_OR_DIE(area < NAVMESH_MAX_AREAS, "NavMesh area out of range");
 
-	const NavMeshTri& triangle = m_triangles[closestTriangleIndex];
-	Vec3 const& v0 = m_vertexes[triangle.m_vertIndexes[0]];
-	Vec3 const& v1 = m_vertexes[triangle.m_vertIndexes[1]];
-	Vec3 const& v2 = m_vertexes[triangle.m_vertIndexes[2]];
-
-	return GetNearestPointOnTriangle3D(position, v0, v1, v2);
+	std::vector<int> triangleIndexes;
+	GetTrianglesOverlappingBox(mins, maxs, triangleIndexes);
+	for (int triangleIndex : triangleIndexes)
+	{
+		m_triangleAreas[triangleIndex] = area;
+	}
 }
 
-Vec3 NavMesh::CalculateCentroid(const NavMeshTri& triangle) const
+void NavMesh::MarkAreaNearEdges(uint8_t area, float maxDistance)
 {
-	// Validate indices before using them
-	for (int i = 0; i < 3; i++)
+	ASSERT_OR_DIE(area < NAVMESH_MAX_AREAS, "NavMesh area out of range");
+	if (!m_heatMap) return;
+
+	uint8_t const ground = static_cast<uint8_t>(NavMeshArea::Ground);
+	for (int triangleIndex = 0; triangleIndex < GetNumTriangles(); triangleIndex++)
 	{
-		if (triangle.m_vertIndexes[i] < 0 || triangle.m_vertIndexes[i] >= m_vertexes.size())
+		float distance = m_heatMap->GetValue(triangleIndex);
+		if (m_triangleAreas[triangleIndex] == ground && distance >= 0.f && distance < maxDistance) // Unreachable triangles hold m_specialValue
 		{
-			return Vec3::ZERO;
+			m_triangleAreas[triangleIndex] = area;
 		}
 	}
+}
+
+void NavMesh::PopulateDistanceField(NavMeshHeatMap& outDistanceField, float maxCost) const
+{
+	int numTriangles = GetNumTriangles();
+	outDistanceField.SetNumValues(numTriangles);
+	outDistanceField.SetAllValues(maxCost); // Set all triangle indexes to max value of 9999.f
+	if (numTriangles == 0) return;
+	float* distances = outDistanceField.GetValueData();
+
+	// Distances run centroid to centroid, so they are in world units rather than hops
+	std::vector<Vec3> centroids(numTriangles);
+	ParallelForIfAvailable(g_theJobSystem, 0, numTriangles, FLAT_BVH_PARALLEL_MIN_TRIANGLES, [&](int triangleIndex)
+	{
+		NavMeshTri const& triangle = m_triangles[triangleIndex];
+		centroids[triangleIndex] = (m_vertexes[triangle.m_vertIndexes[0]] + m_vertexes[triangle.m_vertIndexes[1]] + m_vertexes[triangle.m_vertIndexes[2]]) / 3.f;
+	}, JobType::AI);
+
+	// Cut the mesh into a grid of regions over XY, each region runs its own Dijkstra on its own job
+	Vec2 boundsMins(FLT_MAX, FLT_MAX);
+	Vec2 boundsMaxs(-FLT_MAX, -FLT_MAX);
+	for (Vec3 const& centroid : centroids)
+	{
+		boundsMins.x = std::min(boundsMins.x, centroid.x);
+		boundsMins.y = std::min(boundsMins.y, centroid.y);
+		boundsMaxs.x = std::max(boundsMaxs.x, centroid.x);
+		boundsMaxs.y = std::max(boundsMaxs.y, centroid.y);
+	}
+	int const regionsPerSide = NAVMESH_DISTANCE_FIELD_REGIONS_PER_SIDE;
+	float regionWidth = std::max((boundsMaxs.x - boundsMins.x) / static_cast<float>(regionsPerSide), FLT_MIN);
+	float regionHeight = std::max((boundsMaxs.y - boundsMins.y) / static_cast<float>(regionsPerSide), FLT_MIN);
+
+	std::vector<int> regionOfTriangle(numTriangles);
+	for (int triangleIndex = 0; triangleIndex < numTriangles; triangleIndex++)
+	{
+		int regionX = std::min(static_cast<int>((centroids[triangleIndex].x - boundsMins.x) / regionWidth), regionsPerSide - 1);
+		int regionY = std::min(static_cast<int>((centroids[triangleIndex].y - boundsMins.y) / regionHeight), regionsPerSide - 1);
+		regionOfTriangle[triangleIndex] = regionX + regionY * regionsPerSide;
+	}
+
+	int const numRegions = regionsPerSide * regionsPerSide;
+	std::vector<std::vector<int>> regionSeeds(numRegions);
+	std::vector<std::vector<std::pair<int, float>>> regionOutgoing(numRegions); // Lowered values for triangles in other regions
+
+	// Blocked triangles are left out, so the edges of carved obstacles count as danger zones too
+	for (int i = 0; i < numTriangles; i++)
+	{
+		if (IsTriangleBlocked(i)) continue;
+
+		for (int edge = 0; edge < 3; edge++)
+		{
+			if (GetWalkableNeighbor(i, edge) == -1)
+			{
+				distances[i] = 0.f;   // Seed with 0 (danger zone)
+				regionSeeds[regionOfTriangle[i]].emplace_back(i);
+				break;
+			}
+		}
+	}
+
+	// A region only writes its own triangles, anything crossing a border is handed over between rounds.
+	// Rounds stop once no region lowered a value across its border, which leaves the same field as one Dijkstra over the whole mesh
+	typedef std::pair<float, int> OpenEntry;
+	bool hasSeeds = true;
+	while (hasSeeds)
+	{
+		ParallelForIfAvailable(g_theJobSystem, 0, numRegions, 1, [&](int region)
+		{
+			std::vector<int>& seeds = regionSeeds[region];
+			if (seeds.empty()) return;
+
+			std::priority_queue<OpenEntry, std::vector<OpenEntry>, std::greater<OpenEntry>> openSet;
+			for (int seedIndex : seeds)
+			{
+				openSet.emplace(distances[seedIndex], seedIndex);
+			}
+			seeds.clear();
+
+			std::vector<std::pair<int, float>>& outgoing = regionOutgoing[region];
+			while (!openSet.empty())
+			{
+				OpenEntry current = openSet.top();
+				openSet.pop();
+				int currentIndex = current.second;
+				if (current.first > distances[currentIndex]) continue; // Already reached cheaper
+
+				for (int edge = 0; edge < 3; edge++)
+				{
+					int neighborIndex = GetWalkableNeighbor(currentIndex, edge);
+					if (neighborIndex == -1) continue;
+
+					float newValue = current.first + GetDistance3D(centroids[currentIndex], centroids[neighborIndex]);
+					if (newValue >= maxCost) continue;
+
+					if (regionOfTriangle[neighborIndex] != region)
+					{
+						outgoing.emplace_back(neighborIndex, newValue);
+					}
+					else if (newValue < distances[neighborIndex])
+					{
+						distances[neighborIndex] = newValue;
+						openSet.emplace(newValue, neighborIndex);
+					}
+				}
+			}
+		}, JobType::AI);
+
+		hasSeeds = false;
+		for (std::vector<std::pair<int, float>>& outgoing : regionOutgoing)
+		{
+			for (std::pair<int, float> const& handover : outgoing)
+			{
+				if (handover.second < distances[handover.first])
+				{
+					distances[handover.first] = handover.second;
+					regionSeeds[regionOfTriangle[handover.first]].emplace_back(handover.first);
+					hasSeeds = true;
+				}
+			}
+			outgoing.clear();
+		}
+	}
+
+	// Mark unreachable triangles
+	for (int i = 0; i < numTriangles; i++)
+	{
+		if (distances[i] == maxCost)
+		{
+			distances[i] = m_specialValue;
+		}
+	}
+}
+
+Vec3 NavMesh::ClampPositionToNavMesh(Vec3 const& position)
+{
+	int closestTriangleIndex = -1;
+	Vec3 projectedPoint;
+	if (!FindNearestTriangle(position, closestTriangleIndex, projectedPoint)) { return position; }
+
+	return projectedPoint;
+}
+
+Vec3 NavMesh::CalculateCentroid(const NavMeshTri& triangle) const
+{
+	// Validate indices before using them
+	for (int i = 0; i < 3; i++)
+	{
+		if (triangle.m_vertIndexes[i] < 0 || triangle.m_vertIndexes[i] >= m_vertexes.size())
+		{
+			return Vec3::ZERO;
+		}
+	}
+
+	Vec3 v0 = m_vertexes[triangle.m_vertIndexes[0]];
+	Vec3 v1 = m_vertexes[triangle.m_vertIndexes[1]];
+	Vec3 v2 = m_vertexes[triangle.m_vertIndexes[2]];
 
-	Vec3 v0 = m_vertexes[triangle.m_vertIndexes[0]];
-	Vec3 v1 = m_vertexes[triangle.m_vertIndexes[1]];
-	Vec3 v2 = m_vertexes[triangle.m_vertIndexes[2]];
-
 	return (v0 + v1 + v2) / 3.f;
 }
 
 void NavMesh::RebuildNavMeshVerts()
 {	
+	BuildRenderVerts(Rgba8::MORE_TRANSLUCENT, Rgba8::ELECTRIC_BLUE);
+
+	[[maybe_unused]] bool isValidNavMesh = ValidateNavMesh();
+}
+
+void NavMesh::BuildRenderVerts(Rgba8 const& solidColor, Rgba8 const& wireColor)
+{
 	m_solidVerts.clear();
 	m_wireVerts.clear();
+	m_navMeshIndexes.clear();
 
-	for (NavMeshTri& tri : m_triangles)
+	// Vertexes left behind by removed triangles stay in the buffer, nothing indexes them
+	m_solidVerts.reserve(m_vertexes.size());
+	m_wireVerts.reserve(m_vertexes.size());
+	for (Vec3 const& vertex : m_vertexes)
 	{
-		Vec3 v0 = m_vertexes[tri.m_vertIndexes[0]];
-		Vec3 v1 = m_vertexes[tri.m_vertIndexes[1]];
-		Vec3 v2 = m_vertexes[tri.m_vertIndexes[2]];
-
-		// Add updated verts
-		AddVertsFor3DTriangle(m_solidVerts, v0, v1, v2, Rgba8::MORE_TRANSLUCENT);
-		AddVertsFor3DTriangle(m_wireVerts, v0, v1, v2, Rgba8::ELECTRIC_BLUE);
+		m_solidVerts.emplace_back(vertex, solidColor, Vec2::ZERO);
+		m_wireVerts.emplace_back(vertex, wireColor, Vec2::ZERO);
 	}
 
-	[[maybe_unused]] bool isValidNavMesh = ValidateNavMesh();
+	m_navMeshIndexes.reserve(m_triangles.size() * 3);
+	for (int triangleIndex = 0; triangleIndex < static_cast<int>(m_triangles.size()); triangleIndex++)
+	{
+		if (IsTriangleBlocked(triangleIndex)) continue; // Carved out by a dynamic obstacle
+
+		NavMeshTri const& tri = m_triangles[triangleIndex];
+		m_navMeshIndexes.emplace_back(static_cast<unsigned int>(tri.m_vertIndexes[0]));
+		m_navMeshIndexes.emplace_back(static_cast<unsigned int>(tri.m_vertIndexes[1]));
+		m_navMeshIndexes.emplace_back(static_cast<unsigned int>(tri.m_vertIndexes[2]));
+	}
 }
 
 void NavMesh::RenderHeatMap() const
@@ -545,7 +1027,7 @@ void NavMesh::RenderBVH() const
 
 void NavMesh::RenderNavMesh() const
 {
-	if (m_solidVertexBuffer)
+	if (m_solidVertexBuffer && m_navMeshIndexBuffer)
 	{
 		if (!m_solidVerts.empty())
 		{
@@ -554,11 +1036,11 @@ void NavMesh::RenderNavMesh() const
 			g_theRenderer->SetModelConstants();
 			g_theRenderer->BindShader(nullptr);
 			g_theRenderer->BindTexture(0, nullptr);
-			g_theRenderer->DrawVertexBuffer(m_solidVertexBuffer, VertexType::Vertex_PCU, static_cast<int>(m_vertexes.size()));
+			g_theRenderer->DrawVertexBufferIndex(m_solidVertexBuffer, m_navMeshIndexBuffer, VertexType::Vertex_PCU, static_cast<int>(m_navMeshIndexes.size()));
 		}
 	}
 	
-	if (m_wireVertexBuffer)
+	if (m_wireVertexBuffer && m_navMeshIndexBuffer)
 	{
 		if (!m_wireVerts.empty())
 		{
@@ -567,7 +1049,7 @@ void NavMesh::RenderNavMesh() const
 			g_theRenderer->SetSamplerMode(SamplerMode::POINT_CLAMP);
 			g_theRenderer->BindShader(nullptr);
 			g_theRenderer->BindTexture(0, nullptr);
-			g_theRenderer->DrawVertexBuffer(m_wireVertexBuffer, VertexType::Vertex_PCU, static_cast<int>(m_vertexes.size()));
+			g_theRenderer->DrawVertexBufferIndex(m_wireVertexBuffer, m_navMeshIndexBuffer, VertexType::Vertex_PCU, static_cast<int>(m_navMeshIndexes.size()));
 		}
 	}
 }
@@ -654,6 +1136,361 @@ void NavMesh::CollectBVHNodesInOrder(const BVHNode* node)
 	}
 }
 
+struct FlatBVHBuildData
+{
+	std::vector<Vec3> m_centroids; // Per triangle
+	std::vector<Vec3> m_mins;
+	std::vector<Vec3> m_maxs;
+};
+
+struct FlatBVHBuildTask
+{
+	int m_nodeIndex = 0;
+	int m_begin = 0;
+	int m_end = 0;
+	int m_depth = 0;
+};
+
+static float GetAxisComponent(Vec3 const& vector, int axis)
+{
+	return (axis == 0) ? vector.x : ((axis == 1) ? vector.y : vector.z);
+}
+
+static float GetBoxSurfaceArea(Vec3 const& mins, Vec3 const& maxs)
+{
+	Vec3 dims = maxs - mins;
+	return 2.f * (dims.x * dims.y + dims.y * dims.z + dims.z * dims.x);
+}
+
+static void StretchBoxToIncludeBox(Vec3& mins, Vec3& maxs, Vec3 const& otherMins, Vec3 const& otherMaxs)
+{
+	mins.x = std::min(mins.x, otherMins.x);
+	mins.y = std::min(mins.y, otherMins.y);
+	mins.z = std::min(mins.z, otherMins.z);
+	maxs.x = std::max(maxs.x, otherMaxs.x);
+	maxs.y = std::max(maxs.y, otherMaxs.y);
+	maxs.z = std::max(maxs.z, otherMaxs.z);
+}
+
+static float GetDistanceSquaredToBox(Vec3 const& point, Vec3 const& mins, Vec3 const& maxs)
+{
+	float distanceX = std::max(std::max(mins.x - point.x, 0.f), point.x - maxs.x);
+	float distanceY = std::max(std::max(mins.y - point.y, 0.f), point.y - maxs.y);
+	float distanceZ = std::max(std::max(mins.z - point.z, 0.f), point.z - maxs.z);
+	return distanceX * distanceX + distanceY * distanceY + distanceZ * distanceZ;
+}
+
+// Containment in XY only, with the edges pushed out by tolerance
+static bool IsPointInsideTriangleXY(Vec3 const& point, Vec3 const& v0, Vec3 const& v1, Vec3 const& v2, float tolerance)
+{
+	Vec2 corners[3] = { Vec2(v0.x, v0.y), Vec2(v1.x, v1.y), Vec2(v2.x, v2.y) };
+	Vec2 point2D = Vec2(point.x, point.y);
+	float winding = (CrossProduct2D(corners[1] - corners[0], corners[2] - corners[0]) >= 0.f) ? 1.f : -1.f;
+	for (int edge = 0; edge < 3; edge++)
+	{
+		Vec2 edgeDisplacement = corners[(edge + 1) % 3] - corners[edge];
+		float side = winding * CrossProduct2D(edgeDisplacement, point2D - corners[edge]);
+		if (side < -tolerance * edgeDisplacement.GetLength()) return false;
+	}
+	return true;
+}
+
+// Moller-Trumbore, only counting hits on the upward facing side. Shortens inOutDistance on a hit
+static bool RaycastVsNavMeshTriangle(Vec3 const& start, Vec3 const& rayDir, Vec3 const& v0, Vec3 const& v1, Vec3 const& v2, float& inOutDistance, Vec3& outNormal)
+{
+	Vec3 edge0 = v1 - v0;
+	Vec3 edge2 = v2 - v0;
+	Vec3 normal = CrossProduct3D(edge0, edge2);
+	if (normal.z < 0.f) normal = -normal;
+	if (DotProduct3D(rayDir, normal) >= 0.f) return false; // Parallel or coming from underneath
+
+	Vec3 pVector = CrossProduct3D(rayDir, edge2);
+	float determinant = DotProduct3D(edge0, pVector);
+	if (determinant == 0.f) return false;
+	float inverseDeterminant = 1.f / determinant;
+
+	Vec3 tVector = start - v0;
+	float u = DotProduct3D(tVector, pVector) * inverseDeterminant;
+	if (u < 0.f || u > 1.f) return false;
+
+	Vec3 qVector = CrossProduct3D(tVector, edge0);
+	float v = DotProduct3D(rayDir, qVector) * inverseDeterminant;
+	if (v < 0.f || u + v > 1.f) return false;
+
+	float distance = DotProduct3D(edge2, qVector) * inverseDeterminant;
+	if (distance < 0.f || distance >= inOutDistance) return false;
+
+	inOutDistance = distance;
+	outNormal = normal.GetNormalized();
+	return true;
+}
+
+// Interleaves the bits of x and y in the low 16 bits each, so sorting by it keeps nearby points near each other
+static uint32_t GetMortonCode2D(uint32_t x, uint32_t y)
+{
+	auto spreadBits = [](uint32_t value)
+	{
+		value &= 0x0000FFFF;
+		value = (value | (value << 8)) & 0x00FF00FF;
+		value = (value | (value << 4)) & 0x0F0F0F0F;
+		value = (value | (value << 2)) & 0x33333333;
+		value = (value | (value << 1)) & 0x55555555;
+		return value;
+	};
+	return spreadBits(x) | (spreadBits(y) << 1);
+}
+
+// Order to run batched queries in so every group covers one small patch of the mesh
+static void SortQueriesSpatially(std::vector<Vec3> const& positions, Vec3 const& mins, Vec3 const& maxs, std::vector<int>& outOrder)
+{
+	float scaleX = (maxs.x > mins.x) ? 65535.f / (maxs.x - mins.x) : 0.f;
+	float scaleY = (maxs.y > mins.y) ? 65535.f / (maxs.y - mins.y) : 0.f;
+
+	std::vector<std::pair<uint32_t, int>> keys(positions.size());
+	for (size_t index = 0; index < positions.size(); index++)
+	{
+		uint32_t cellX = static_cast<uint32_t>(GetClamped((positions[index].x - mins.x) * scaleX, 0.f, 65535.f));
+		uint32_t cellY = static_cast<uint32_t>(GetClamped((positions[index].y - mins.y) * scaleY, 0.f, 65535.f));
+		keys[index] = std::make_pair(GetMortonCode2D(cellX, cellY), static_cast<int>(index));
+	}
+	std::sort(keys.begin(), keys.end());
+
+	outOrder.resize(positions.size());
+	for (size_t index = 0; index < keys.size(); index++)
+	{
+		outOrder[index] = keys[index].second;
+	}
+}
+
+void NavMesh::BuildFlatBVH()
+{
+	double timeBefore = GetCurrentTimeSeconds();
+
+	int numTriangles = GetNumTriangles();
+	m_flatBVHNodes.clear();
+	m_flatBVHTriangleIndexes.resize(numTriangles);
+	if (numTriangles == 0) return;
+
+	// Every split reads these again, so work them out once per triangle
+	FlatBVHBuildData buildData;
+	buildData.m_centroids.resize(numTriangles);
+	buildData.m_mins.resize(numTriangles);
+	buildData.m_maxs.resize(numTriangles);
+	auto precomputeTriangle = [&](int triangleIndex)
+	{
+		NavMeshTri const& triangle = m_triangles[triangleIndex];
+		Vec3 const& v0 = m_vertexes[triangle.m_vertIndexes[0]];
+		Vec3 const& v1 = m_vertexes[triangle.m_vertIndexes[1]];
+		Vec3 const& v2 = m_vertexes[triangle.m_vertIndexes[2]];
+		buildData.m_mins[triangleIndex] = Vec3(std::min({ v0.x, v1.x, v2.x }), std::min({ v0.y, v1.y, v2.y }), std::min({ v0.z, v1.z, v2.z }));
+		buildData.m_maxs[triangleIndex] = Vec3(std::max({ v0.x, v1.x, v2.x }), std::max({ v0.y, v1.y, v2.y }), std::max({ v0.z, v1.z, v2.z }));
+		buildData.m_centroids[triangleIndex] = (v0 + v1 + v2) / 3.f;
+		m_flatBVHTriangleIndexes[triangleIndex] = triangleIndex;
+	};
+
+	ParallelForIfAvailable(g_theJobSystem, 0, numTriangles, FLAT_BVH_PARALLEL_MIN_TRIANGLES, precomputeTriangle, JobType::AI);
+
+	// Split on this thread until the ranges are small, then build each of those subtrees on its own job into its own node array
+	std::vector<FlatBVHBuildTask> tasks;
+	m_flatBVHNodes.emplace_back();
+	BuildFlatBVHNode(m_flatBVHNodes, 0, 0, numTriangles, 0, buildData, g_theJobSystem ? &tasks : nullptr);
+
+	if (!tasks.empty())
+	{
+		std::vector<std::vector<FlatBVHNode>> taskNodes(tasks.size());
+		g_theJobSystem->ParallelFor(0, static_cast<int>(tasks.size()), 1, [&](int taskIndex)
+		{
+			FlatBVHBuildTask const& task = tasks[taskIndex];
+			std::vector<FlatBVHNode>& nodes = taskNodes[taskIndex];
+			nodes.emplace_back();
+			BuildFlatBVHNode(nodes, 0, task.m_begin, task.m_end, task.m_depth, buildData, nullptr);
+		}, JobType::AI);
+
+		// The subtree root goes in the slot reserved for it, the rest is appended with its child indexes shifted to match
+		for (size_t taskIndex = 0; taskIndex < tasks.size(); taskIndex++)
+		{
+			std::vector<FlatBVHNode> const& nodes = taskNodes[taskIndex];
+			int indexOffset = static_cast<int>(m_flatBVHNodes.size()) - 1;
+			for (size_t localIndex = 0; localIndex < nodes.size(); localIndex++)
+			{
+				FlatBVHNode node = nodes[localIndex];
+				if (!node.IsLeafNode()) node.m_firstIndex += indexOffset;
+
+				if (localIndex == 0) m_flatBVHNodes[tasks[taskIndex].m_nodeIndex] = node;
+				else m_flatBVHNodes.emplace_back(node);
+			}
+		}
+	}
+	m_flatBVHNodes.shrink_to_fit();
+
+	double timeAfter = GetCurrentTimeSeconds();
+	float msElapsed = 1000.f * float(timeAfter - timeBefore);
+	g_theConsole->AddLine(Rgba8::DARK_GREEN, Stringf("Flat BVH built with %i nodes (%.02f KB) in %.02f ms", static_cast<int>(m_flatBVHNodes.size()), static_cast<float>(GetFlatBVHMemoryBytes()) / 1024.f, msElapsed));
+}
+
+void NavMesh::BuildFlatBVHNode(std::vector<FlatBVHNode>& nodes, int nodeIndex, int begin, int end, int depth, FlatBVHBuildData const& buildData, std::vector<FlatBVHBuildTask>* deferredTasks)
+{
+	int numTriangles = end - begin;
+	if (deferredTasks && numTriangles <= FLAT_BVH_PARALLEL_MIN_TRIANGLES)
+	{
+		deferredTasks->push_back(FlatBVHBuildTask{ nodeIndex, begin, end, depth });
+		return;
+	}
+
+	// Node bounds come from the triangle bounds, split positions from the centroid bounds
+	Vec3 mins(FLT_MAX, FLT_MAX, FLT_MAX);
+	Vec3 maxs(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	Vec3 centroidMins = mins;
+	Vec3 centroidMaxs = maxs;
+	for (int slot = begin; slot < end; slot++)
+	{
+		int triangleIndex = m_flatBVHTriangleIndexes[slot];
+		Vec3 const& centroid = buildData.m_centroids[triangleIndex];
+		StretchBoxToIncludeBox(mins, maxs, buildData.m_mins[triangleIndex], buildData.m_maxs[triangleIndex]);
+		StretchBoxToIncludeBox(centroidMins, centroidMaxs, centroid, centroid);
+	}
+	nodes[nodeIndex].m_mins = mins;
+	nodes[nodeIndex].m_maxs = maxs;
+
+	auto makeLeaf = [&]()
+	{
+		nodes[nodeIndex].m_firstIndex = begin;
+		nodes[nodeIndex].m_numTriangles = numTriangles;
+	};
+
+	if (numTriangles <= FLAT_BVH_MAX_TRIANGLES_PER_LEAF || depth >= FLAT_BVH_MAX_DEPTH)
+	{
+		makeLeaf();
+		return;
+	}
+
+	float binScales[3] = {};
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float axisExtent = GetAxisComponent(centroidMaxs, axis) - GetAxisComponent(centroidMins, axis);
+		binScales[axis] = (axisExtent > 0.f) ? static_cast<float>(FLAT_BVH_NUM_BINS) / axisExtent : 0.f;
+	}
+
+	auto getBin = [&](int triangleIndex, int axis)
+	{
+		float offset = GetAxisComponent(buildData.m_centroids[triangleIndex], axis) - GetAxisComponent(centroidMins, axis);
+		return std::min(static_cast<int>(offset * binScales[axis]), FLAT_BVH_NUM_BINS - 1);
+	};
+
+	// Binned SAH over every axis, ramps and stairs give the mesh enough height for z to win now and then
+	int bestAxis = -1;
+	int bestSplitBin = 0;
+	float bestCost = FLT_MAX;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		if (binScales[axis] == 0.f) continue;
+
+		int binCounts[FLAT_BVH_NUM_BINS] = {};
+		Vec3 binMins[FLAT_BVH_NUM_BINS];
+		Vec3 binMaxs[FLAT_BVH_NUM_BINS];
+		for (int bin = 0; bin < FLAT_BVH_NUM_BINS; bin++)
+		{
+			binMins[bin] = Vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+			binMaxs[bin] = Vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		}
+
+		for (int slot = begin; slot < end; slot++)
+		{
+			int triangleIndex = m_flatBVHTriangleIndexes[slot];
+			int bin = getBin(triangleIndex, axis);
+			binCounts[bin]++;
+			StretchBoxToIncludeBox(binMins[bin], binMaxs[bin], buildData.m_mins[triangleIndex], buildData.m_maxs[triangleIndex]);
+		}
+
+		// Sweep from the right first so the left sweep can price every split in one pass
+		int rightCounts[FLAT_BVH_NUM_BINS] = {};
+		float rightAreas[FLAT_BVH_NUM_BINS] = {};
+		Vec3 sweepMins(FLT_MAX, FLT_MAX, FLT_MAX);
+		Vec3 sweepMaxs(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		int sweepCount = 0;
+		for (int bin = FLAT_BVH_NUM_BINS - 1; bin > 0; bin--)
+		{
+			sweepCount += binCounts[bin];
+			StretchBoxToIncludeBox(sweepMins, sweepMaxs, binMins[bin], binMaxs[bin]);
+			rightCounts[bin] = sweepCount;
+			rightAreas[bin] = (sweepCount > 0) ? GetBoxSurfaceArea(sweepMins, sweepMaxs) : 0.f;
+		}
+
+		sweepMins = Vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+		sweepMaxs = Vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		sweepCount = 0;
+		for (int bin = 0; bin < FLAT_BVH_NUM_BINS - 1; bin++)
+		{
+			sweepCount += binCounts[bin];
+			StretchBoxToIncludeBox(sweepMins, sweepMaxs, binMins[bin], binMaxs[bin]);
+			if (sweepCount == 0 || rightCounts[bin + 1] == 0) continue;
+
+			float cost = GetBoxSurfaceArea(sweepMins, sweepMaxs) * static_cast<float>(sweepCount) + rightAreas[bin + 1] * static_cast<float>(rightCounts[bin + 1]);
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplitBin = bin;
+			}
+		}
+	}
+
+	int* slots = m_flatBVHTriangleIndexes.data();
+	int mid = begin + numTriangles / 2; // Every centroid in the same spot, any split is as good as another
+	if (bestAxis >= 0)
+	{
+		// One box test stands in for the cost of going down a level, against testing every triangle right here
+		float nodeArea = GetBoxSurfaceArea(mins, maxs);
+		float splitCost = (nodeArea > 0.f) ? 1.f + bestCost / nodeArea : FLT_MAX;
+		if (numTriangles <= FLAT_BVH_MAX_SAH_LEAF_TRIANGLES && splitCost >= static_cast<float>(numTriangles))
+		{
+			makeLeaf();
+			return;
+		}
+
+		int* split = std::partition(slots + begin, slots + end, [&](int triangleIndex) { return getBin(triangleIndex, bestAxis) <= bestSplitBin; });
+		int splitSlot = static_cast<int>(split - slots);
+		if (splitSlot > begin && splitSlot < end) mid = splitSlot;
+	}
+	else if (numTriangles <= FLAT_BVH_MAX_SAH_LEAF_TRIANGLES)
+	{
+		makeLeaf();
+		return;
+	}
+
+	int leftChildIndex = static_cast<int>(nodes.size());
+	nodes.emplace_back();
+	nodes.emplace_back();
+	nodes[nodeIndex].m_firstIndex = leftChildIndex;
+	nodes[nodeIndex].m_numTriangles = 0;
+
+	BuildFlatBVHNode(nodes, leftChildIndex, begin, mid, depth + 1, buildData, deferredTasks);
+	BuildFlatBVHNode(nodes, leftChildIndex + 1, mid, end, depth + 1, buildData, deferredTasks);
+}
+
+size_t NavMesh::GetBVHMemoryBytes() const
+{
+	size_t numBytes = 0;
+	std::vector<BVHNode const*> nodeStack;
+	if (m_bvhRoot) nodeStack.emplace_back(m_bvhRoot);
+	while (!nodeStack.empty())
+	{
+		BVHNode const* node = nodeStack.back();
+		nodeStack.pop_back();
+		numBytes += sizeof(BVHNode) + node->m_triangleIndexes.capacity() * sizeof(int) + node->m_childBoxes.capacity() * sizeof(BVHNode*);
+		for (BVHNode const* child : node->m_childBoxes)
+		{
+			nodeStack.emplace_back(child);
+		}
+	}
+	return numBytes;
+}
+
+size_t NavMesh::GetFlatBVHMemoryBytes() const
+{
+	return m_flatBVHNodes.capacity() * sizeof(FlatBVHNode) + m_flatBVHTriangleIndexes.capacity() * sizeof(int);
+}
+
 void NavMesh::DrawAllBVH(BVHNode* node, int depth)
 {
 	if (!node) return;
@@ -683,7 +1520,8 @@ void NavMesh::DrawAllBVH(BVHNode* node, int depth)
 void NavMesh::ConstructHeatmap()
 {
 	m_heatMap = new NavMeshHeatMap(this);
-	m_heatmapVertexes.resize(m_triangles.size() * 3);
+	m_heatmapVertexes.clear(); // AddVertsForDebugDraw appends
+	m_heatmapVertexes.reserve(m_triangles.size() * 3);
 	PopulateDistanceField(*m_heatMap, m_maxDistanceFieldCost);
 	m_heatMap->AddVertsForDebugDraw(m_heatmapVertexes, FloatRange(0.f, m_heatMap->GetHighestHeat()), Rgba8::RED, Rgba8::BANANA_YELLOW, -2.f, Rgba8::PURPLE);
 }
@@ -772,27 +1610,11 @@ float NavMesh::GetComponent(Vec3 const& vertex, int axis)
 	}
 }
 
-int NavMesh::GetClosestTriangleIndex(Vec3 const& position)
+int NavMesh::GetClosestTriangleIndex(Vec3 const& position) const
 {
-	float closestDistanceSq  = FLT_MAX;
 	int closestIndex = -1;
-
-	for (size_t i = 0; i < m_triangles.size(); i++)
-	{
-		const NavMeshTri& tri = m_triangles[i];
-		Vec3 const& v0 = m_vertexes[tri.m_vertIndexes[0]];
-		Vec3 const& v1 = m_vertexes[tri.m_vertIndexes[1]];
-		Vec3 const& v2 = m_vertexes[tri.m_vertIndexes[2]];
-
-		Vec3 closestPoint = GetNearestPointOnTriangle3D(position, v0, v1, v2);
-		float distanceSq = GetDistanceSquared3D(position, closestPoint);
-
-		if (distanceSq < closestDistanceSq)
-		{
-			closestDistanceSq = distanceSq;
-			closestIndex = static_cast<int>(i);
-		}
-	}
+	Vec3 projectedPoint;
+	FindNearestTriangle(position, closestIndex, projectedPoint);
 	return closestIndex;
 }
 
@@ -820,8 +1642,37 @@ int NavMesh::GetTriangleIndex(const NavMeshTri* triangle) const
 
 int NavMesh::GetContainingTriangleIndex(Vec3 const& point) const
 {
-	if (!m_bvhRoot) return -1;
-	return GetRecursiveTriangleIndex(*m_bvhRoot, point);
+	if (m_flatBVHNodes.empty()) return -1;
+
+	// Every level leaves at most one sibling waiting on the stack, so the depth cap bounds its size
+	int nodeStack[FLAT_BVH_MAX_DEPTH + 2];
+	int stackSize = 0;
+	nodeStack[stackSize++] = 0;
+	while (stackSize > 0)
+	{
+		FlatBVHNode const& node = m_flatBVHNodes[nodeStack[--stackSize]];
+		if (!node.IsPointInside(point)) continue;
+
+		if (node.IsLeafNode())
+		{
+			for (int slot = node.m_firstIndex; slot < node.m_firstIndex + node.m_numTriangles; slot++)
+			{
+				int triangleIndex = m_flatBVHTriangleIndexes[slot];
+				const NavMeshTri& triangle = m_triangles[triangleIndex];
+				Vec3 const& v0 = m_vertexes[triangle.m_vertIndexes[0]];
+				Vec3 const& v1 = m_vertexes[triangle.m_vertIndexes[1]];
+				Vec3 const& v2 = m_vertexes[triangle.m_vertIndexes[2]];
+
+				if (IsPointInsideTriangle3D(point, v0, v1, v2)) return triangleIndex;
+			}
+			continue;
+		}
+
+		nodeStack[stackSize++] = node.m_firstIndex + 1;
+		nodeStack[stackSize++] = node.m_firstIndex;
+	}
+
+	return -1;
 }
 
 int NavMesh::GetRecursiveTriangleIndex(BVHNode const& node, Vec3 const& point) const
@@ -857,31 +1708,480 @@ NavMeshTri* NavMesh::GetNavMeshTriangle(int triangleID)
 	return &m_triangles[triangleID];
 }
 
-bool NavMesh::FindNearestTriangle(Vec3 const& point, int& outTriangleIndex, Vec3& outProjectedPoint)
+bool NavMesh::FindNearestTriangle(Vec3 const& point, int& outTriangleIndex, Vec3& outProjectedPoint) const
+{
+	int triangleIndex = -1;
+	Vec3 projectedPoint;
+	FindNearestTrianglesInGroup(&point, 1, &triangleIndex, &projectedPoint);
+	if (triangleIndex == -1) return false;
+
+	outTriangleIndex = triangleIndex;
+	outProjectedPoint = projectedPoint;
+	return true;
+}
+
+RaycastVsGroundResult NavMesh::RaycastVsNavMesh(Vec3 const& start, Vec3 const& direction, float maxDistance) const
+{
+	RaycastVsGroundResult result;
+	RaycastVsNavMeshInGroup(&start, &direction, 1, maxDistance, &result);
+	return result;
+}
+
+bool NavMesh::HasLineOfSight(Vec3 const& start, Vec3 const& end) const
 {
-	float bestDistSq = FLT_MAX;
-	bool found = false;
+	int startTriangleIndex = GetTriangleIndexUnderPoint(start);
+	if (startTriangleIndex == -1) return false;
 
-	for (int i = 0; i < m_triangles.size(); i++)
+	return HasLineOfSight(startTriangleIndex, start, end);
+}
+
+int NavMesh::GetTriangleIndexUnderPoint(Vec3 const& point) const
+{
+	if (m_flatBVHNodes.empty()) return -1;
+
+	int bestTriangleIndex = -1;
+	float bestHeightDifference = FLT_MAX;
+	bool isBestBlocked = false;
+
+	int nodeStack[FLAT_BVH_MAX_DEPTH + 2];
+	int stackSize = 0;
+	nodeStack[stackSize++] = 0;
+	while (stackSize > 0)
 	{
-		const NavMeshTri& tri = m_triangles[i];
-		const Vec3& v0 = m_vertexes[tri.m_vertIndexes[0]];
-		const Vec3& v1 = m_vertexes[tri.m_vertIndexes[1]];
-		const Vec3& v2 = m_vertexes[tri.m_vertIndexes[2]];
+		FlatBVHNode const& node = m_flatBVHNodes[nodeStack[--stackSize]];
+		if (point.x < node.m_mins.x - NAVMESH_LINE_OF_SIGHT_TOLERANCE || point.x > node.m_maxs.x + NAVMESH_LINE_OF_SIGHT_TOLERANCE ||
+			point.y < node.m_mins.y - NAVMESH_LINE_OF_SIGHT_TOLERANCE || point.y > node.m_maxs.y + NAVMESH_LINE_OF_SIGHT_TOLERANCE) continue;
+
+		if (!node.IsLeafNode())
+		{
+			nodeStack[stackSize++] = node.m_firstIndex + 1;
+			nodeStack[stackSize++] = node.m_firstIndex;
+			continue;
+		}
+
+		// Where levels overlap in XY, the one closest in height wins. On the border of a carved obstacle, the walkable side wins
+		for (int slot = node.m_firstIndex; slot < node.m_firstIndex + node.m_numTriangles; slot++)
+		{
+			int triangleIndex = m_flatBVHTriangleIndexes[slot];
+			NavMeshTri const& triangle = m_triangles[triangleIndex];
+			Vec3 const& v0 = m_vertexes[triangle.m_vertIndexes[0]];
+			Vec3 const& v1 = m_vertexes[triangle.m_vertIndexes[1]];
+			Vec3 const& v2 = m_vertexes[triangle.m_vertIndexes[2]];
+			if (!IsPointInsideTriangleXY(point, v0, v1, v2, NAVMESH_LINE_OF_SIGHT_TOLERANCE)) continue;
+
+			float heightDifference = fabsf(point.z - GetNearestPointOnTriangle3D(point, v0, v1, v2).z);
+			bool isBlocked = IsTriangleBlocked(triangleIndex);
+			bool isBetter = heightDifference < bestHeightDifference - NAVMESH_LINE_OF_SIGHT_TOLERANCE;
+			if (!isBetter && heightDifference <= bestHeightDifference + NAVMESH_LINE_OF_SIGHT_TOLERANCE)
+			{
+				isBetter = (isBestBlocked && !isBlocked) || (isBestBlocked == isBlocked && heightDifference < bestHeightDifference);
+			}
+
+			if (isBetter)
+			{
+				bestHeightDifference = heightDifference;
+				bestTriangleIndex = triangleIndex;
+				isBestBlocked = isBlocked;
+			}
+		}
+	}
+
+	return bestTriangleIndex;
+}
+
+bool NavMesh::HasLineOfSight(int startTriangleIndex, Vec3 const& start, Vec3 const& end) const
+{
+	if (startTriangleIndex < 0 || startTriangleIndex >= GetNumTriangles()) return false;
+	if (IsTriangleBlocked(startTriangleIndex)) return false;
+
+	Vec2 lineStart = Vec2(start.x, start.y);
+	Vec2 lineDisplacement = Vec2(end.x - start.x, end.y - start.y);
+
+	// The start has to be on the start triangle, or the walk would be checking some other line
+	NavMeshTri const& startTriangle = m_triangles[startTriangleIndex];
+	Vec3 const& v0 = m_vertexes[startTriangle.m_vertIndexes[0]];
+	Vec3 const& v1 = m_vertexes[startTriangle.m_vertIndexes[1]];
+	Vec3 const& v2 = m_vertexes[startTriangle.m_vertIndexes[2]];
+	if (!IsPointInsideTriangleXY(start, v0, v1, v2, NAVMESH_LINE_OF_SIGHT_TOLERANCE)) return false;
+
+	float lineLength = lineDisplacement.GetLength();
+	if (lineLength == 0.f) return true;
+	float lineTolerance = NAVMESH_LINE_OF_SIGHT_TOLERANCE / lineLength;
+
+	// The line leaves a convex triangle through the edge it crosses furthest along
+	auto getExit = [&](int triangleIndex, float& outExitFraction, int& outExitEdge, int& outExitVertIndex)
+	{
+		NavMeshTri const& triangle = m_triangles[triangleIndex];
+		outExitFraction = -FLT_MAX;
+		outExitEdge = -1;
+		outExitVertIndex = -1;
+		for (int edge = 0; edge < 3; edge++)
+		{
+			Vec3 const& edgeStart = m_vertexes[triangle.m_vertIndexes[edge]];
+			Vec3 const& edgeEnd = m_vertexes[triangle.m_vertIndexes[(edge + 1) % 3]];
+			Vec2 edgeDisplacement = Vec2(edgeEnd.x - edgeStart.x, edgeEnd.y - edgeStart.y);
+			float denominator = CrossProduct2D(lineDisplacement, edgeDisplacement);
+			if (denominator == 0.f) continue; // Parallel to the line
+
+			Vec2 toEdgeStart = Vec2(edgeStart.x, edgeStart.y) - lineStart;
+			float fractionAlongEdge = CrossProduct2D(toEdgeStart, lineDisplacement) / denominator;
+			float edgeTolerance = NAVMESH_LINE_OF_SIGHT_TOLERANCE / edgeDisplacement.GetLength();
+			if (fractionAlongEdge < -edgeTolerance || fractionAlongEdge > 1.f + edgeTolerance) continue;
+
+			float fractionAlongLine = CrossProduct2D(toEdgeStart, edgeDisplacement) / denominator;
+			if (fractionAlongLine > outExitFraction)
+			{
+				outExitFraction = fractionAlongLine;
+				outExitEdge = edge;
+				outExitVertIndex = -1;
+				if (fractionAlongEdge <= edgeTolerance) outExitVertIndex = triangle.m_vertIndexes[edge];
+				if (fractionAlongEdge >= 1.f - edgeTolerance) outExitVertIndex = triangle.m_vertIndexes[(edge + 1) % 3];
+			}
+		}
+	};
+
+	int currentTriangleIndex = startTriangleIndex;
+	for (int step = 0; step < GetNumTriangles(); step++)
+	{
+		float exitFraction = 0.f;
+		int exitEdge = -1;
+		int exitVertIndex = -1;
+		getExit(currentTriangleIndex, exitFraction, exitEdge, exitVertIndex);
+
+		if (exitEdge == -1) return false;
+		if (exitFraction >= 1.f - lineTolerance) return true; // The end comes before the exit, so it's on this triangle
+
+		if (exitVertIndex == -1)
+		{
+			currentTriangleIndex = GetWalkableNeighbor(currentTriangleIndex, exitEdge);
+			if (currentTriangleIndex == -1) return false; // Leaves the mesh or runs into an obstacle
+			continue;
+		}
+
+		// Through a corner the next triangle can be any one around it, take the one the line carries on furthest into
+		int fanTriangleIndexes[NAVMESH_MAX_VERTEX_FAN];
+		int numFanTriangles = GetTrianglesAroundVertex(currentTriangleIndex, exitVertIndex, fanTriangleIndexes, NAVMESH_MAX_VERTEX_FAN);
+		int nextTriangleIndex = -1;
+		float nextExitFraction = exitFraction + lineTolerance;
+		for (int fanIndex = 0; fanIndex < numFanTriangles; fanIndex++)
+		{
+			float fanExitFraction = 0.f;
+			int fanExitEdge = -1;
+			int fanExitVertIndex = -1;
+			getExit(fanTriangleIndexes[fanIndex], fanExitFraction, fanExitEdge, fanExitVertIndex);
+			if (fanExitEdge != -1 && fanExitFraction > nextExitFraction)
+			{
+				nextExitFraction = fanExitFraction;
+				nextTriangleIndex = fanTriangleIndexes[fanIndex];
+			}
+		}
+
+		if (nextTriangleIndex == -1) return false; // Leaves the mesh at the corner
+		currentTriangleIndex = nextTriangleIndex;
+	}
+
+	return false;
+}
+
+int NavMesh::GetTriangleCornerOfVertex(int triangleIndex, int vertIndex) const
+{
+	NavMeshTri const& triangle = m_triangles[triangleIndex];
+	for (int corner = 0; corner < 3; corner++)
+	{
+		if (triangle.m_vertIndexes[corner] == vertIndex) return corner;
+	}
+	return -1;
+}
+
+int NavMesh::GetTrianglesAroundVertex(int triangleIndex, int vertIndex, int* outTriangleIndexes, int maxTriangles) const
+{
+	int numTriangles = 0;
+	if (maxTriangles <= 0 || GetTriangleCornerOfVertex(triangleIndex, vertIndex) == -1) return 0;
+	outTriangleIndexes[numTriangles++] = triangleIndex;
+
+	// Turn one way across the edge leaving the corner, and if that runs into an open edge, turn back the other way from the start
+	for (int direction = 0; direction < 2; direction++)
+	{
+		int fanTriangleIndex = triangleIndex;
+		while (numTriangles < maxTriangles)
+		{
+			int corner = GetTriangleCornerOfVertex(fanTriangleIndex, vertIndex);
+			int edge = (direction == 0) ? corner : (corner + 2) % 3;
+			fanTriangleIndex = GetWalkableNeighbor(fanTriangleIndex, edge);
+			if (fanTriangleIndex == -1 || fanTriangleIndex == triangleIndex) break;
+			if (GetTriangleCornerOfVertex(fanTriangleIndex, vertIndex) == -1) break; // Neighbor links that don't share the corner, leave the fan as is
+
+			outTriangleIndexes[numTriangles++] = fanTriangleIndex;
+		}
+
+		if (fanTriangleIndex == triangleIndex) break; // Closed fan, the first turn found every triangle
+	}
+
+	return numTriangles;
+}
+
+void NavMesh::FindNearestTriangles(std::vector<Vec3> const& points, std::vector<int>& outTriangleIndexes, std::vector<Vec3>& outProjectedPoints) const
+{
+	int numPoints = static_cast<int>(points.size());
+	outTriangleIndexes.resize(numPoints);
+	outProjectedPoints.resize(numPoints);
+	if (numPoints == 0) return;
+
+	// Groups are only cheap when their lanes are close together, so run the points in spatial order rather than the order given
+	std::vector<int> order;
+	SortQueriesSpatially(points, m_flatBVHNodes.empty() ? Vec3::ZERO : m_flatBVHNodes[0].m_mins, m_flatBVHNodes.empty() ? Vec3::ZERO : m_flatBVHNodes[0].m_maxs, order);
 
-		Vec3 projected = GetNearestPointOnTriangle3D(point, v0, v1, v2);
-		float distSq = GetDistanceSquared3D(point, projected);
+	int numGroups = (numPoints + NAVMESH_QUERY_GROUP_SIZE - 1) / NAVMESH_QUERY_GROUP_SIZE;
+	ParallelForIfAvailable(g_theJobSystem, 0, numGroups, NAVMESH_QUERY_GROUPS_PER_JOB, [&](int groupIndex)
+	{
+		int first = groupIndex * NAVMESH_QUERY_GROUP_SIZE;
+		int numLanes = std::min(NAVMESH_QUERY_GROUP_SIZE, numPoints - first);
+
+		Vec3 groupPoints[NAVMESH_QUERY_GROUP_SIZE];
+		int groupTriangleIndexes[NAVMESH_QUERY_GROUP_SIZE];
+		Vec3 groupProjectedPoints[NAVMESH_QUERY_GROUP_SIZE];
+		for (int lane = 0; lane < numLanes; lane++)
+		{
+			groupPoints[lane] = points[order[first + lane]];
+		}
+
+		FindNearestTrianglesInGroup(groupPoints, numLanes, groupTriangleIndexes, groupProjectedPoints);
+
+		for (int lane = 0; lane < numLanes; lane++)
+		{
+			outTriangleIndexes[order[first + lane]] = groupTriangleIndexes[lane];
+			outProjectedPoints[order[first + lane]] = groupProjectedPoints[lane];
+		}
+	}, JobType::AI);
+}
+
+void NavMesh::RaycastVsNavMesh(std::vector<Vec3> const& starts, std::vector<Vec3> const& directions, float maxDistance, std::vector<RaycastVsGroundResult>& outResults) const
+{
+	GUARANTEE_OR_DIE(starts.size() == directions.size(), "Every ray start needs a direction");
+
+	int numRays = static_cast<int>(starts.size());
+	outResults.resize(numRays);
+	if (numRays == 0) return;
+
+	std::vector<int> order;
+	SortQueriesSpatially(starts, m_flatBVHNodes.empty() ? Vec3::ZERO : m_flatBVHNodes[0].m_mins, m_flatBVHNodes.empty() ? Vec3::ZERO : m_flatBVHNodes[0].m_maxs, order);
+
+	int numGroups = (numRays + NAVMESH_QUERY_GROUP_SIZE - 1) / NAVMESH_QUERY_GROUP_SIZE;
+	ParallelForIfAvailable(g_theJobSystem, 0, numGroups, NAVMESH_QUERY_GROUPS_PER_JOB, [&](int groupIndex)
+	{
+		int first = groupIndex * NAVMESH_QUERY_GROUP_SIZE;
+		int numLanes = std::min(NAVMESH_QUERY_GROUP_SIZE, numRays - first);
+
+		Vec3 groupStarts[NAVMESH_QUERY_GROUP_SIZE];
+		Vec3 groupDirections[NAVMESH_QUERY_GROUP_SIZE];
+		RaycastVsGroundResult groupResults[NAVMESH_QUERY_GROUP_SIZE];
+		for (int lane = 0; lane < numLanes; lane++)
+		{
+			groupStarts[lane] = starts[order[first + lane]];
+			groupDirections[lane] = directions[order[first + lane]];
+		}
+
+		RaycastVsNavMeshInGroup(groupStarts, groupDirections, numLanes, maxDistance, groupResults);
+
+		for (int lane = 0; lane < numLanes; lane++)
+		{
+			outResults[order[first + lane]] = groupResults[lane];
+		}
+	}, JobType::AI);
+}
+
+void NavMesh::FindNearestTrianglesInGroup(Vec3 const* points, int numPoints, int* outTriangleIndexes, Vec3* outProjectedPoints) const
+{
+	GUARANTEE_OR_DIE(numPoints <= NAVMESH_QUERY_GROUP_SIZE, "Too many points for one query group");
+
+	// Lanes live in plain float arrays so the box test is one straight loop over the group
+	float pointX[NAVMESH_QUERY_GROUP_SIZE];
+	float pointY[NAVMESH_QUERY_GROUP_SIZE];
+	float pointZ[NAVMESH_QUERY_GROUP_SIZE];
+	float bestDistanceSq[NAVMESH_QUERY_GROUP_SIZE];
+	bool isLaneActive[NAVMESH_QUERY_GROUP_SIZE];
+	for (int lane = 0; lane < numPoints; lane++)
+	{
+		pointX[lane] = points[lane].x;
+		pointY[lane] = points[lane].y;
+		pointZ[lane] = points[lane].z;
+		bestDistanceSq[lane] = FLT_MAX;
+		outTriangleIndexes[lane] = -1;
+	}
+	if (m_flatBVHNodes.empty()) return;
+
+	auto testLeafForLane = [&](FlatBVHNode const& leaf, int lane)
+	{
+		for (int slot = leaf.m_firstIndex; slot < leaf.m_firstIndex + leaf.m_numTriangles; slot++)
+		{
+			int triangleIndex = m_flatBVHTriangleIndexes[slot];
+			const NavMeshTri& triangle = m_triangles[triangleIndex];
+			Vec3 projected = GetNearestPointOnTriangle3D(points[lane], m_vertexes[triangle.m_vertIndexes[0]], m_vertexes[triangle.m_vertIndexes[1]], m_vertexes[triangle.m_vertIndexes[2]]);
+			float distanceSq = GetDistanceSquared3D(points[lane], projected);
+			if (distanceSq < bestDistanceSq[lane])
+			{
+				bestDistanceSq[lane] = distanceSq;
+				outTriangleIndexes[lane] = triangleIndex;
+				outProjectedPoints[lane] = projected;
+			}
+		}
+	};
+
+	// Every lane starts from the leaf it greedily falls into, otherwise lanes with no bound yet would keep every node open
+	for (int lane = 0; lane < numPoints; lane++)
+	{
+		int nodeIndex = 0;
+		while (!m_flatBVHNodes[nodeIndex].IsLeafNode())
+		{
+			FlatBVHNode const& left = m_flatBVHNodes[m_flatBVHNodes[nodeIndex].m_firstIndex];
+			FlatBVHNode const& right = m_flatBVHNodes[m_flatBVHNodes[nodeIndex].m_firstIndex + 1];
+			bool isRightNearer = GetDistanceSquaredToBox(points[lane], right.m_mins, right.m_maxs) < GetDistanceSquaredToBox(points[lane], left.m_mins, left.m_maxs);
+			nodeIndex = m_flatBVHNodes[nodeIndex].m_firstIndex + (isRightNearer ? 1 : 0);
+		}
+		testLeafForLane(m_flatBVHNodes[nodeIndex], lane);
+	}
+
+	// Branch and bound, a node is skipped once its box is further away than the best triangle of every lane
+	int nodeStack[FLAT_BVH_MAX_DEPTH + 2];
+	int stackSize = 0;
+	nodeStack[stackSize++] = 0;
+	while (stackSize > 0)
+	{
+		FlatBVHNode const& node = m_flatBVHNodes[nodeStack[--stackSize]];
+
+		bool isAnyLaneActive = false;
+		for (int lane = 0; lane < numPoints; lane++)
+		{
+			float distanceX = std::max(std::max(node.m_mins.x - pointX[lane], 0.f), pointX[lane] - node.m_maxs.x);
+			float distanceY = std::max(std::max(node.m_mins.y - pointY[lane], 0.f), pointY[lane] - node.m_maxs.y);
+			float distanceZ = std::max(std::max(node.m_mins.z - pointZ[lane], 0.f), pointZ[lane] - node.m_maxs.z);
+			isLaneActive[lane] = (distanceX * distanceX + distanceY * distanceY + distanceZ * distanceZ) < bestDistanceSq[lane];
+			isAnyLaneActive |= isLaneActive[lane];
+		}
+		if (!isAnyLaneActive) continue;
+
+		if (node.IsLeafNode())
+		{
+			for (int lane = 0; lane < numPoints; lane++)
+			{
+				if (isLaneActive[lane]) testLeafForLane(node, lane);
+			}
+			continue;
+		}
+
+		// Child nearer the first lane goes on top, so it tightens the bounds before the other one is looked at
+		int nearChild = node.m_firstIndex;
+		int farChild = node.m_firstIndex + 1;
+		FlatBVHNode const& left = m_flatBVHNodes[nearChild];
+		FlatBVHNode const& right = m_flatBVHNodes[farChild];
+		if (GetDistanceSquaredToBox(points[0], right.m_mins, right.m_maxs) < GetDistanceSquaredToBox(points[0], left.m_mins, left.m_maxs))
+		{
+			std::swap(nearChild, farChild);
+		}
+		nodeStack[stackSize++] = farChild;
+		nodeStack[stackSize++] = nearChild;
+	}
+}
 
-		if (distSq < bestDistSq)
+void NavMesh::RaycastVsNavMeshInGroup(Vec3 const* starts, Vec3 const* directions, int numRays, float maxDistance, RaycastVsGroundResult* outResults) const
+{
+	GUARANTEE_OR_DIE(numRays <= NAVMESH_QUERY_GROUP_SIZE, "Too many rays for one query group");
+
+	Vec3 rayDirs[NAVMESH_QUERY_GROUP_SIZE];
+	float startX[NAVMESH_QUERY_GROUP_SIZE];
+	float startY[NAVMESH_QUERY_GROUP_SIZE];
+	float startZ[NAVMESH_QUERY_GROUP_SIZE];
+	float inverseDirX[NAVMESH_QUERY_GROUP_SIZE];
+	float inverseDirY[NAVMESH_QUERY_GROUP_SIZE];
+	float inverseDirZ[NAVMESH_QUERY_GROUP_SIZE];
+	float closestDistance[NAVMESH_QUERY_GROUP_SIZE];
+	bool isLaneActive[NAVMESH_QUERY_GROUP_SIZE];
+	for (int lane = 0; lane < numRays; lane++)
+	{
+		// A huge stand in for 1/0 keeps the slab test free of 0 * infinity
+		rayDirs[lane] = directions[lane].GetNormalized();
+		startX[lane] = starts[lane].x;
+		startY[lane] = starts[lane].y;
+		startZ[lane] = starts[lane].z;
+		inverseDirX[lane] = (rayDirs[lane].x != 0.f) ? 1.f / rayDirs[lane].x : 1e30f;
+		inverseDirY[lane] = (rayDirs[lane].y != 0.f) ? 1.f / rayDirs[lane].y : 1e30f;
+		inverseDirZ[lane] = (rayDirs[lane].z != 0.f) ? 1.f / rayDirs[lane].z : 1e30f;
+		closestDistance[lane] = maxDistance;
+
+		outResults[lane] = RaycastVsGroundResult();
+		outResults[lane].m_impactDist = maxDistance;
+	}
+	if (m_flatBVHNodes.empty()) return;
+
+	int nodeStack[FLAT_BVH_MAX_DEPTH + 2];
+	int stackSize = 0;
+	nodeStack[stackSize++] = 0;
+	while (stackSize > 0)
+	{
+		FlatBVHNode const& node = m_flatBVHNodes[nodeStack[--stackSize]];
+
+		// Slab test per lane, clipped to the closest hit that lane has so far
+		bool isAnyLaneActive = false;
+		for (int lane = 0; lane < numRays; lane++)
 		{
-			bestDistSq = distSq;
-			outProjectedPoint = projected;
-			outTriangleIndex = i;
-			found = true;
+			float entryX = (node.m_mins.x - startX[lane]) * inverseDirX[lane];
+			float exitX = (node.m_maxs.x - startX[lane]) * inverseDirX[lane];
+			float entryY = (node.m_mins.y - startY[lane]) * inverseDirY[lane];
+			float exitY = (node.m_maxs.y - startY[lane]) * inverseDirY[lane];
+			float entryZ = (node.m_mins.z - startZ[lane]) * inverseDirZ[lane];
+			float exitZ = (node.m_maxs.z - startZ[lane]) * inverseDirZ[lane];
+
+			float nearDistance = std::max(std::max(std::min(entryX, exitX), std::min(entryY, exitY)), std::max(std::min(entryZ, exitZ), 0.f));
+			float farDistance = std::min(std::min(std::max(entryX, exitX), std::max(entryY, exitY)), std::min(std::max(entryZ, exitZ), closestDistance[lane]));
+			isLaneActive[lane] = nearDistance <= farDistance;
+			isAnyLaneActive |= isLaneActive[lane];
 		}
+		if (!isAnyLaneActive) continue;
+
+		if (node.IsLeafNode())
+		{
+			for (int slot = node.m_firstIndex; slot < node.m_firstIndex + node.m_numTriangles; slot++)
+			{
+				const NavMeshTri& triangle = m_triangles[m_flatBVHTriangleIndexes[slot]];
+				Vec3 const& v0 = m_vertexes[triangle.m_vertIndexes[0]];
+				Vec3 const& v1 = m_vertexes[triangle.m_vertIndexes[1]];
+				Vec3 const& v2 = m_vertexes[triangle.m_vertIndexes[2]];
+
+				for (int lane = 0; lane < numRays; lane++)
+				{
+					if (!isLaneActive[lane]) continue;
+
+					if (RaycastVsNavMeshTriangle(starts[lane], rayDirs[lane], v0, v1, v2, closestDistance[lane], outResults[lane].m_impactNormal))
+					{
+						outResults[lane].m_didImpact = true;
+					}
+				}
+			}
+			continue;
+		}
+
+		// Child whose center is further along the first ray goes underneath, nearer hits cut the far side short
+		int nearChild = node.m_firstIndex;
+		int farChild = node.m_firstIndex + 1;
+		FlatBVHNode const& left = m_flatBVHNodes[nearChild];
+		FlatBVHNode const& right = m_flatBVHNodes[farChild];
+		float leftAlongRay = DotProduct3D((left.m_mins + left.m_maxs) * 0.5f - starts[0], rayDirs[0]);
+		float rightAlongRay = DotProduct3D((right.m_mins + right.m_maxs) * 0.5f - starts[0], rayDirs[0]);
+		if (rightAlongRay < leftAlongRay)
+		{
+			std::swap(nearChild, farChild);
+		}
+		nodeStack[stackSize++] = farChild;
+		nodeStack[stackSize++] = nearChild;
 	}
 
-	return found;
+	for (int lane = 0; lane < numRays; lane++)
+	{
+		if (!outResults[lane].m_didImpact) continue;
+
+		outResults[lane].m_impactDist = closestDistance[lane];
+		outResults[lane].m_impactPos = starts[lane] + rayDirs[lane] * closestDistance[lane];
+	}
 }
 
 bool NavMesh::ValidateNavMesh() const
@@ -900,76 +2200,34 @@ bool NavMesh::ValidateNavMesh() const
 			}
 		}
 
-		// Verify connectivity with neighbors
+		// The neighbor in slot e must share that exact edge and point back across it
 		for (int edge = 0; edge < 3; edge++) 
 		{
 			int neighborID = tri.m_neighborTriIndexes[edge];
 			if (neighborID == -1) continue; // No neighbor on this edge
 
 			const NavMeshTri& neighborTri = m_triangles[neighborID];
-			bool found = false;
+			int vertA = tri.m_vertIndexes[edge];
+			int vertB = tri.m_vertIndexes[(edge + 1) % 3];
 
-			for (int neighborEdge = 0; neighborEdge < 3; ++neighborEdge)
+			int neighborEdge = -1;
+			for (int candidateEdge = 0; candidateEdge < 3; candidateEdge++)
 			{
-				if (neighborTri.m_neighborTriIndexes[neighborEdge] == static_cast<int>(i)) 
+				int neighborVertA = neighborTri.m_vertIndexes[candidateEdge];
+				int neighborVertB = neighborTri.m_vertIndexes[(candidateEdge + 1) % 3];
+				if ((neighborVertA == vertA && neighborVertB == vertB) || (neighborVertA == vertB && neighborVertB == vertA))
 				{
-					found = true;
-
-					// Verify shared vertices
-					int sharedVerts = 0;
-					Vec3 sharedVertA, sharedVertB;
-
-					for (int triangleIVert = 0; triangleIVert < 3; triangleIVert++)
-					{
-						for (int triangleJVert = 0; triangleJVert < 3; triangleJVert++)
-						{
-							const Vec3& vertexI = m_vertexes[tri.m_vertIndexes[triangleIVert]];
-							const Vec3& vertexJ = m_vertexes[neighborTri.m_vertIndexes[triangleJVert]];
-
-							if (vertexI == vertexJ)
-							{
-								sharedVerts++;
-								if (sharedVerts == 1)
-								{
-									sharedVertA = vertexI;
-								}
-								else if (sharedVerts == 2)
-								{
-									sharedVertB = vertexI;
-								}
-							}
-						}
-					}
-
-					if (sharedVerts != 2) 
-					{
-						ERROR_AND_DIE(Stringf("Error: Triangle %zu and neighbor %d share %d vertices (expected 2).\n", i, neighborID, sharedVerts));
-					}
-
-					bool isvalidEdge = false;
-					for (int triangleVert = 0; triangleVert < 3; triangleVert++)
-					{
-						const Vec3& vertA = m_vertexes[tri.m_vertIndexes[triangleVert]];
-						const Vec3& vertB = m_vertexes[tri.m_vertIndexes[(triangleVert + 1) % 3]];
-
-						if ((vertA == sharedVertA && vertB == sharedVertB) ||
-							(vertA == sharedVertB && vertB == sharedVertA))
-						{
-							isvalidEdge = true;
-							break;
-						}
-					}
-
-					if (!isvalidEdge)
-					{
-						ERROR_AND_DIE(Stringf("Error: Triangle %zu and neighbor %d do not share a valid edge.\n", i, neighborID));
-					}
-
+					neighborEdge = candidateEdge;
 					break;
 				}
 			}
 
-			if (!found) 
+			if (neighborEdge == -1)
+			{
+				ERROR_AND_DIE(Stringf("Error: Triangle %zu and neighbor %d do not share edge %d.\n", i, neighborID, edge));
+			}
+
+			if (neighborTri.m_neighborTriIndexes[neighborEdge] != static_cast<int>(i)) 
 			{
 				ERROR_AND_DIE(Stringf("Error: Triangle %zu points to neighbor %d, but the reverse connection is missing.\n", i, neighborID));
 			}
@@ -6,6 +6,8 @@
 #include "Engine/Renderer/IndexBuffer.hpp"
 
 #include <vector>
+#include <string>
+#include <cstdint>
 #include <utility>
 #include <unordered_set>
 
@@ -16,6 +18,30 @@ constexpr int MAX_BVH_DEPTH = 20; // Increase for more sub divisions (resulting
 constexpr int MAX_TRIANGLES_PER_LEAF = 256; // Increase for more triangles per box (meaning less boxes), but slower search potentially
 constexpr float NAVMESH_ZBIAS = 0.1f;
 
+constexpr int FLAT_BVH_MAX_DEPTH = 48; // Also bounds the traversal stack
+constexpr int FLAT_BVH_MAX_TRIANGLES_PER_LEAF = 4; // Always a leaf at or below this
+constexpr int FLAT_BVH_MAX_SAH_LEAF_TRIANGLES = 16; // Can become a leaf up to this when no split beats testing every triangle
+constexpr int FLAT_BVH_NUM_BINS = 12;
+constexpr int FLAT_BVH_PARALLEL_MIN_TRIANGLES = 2048; // Ranges smaller than this are built start to finish by one job
+constexpr int NAVMESH_QUERY_GROUP_SIZE = 8; // Batched queries walk the BVH together in groups this size, one lane per query
+constexpr int NAVMESH_QUERY_GROUPS_PER_JOB = 16;
+constexpr float NAVMESH_LINE_OF_SIGHT_TOLERANCE = 0.0001f; // Slack on edge and containment tests, so lines through vertexes and along edges still count
+constexpr int NAVMESH_MAX_VERTEX_FAN = 32; // Most triangles looked at around one vertex
+constexpr int NAVMESH_DISTANCE_FIELD_REGIONS_PER_SIDE = 8; // The distance field is built on one job per region of a grid this many regions across
+
+constexpr char NAVMESH_BAKED_FILE_MAGIC[4] = { 'N', 'A', 'V', 'M' };
+constexpr uint32_t NAVMESH_BAKED_FILE_VERSION = 3; // Bump whenever anything written by SaveBakedNavMesh changes
+constexpr size_t NAVMESH_BAKED_SECTION_ALIGNMENT = 16;
+constexpr int NAVMESH_MAX_AREAS = 16; // Area IDs past the built in NavMeshArea values are free for the game to use
+
+struct RaycastVsGroundResult
+{
+	bool	m_didImpact = false;
+	float	m_impactDist = 0.f;
+	Vec3	m_impactPos;
+	Vec3	m_impactNormal;
+};
+
 struct BVHNode
 {
 	Vec3 m_mins = Vec3::ZERO;
@@ -79,10 +105,70 @@ struct BVHNode
 	}
 };
 
+// Node of the flattened BVH, all nodes live in NavMesh::m_flatBVHNodes with the root at 0. Children are allocated as a pair,
+// so an internal node only needs the index of its left child
+struct FlatBVHNode
+{
+	Vec3 m_mins = Vec3::ZERO;
+	Vec3 m_maxs = Vec3::ZERO;
+	int m_firstIndex = 0; // Leaf: first slot in NavMesh::m_flatBVHTriangleIndexes. Internal: left child, the right child is the next node
+	int m_numTriangles = 0; // Zero for internal nodes
+
+	inline bool IsLeafNode() const { return m_numTriangles > 0; }
+
+	bool IsPointInside(Vec3 const& point) const
+	{
+		return (point.x >= m_mins.x && point.x <= m_maxs.x &&
+				point.y >= m_mins.y && point.y <= m_maxs.y &&
+				point.z >= m_mins.z && point.z <= m_maxs.z);
+	}
+};
+
+struct FlatBVHBuildData;
+struct FlatBVHBuildTask;
+
+// A prop carved into the NavMesh. Carving only flags the triangles it blocks, so triangle indexes never change
+struct NavMeshObstacle
+{
+	Prop const* m_prop = nullptr; // Not owned, null while the slot is free
+	float m_agentRadius = 0.f;
+	std::vector<int> m_blockedTriangleIndexes;
+};
+
+// What a triangle is made of, stored as one byte per triangle in NavMesh::m_triangleAreas
+enum class NavMeshArea : uint8_t
+{
+	Ground,
+	Mud,
+	Water,
+	Danger, // Near an edge of the mesh, see NavMesh::MarkAreaNearEdges
+	NUM_BUILTIN_NAVMESH_AREAS
+};
+
+// Per agent archetype view of one shared NavMesh: which areas it may enter and what each costs per unit walked.
+// Resolved into a small cost table once per query, so the search itself only does one lookup per neighbor
+struct NavMeshQueryFilter
+{
+	NavMeshQueryFilter();
+
+	void SetAreaCost(uint8_t area, float cost); // At least 1, so the straight line distance stays a valid A* heuristic
+	void IncludeArea(uint8_t area, bool isIncluded = true);
+	void ExcludeArea(uint8_t area, bool isExcluded = true);
+	inline void SetAreaCost(NavMeshArea area, float cost) { SetAreaCost(static_cast<uint8_t>(area), cost); }
+	inline void IncludeArea(NavMeshArea area, bool isIncluded = true) { IncludeArea(static_cast<uint8_t>(area), isIncluded); }
+	inline void ExcludeArea(NavMeshArea area, bool isExcluded = true) { ExcludeArea(static_cast<uint8_t>(area), isExcluded); }
+	inline bool PassesFilter(uint8_t area) const { uint32_t areaBit = 1u << area; return (m_includeAreaMask & areaBit) != 0 && (m_excludeAreaMask & areaBit) == 0; }
+	void ResolveAreaCosts(float* outAreaCosts) const; // NAVMESH_MAX_AREAS entries, -1 for areas that can't be entered
+
+	float m_areaCosts[NAVMESH_MAX_AREAS];
+	uint32_t m_includeAreaMask = 0xFFFFFFFF;
+	uint32_t m_excludeAreaMask = 0;
+};
+
 struct NavMeshTri
 {
-	int m_vertIndexes[3];
-	int m_neighborTriIndexes[3];
+	int m_vertIndexes[3]; // Into the welded NavMesh::m_vertexes, shared by every triangle touching the corner
+	int m_neighborTriIndexes[3]; // Slot e is the triangle across the edge from vert e to vert (e + 1) % 3, -1 when that edge is open
 };
 
 struct NavMesh
@@ -92,12 +178,39 @@ struct NavMesh
 	
 	void CreateBuffers();
 	void CreateNavMesh(std::vector<Vec3>& vertexPoints, int mapWidth, int mapHeight, std::vector<int>& vertexMapping);
-	void ComputeNeighborsHashed();
-	void ComputeNeighborsBruteForce();
+	void ComputeNeighbors();
+
+	// Vertexes, triangles with adjacency and areas, the flat BVH and the distance field in one versioned file. Loading maps the file and
+	// copies each array out in one go. False when the file is missing, out of date, baked with a different layout or holds an index past the array it points into,
+	// so the caller can fall back to CreateNavMesh. A rejected file leaves the current mesh untouched
+	bool SaveBakedNavMesh(std::string const& filePath) const;
+	bool LoadBakedNavMesh(std::string const& filePath);
 
 	void RemoveRandomTriangleCluster();
-	void RemoveTrianglesAffectedByProps(std::vector<Prop*>& props);
-	void PopulateDistanceField(NavMeshHeatMap& outDistanceField, float maxCost) const;
+	void RemoveTrianglesAffectedByProps(std::vector<Prop*>& props); // Carves every prop as a dynamic obstacle
+
+	// Dynamic obstacles. Only the triangles under the prop's bounds are tested, found through the flat BVH
+	int AddDynamicObstacle(Prop const* prop, float agentRadius); // Returns the obstacle ID
+	void UpdateDynamicObstacle(int obstacleID); // Call after the prop moves
+	void RemoveDynamicObstacle(int obstacleID);
+	void RecarveDynamicObstacles(); // After triangles are added, removed or reordered
+	void CarveObstacle(NavMeshObstacle& obstacle);
+	void UncarveObstacle(NavMeshObstacle& obstacle);
+	inline bool IsTriangleBlocked(int triangleIndex) const { return triangleIndex < static_cast<int>(m_triangleBlockerCounts.size()) && m_triangleBlockerCounts[triangleIndex] > 0; }
+	inline int GetWalkableNeighbor(int triangleIndex, int edge) const // -1 when the edge is open or the triangle across it is blocked
+	{
+		int neighborIndex = m_triangles[triangleIndex].m_neighborTriIndexes[edge];
+		return (neighborIndex == -1 || IsTriangleBlocked(neighborIndex)) ? -1 : neighborIndex;
+	}
+
+	// Area types, NavMeshArea::Ground until set
+	inline uint8_t GetTriangleArea(int triangleIndex) const { return m_triangleAreas[triangleIndex]; }
+	inline void SetTriangleArea(int triangleIndex, uint8_t area) { m_triangleAreas[triangleIndex] = area; }
+	inline void SetTriangleArea(int triangleIndex, NavMeshArea area) { m_triangleAreas[triangleIndex] = static_cast<uint8_t>(area); }
+	void SetAreaInBox(Vec3 const& mins, Vec3 const& maxs, uint8_t area); // Every triangle whose bounds overlap the box
+	void MarkAreaNearEdges(uint8_t area, float maxDistance); // Ground triangles closer than maxDistance to an edge in the distance field, for keeping agents off ledges
+	void GetTrianglesOverlappingBox(Vec3 const& mins, Vec3 const& maxs, std::vector<int>& outTriangleIndexes) const;
+	void PopulateDistanceField(NavMeshHeatMap& outDistanceField, float maxCost) const; // Walking distance from each triangle to the nearest open or blocked edge
 
 	Vec3 ClampPositionToNavMesh(Vec3 const& position);
 	Vec3 CalculateCentroid(const NavMeshTri& triangle) const;
@@ -106,17 +219,34 @@ struct NavMesh
 
 	float GetComponent(Vec3 const& vertex, int axis);
 	inline int GetNumTriangles() const { return static_cast<int>(m_triangles.size()); };
-	int GetClosestTriangleIndex(Vec3 const& position);
+	int GetClosestTriangleIndex(Vec3 const& position) const;
 	int GetRandomNavMeshTriangleIndex() const;
 	int GetTriangleIndex(const NavMeshTri* triangle) const;
 	int GetContainingTriangleIndex(Vec3 const& point) const;
 	int GetRecursiveTriangleIndex(BVHNode const& node, Vec3 const& point) const;
 	NavMeshTri* GetNavMeshTriangle(int triangleID);
 
-	bool FindNearestTriangle(Vec3 const& point, int& outTriangleIndex, Vec3& outProjectedPoint);
+	bool FindNearestTriangle(Vec3 const& point, int& outTriangleIndex, Vec3& outProjectedPoint) const;
+	RaycastVsGroundResult RaycastVsNavMesh(Vec3 const& start, Vec3 const& direction, float maxDistance) const; // Closest hit on the upward facing side
+
+	// Walks the straight line in XY from triangle to triangle across shared edges, false as soon as it leaves through an open edge.
+	// Costs one step per triangle crossed, the start triangle is looked up with GetTriangleIndexUnderPoint when it isn't given
+	bool HasLineOfSight(Vec3 const& start, Vec3 const& end) const;
+	bool HasLineOfSight(int startTriangleIndex, Vec3 const& start, Vec3 const& end) const;
+	int GetTriangleIndexUnderPoint(Vec3 const& point) const; // Containing the point in XY, the nearest in height where levels overlap, -1 when off the mesh
+	int GetTriangleCornerOfVertex(int triangleIndex, int vertIndex) const; // -1 when the triangle doesn't use that vertex
+	int GetTrianglesAroundVertex(int triangleIndex, int vertIndex, int* outTriangleIndexes, int maxTriangles) const; // Walks neighbor links, starting with triangleIndex
+
+	// Batched versions, split into groups of NAVMESH_QUERY_GROUP_SIZE that each walk the BVH once and spread over the job system.
+	// Groups only pay off when queries next to each other in the array are close together in the world
+	void FindNearestTriangles(std::vector<Vec3> const& points, std::vector<int>& outTriangleIndexes, std::vector<Vec3>& outProjectedPoints) const; // -1 when the mesh is empty
+	void RaycastVsNavMesh(std::vector<Vec3> const& starts, std::vector<Vec3> const& directions, float maxDistance, std::vector<RaycastVsGroundResult>& outResults) const;
+	void FindNearestTrianglesInGroup(Vec3 const* points, int numPoints, int* outTriangleIndexes, Vec3* outProjectedPoints) const;
+	void RaycastVsNavMeshInGroup(Vec3 const* starts, Vec3 const* directions, int numRays, float maxDistance, RaycastVsGroundResult* outResults) const;
 	bool ValidateNavMesh() const;
 
 	void RebuildNavMeshVerts();
+	void BuildRenderVerts(Rgba8 const& solidColor, Rgba8 const& wireColor);
 	void RenderHeatMap() const;
 	void RenderBVH() const;
 	void RenderNavMesh() const;
@@ -124,6 +254,10 @@ struct NavMesh
 	void BuildBVH();
 	void BuildBVHRecursive(BVHNode& node, std::vector<int> triangleIndices, int depth = 0);
 	void CollectBVHNodesInOrder(const BVHNode* node);
+	void BuildFlatBVH(); // Rebuilds from scratch, call again whenever triangles are added, removed or reordered
+	void BuildFlatBVHNode(std::vector<FlatBVHNode>& nodes, int nodeIndex, int begin, int end, int depth, FlatBVHBuildData const& buildData, std::vector<FlatBVHBuildTask>* deferredTasks);
+	size_t GetBVHMemoryBytes() const;
+	size_t GetFlatBVHMemoryBytes() const;
 	void DrawAllBVH(BVHNode* node, int depth);
 
 	void ConstructHeatmap();
@@ -131,19 +265,29 @@ struct NavMesh
 	void DebugDrawNeighbors() const;
 
 	NavMeshHeatMap* m_heatMap = nullptr;
-	BVHNode* m_bvhRoot = nullptr;
+	BVHNode* m_bvhRoot = nullptr; // Kept for the debug draw and to compare against the flat BVH, queries use the flat one
+	std::vector<FlatBVHNode> m_flatBVHNodes; // Root at 0, siblings next to each other
+	std::vector<int> m_flatBVHTriangleIndexes; // Triangle indexes reordered so every leaf covers one contiguous range
+
+	std::vector<NavMeshObstacle> m_obstacles; // Indexed by obstacle ID
+	std::vector<int> m_triangleBlockerCounts; // Per triangle, how many obstacles block it
+	std::vector<int> m_obstacleCandidateIndexes; // Reused by CarveObstacle
+	unsigned int m_carveVersion = 0; // Bumped whenever a triangle is blocked or unblocked, a path planned under an older version may cross a blocked triangle
 
 	VertexBuffer* m_solidVertexBuffer = nullptr;
 	VertexBuffer* m_wireVertexBuffer = nullptr;
+	IndexBuffer* m_navMeshIndexBuffer = nullptr; // Shared by the solid and wire vertex buffers
 	VertexBuffer* m_heatmapVertexBuffer = nullptr;
 	VertexBuffer* m_bvhVertexBuffer = nullptr;
 	IndexBuffer* m_bvhIndexBuffer = nullptr;
 
-	std::vector<Vec3> m_vertexes;
+	std::vector<Vec3> m_vertexes; // Welded, one per distinct corner
 	std::vector<NavMeshTri> m_triangles; // List of polygons (Triangles) in the NavMesh
+	std::vector<uint8_t> m_triangleAreas; // Per triangle, kept the same size and order as m_triangles
 
-	std::vector<Vertex_PCU> m_solidVerts;
+	std::vector<Vertex_PCU> m_solidVerts; // One per welded vertex
 	std::vector<Vertex_PCU> m_wireVerts;
+	std::vector<unsigned int> m_navMeshIndexes; // Three per triangle
 	std::vector<Vertex_PCU> m_heatmapVertexes;
 	std::vector<Vertex_PCU> m_bvhVertexes;
 	std::vector<unsigned int> m_bvhIndexes;